@@ -2,54 +2,62 @@
 
 #include "utilities/glfw_tool.h"
 #include "utilities/shader_g_t.h"
+#include "utilities/shader_g.h"
 #include "utilities/camera.h"
+#include "utilities/spherical_harmonics.h"
+#include "utilities/brdf_lut.h"
+#include "utilities/texture_pipeline.h"
+#include "utilities/render_compare.h"
+#include "utilities/material_benchmark.h"
+#include "utilities/g_buffer.h"
+#include "utilities/dynamic_resolution.h"
+#include "utilities/gpu_profiler.h"
+#include "utilities/cpu_trace.h"
+#include "utilities/camera_path.h"
+#include "utilities/headless.h"
 #include "terrain/terrain_tool.h"
 #include "terrain/map_chunk.h"
+#include "terrain/chunk_loader.h"
+#include "terrain/cdlod.h"
+#include "terrain/terrain_capture.h"
+#include "terrain/horizon_culling.h"
 
 #include <thread>
-#include <queue>
+#include <memory>
+#include <filesystem>
+#include <unordered_set>
 
-void load_material_texture(std::vector<unsigned int> &diff_texture);
+std::tuple<std::size_t, std::size_t, std::size_t>
+load_material_texture(utilities::texture_pipeline &pipeline);
 
-void load_material_texture(std::vector<unsigned int> &diff_texture, std::vector<unsigned int> &norm_textures);
-
-void load_material_texture(std::vector<unsigned int> &diff_texture, std::vector<unsigned int> &norm_textures,
-                           std::vector<unsigned int> &arm_texture);
-
-void set_texture(std::vector<unsigned int> &textures, int &texture_index, std::string &&texture_name,
-                 utilities::shader &shader_program);
+void set_texture(unsigned int texture_array_id, int texture_index);
 
 std::tuple<unsigned int, unsigned int>
 pbr_pre_process(utilities::shader &cube_map_shader, unsigned int &env_cube_map_id,
-                utilities::shader &irradiance_shader, unsigned int &irradiance_map_id,
+                utilities::sh9_coefficients &irradiance_sh,
                 utilities::shader &prefilter_shader, unsigned int &prefilter_map_id,
-                utilities::shader &brdf_shader, unsigned int &brdf_lut_map_id);
+                unsigned int &brdf_lut_map_id);
 
 unsigned int
 render_sky_box(utilities::shader &cube_map_shader, unsigned int &hdr_texture,
                unsigned int &capture_fbo, unsigned int &capture_rbo, std::vector<glm::mat4> &capture_views);
 
-unsigned int
-render_irradiance_map(utilities::shader &irradiance_shader, unsigned int &env_cube_map_id,
-                      unsigned int &capture_fbo, unsigned int &capture_rbo, std::vector<glm::mat4> &capture_views);
-
 unsigned int
 render_prefilter_map(utilities::shader &prefilter_shader, unsigned int &env_cube_map_id,
                      unsigned int &capture_fbo, unsigned int &capture_rbo, std::vector<glm::mat4> &capture_views);
 
 unsigned int
-render_brdf_lut_map(utilities::shader &brdf_shader, unsigned int &capture_fbo, unsigned int &capture_rbo);
+load_brdf_lut_map();
 
 void render_cube();
 
 void render_quad();
 
-void load_chunk(std::unordered_map<std::pair<int, int>, terrain::map_chunk, terrain::pair_hash> &map_data,
-                bool &game_end, utilities::camera &cam, siv::PerlinNoise &perlin, float &scale, int &layer_count);
-
 void
 load_height_map_task(terrain::map_chunk &chunk);
 
+double get_time();
+
 const int SCR_WIDTH = 1280;
 const int SCR_HEIGHT = 720;
 const unsigned short NUM_PATCH_PTS = 4;
@@ -59,9 +67,7 @@ float deltaTime = 0.0f;    // time between current frame and last frame
 float lastFrame = 0.0f;
 
 const int cube_map_resolution = 4096;
-const int irradiance_resolution = 32;
 const int prefilter_resolution = 128;
-const int brdf_resolution = 512;
 
 const unsigned patch_numbers = 16;
 
@@ -77,15 +83,50 @@ const int render_distance = 3;
 
 const int view_distance = 1000;
 
-std::queue<terrain::map_chunk *> main_thread_task;
-
-int main() {
+// material layers from low to high terrain, every map family is a texture array with one layer per material
+const std::vector<std::string> material_layers({"sand", "grass", "mud", "rock", "snow"});
+
+// milliseconds per frame spent uploading material textures while they are still loading
+const double texture_upload_budget = 4.0;
+
+int main(int argc, char **argv) {
+    TRACE_THREAD_NAME("main");
+
+    // --headless draws without a window and without the interface into an offscreen target,
+    // --frames n stops after n frames, --output dir writes every frame as dir/frame_0000.png,
+    // --camera-path file replays the path and stops at its end
+    bool headless = false;
+    int headless_frames = 1;
+    std::string frame_directory;
+    std::string start_camera_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        bool has_value = i + 1 < argc;
+        if (argument == "--headless") {
+            headless = true;
+        } else if (argument == "--frames" && has_value) {
+            headless_frames = std::max(1, std::atoi(argv[++i]));
+        } else if (argument == "--output" && has_value) {
+            frame_directory = argv[++i];
+        } else if (argument == "--camera-path" && has_value) {
+            start_camera_path = argv[++i];
+        } else {
+            std::cout << "Unknown argument: " << argument << std::endl;
+            std::cout << "usage: 3DPerlinMap [--headless] [--frames n] [--output dir] [--camera-path file]"
+                      << std::endl;
+            return -1;
+        }
+    }
 
     utilities::camera cam(glm::vec2(SCR_WIDTH * 0.5f, SCR_HEIGHT * 0.5f), glm::vec3(0.0f, 0.0f, 3.0f));
 
-    GLFWwindow *window;
+    GLFWwindow *window = nullptr;
+    utilities::headless_context headless_context;
     try {
-        window = utilities::init_window("3D Perlin Map", cam, SCR_WIDTH, SCR_HEIGHT);
+        if (headless)
+            headless_context = utilities::create_headless_context();
+        else
+            window = utilities::init_window("3D Perlin Map", cam, SCR_WIDTH, SCR_HEIGHT);
     } catch (std::runtime_error &error) {
         std::cout << error.what() << std::endl;
         return -1;
@@ -94,7 +135,14 @@ int main() {
         return -1;
     }
 
-    utilities::create_im_gui_context(window, "#version 460");
+    if (!headless)
+        utilities::create_im_gui_context(window, "#version 460");
+
+    // there are no window events without a window
+    auto poll_events = [&]() {
+        if (!headless)
+            glfwPollEvents();
+    };
 
     GLint maxTessLevel;
     glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxTessLevel);
@@ -112,25 +160,58 @@ int main() {
                                        std::string("PerlinMap.frag"), std::string("PerlinMap.tesc"),
                                        std::string("PerlinMap.tese"));
 
+    // same tessellation as the terrain shader, writes depth only
+    utilities::shader_t terrain_depth_shader(std::string("../shaders/"), std::string("PerlinMap.vert"),
+                                             std::string("TerrainDepth.frag"), std::string("PerlinMap.tesc"),
+                                             std::string("PerlinMap.tese"));
+
+    // records the tessellated chunks with transform feedback, nothing is rasterized
+    utilities::shader_t terrain_capture_shader(std::string("../shaders/"), std::string("PerlinMap.vert"),
+                                               std::string("TerrainDepth.frag"), std::string("PerlinMap.tesc"),
+                                               std::string("PerlinMap.tese"));
+
+    // draw the recorded chunks with the fragment shaders of the colour pass and the depth pre-pass
+    utilities::shader terrain_replay_shader(std::string("../shaders/"), std::string("TerrainReplay.vert"),
+                                            std::string("PerlinMap.frag"));
+
+    utilities::shader terrain_replay_depth_shader(std::string("../shaders/"), std::string("TerrainReplay.vert"),
+                                                  std::string("TerrainDepth.frag"));
+
+    // instanced grids with height fetches in the vertex shader instead of tessellation
+    utilities::shader terrain_cdlod_shader(std::string("../shaders/"), std::string("TerrainCdlod.vert"),
+                                           std::string("PerlinMap.frag"));
+
+    utilities::shader terrain_cdlod_depth_shader(std::string("../shaders/"), std::string("TerrainCdlod.vert"),
+                                                 std::string("TerrainDepth.frag"));
+
+    // lights the g-buffer of the deferred path
+    utilities::shader terrain_lighting_shader(std::string("../shaders/"), std::string("BRDF.vert"),
+                                              std::string("TerrainLighting.frag"));
+
+    // stretches the scene target of the dynamic resolution over the window
+    utilities::shader upscale_shader(std::string("../shaders/"), std::string("BRDF.vert"),
+                                     std::string("Upscale.frag"));
+
+    // the material fetches of the terrain through the texture arrays against separate samplers
+    utilities::shader material_fetch_shader(std::string("../shaders/"), std::string("MaterialFetch.vert"),
+                                            std::string("MaterialFetch.frag"));
+
     utilities::shader_g_t normal_shader(std::string("../shaders/"), std::string("NormalTest.vert"),
                                         std::string("NormalTest.frag"), std::string("NormalTest.tesc"),
                                         std::string("NormalTest.tese"), std::string("NormalTest.geom"));
 
+    utilities::shader_g normal_replay_shader(std::string("../shaders/"), std::string("NormalReplay.vert"),
+                                             std::string("NormalTest.frag"), std::string("NormalTest.geom"));
+
     utilities::shader cube_map_shader(std::string("../shaders/"), std::string("CubeMap.vert"),
                                       std::string("CubeMap.frag"));
 
     utilities::shader background_shader(std::string("../shaders/"), std::string("BackGround.vert"),
                                         std::string("BackGround.frag"));
 
-    utilities::shader irradiance_shader(std::string("../shaders/"), std::string("CubeMap.vert"),
-                                        std::string("IrradianceConvolution.frag"));
-
     utilities::shader prefilter_shader(std::string("../shaders/"), std::string("CubeMap.vert"),
                                        std::string("Prefilter.frag"));
 
-    utilities::shader brdf_lut_shader(std::string("../shaders/"), std::string("BRDF.vert"),
-                                      std::string("BRDF.frag"));
-
 #pragma endregion
 
 #pragma region generate vertices of plane
@@ -150,9 +231,19 @@ int main() {
 #pragma region generate height data
 
     siv::PerlinNoise::seed_type seed(7961148u);
-    siv::PerlinNoise perlin(seed);
 
-    std::unordered_map<std::pair<int, int>, terrain::map_chunk, terrain::pair_hash> map_data;
+    // generates the chunks around the camera, see terrain::chunk_loader. new chunks get their textures one per frame
+    terrain::chunk_loader_settings loader_settings;
+    loader_settings.map_width = map_width;
+    loader_settings.map_height = map_height;
+    loader_settings.texture_width = texture_width;
+    loader_settings.texture_height = texture_height;
+    loader_settings.terrain_height = terrain_height;
+    loader_settings.patch_numbers = patch_numbers;
+    loader_settings.render_distance = render_distance;
+    terrain::chunk_loader chunk_loader(loader_settings);
+    // changed by chunk_loader.update only
+    terrain::chunk_map &map_data = chunk_loader.get_chunks();
 
     float scale = 0.004f;
     int layer_count = 10;
@@ -160,75 +251,154 @@ int main() {
     float layer_lacunarity = 0.6f;
     float layer_amplitude = 0.5f;
 
+    // snapshot of the parameters above for the chunk loader, the epoch is only bumped once it is published
+    auto publish_generation_parameters = [&]() {
+        auto parameters = std::make_shared<terrain::generation_parameters>();
+        parameters->seed = seed;
+        parameters->scale = scale;
+        parameters->layer_count = layer_count;
+        parameters->lacunarity = lacunarity;
+        parameters->layer_lacunarity = layer_lacunarity;
+        parameters->layer_amplitude = layer_amplitude;
+        parameters->perlin.reseed(seed);
+        chunk_loader.set_generation_parameters(std::move(parameters));
+    };
+    publish_generation_parameters();
+
 #pragma endregion
 
     // Specify the number of vertices per patch
     glPatchParameteri(GL_PATCH_VERTICES, NUM_PATCH_PTS);
 
-    terrain_shader.use();
-    terrain_shader.set_int("height_map", 0).set_float("terrain_height", terrain_height);
-
     normal_shader.use();
     normal_shader.set_int("height_map", 0).set_float("terrain_height", terrain_height);
 
+    terrain_depth_shader.use();
+    terrain_depth_shader.set_int("height_map", 0).set_float("terrain_height", terrain_height);
+
+    // in the vertex layout of terrain::allocate_terrain_capture
+    terrain_capture_shader.feedback_varyings = {"terrain_data.frag_pos", "terrain_data.w_normal",
+                                                "terrain_data.height_coord", "terrain_data.tex_coord"};
+    terrain_capture_shader.use_variant({{"CHUNK_LEVELS", "1"}});
+    terrain_capture_shader.set_int("height_map", 0).set_float("terrain_height", terrain_height);
+
+    terrain_cdlod_depth_shader.use();
+    terrain_cdlod_depth_shader.set_int("height_map", 0).set_float("terrain_height", terrain_height);
+
+    utilities::g_buffer terrain_g_buffer = utilities::create_g_buffer(SCR_WIDTH, SCR_HEIGHT);
+    utilities::scene_target scene_target = utilities::create_scene_target(SCR_WIDTH, SCR_HEIGHT);
+    // takes the place of the default framebuffer in the headless mode, the window framebuffer is 0 otherwise
+    utilities::scene_target headless_target;
+    if (headless)
+        headless_target = utilities::create_scene_target(SCR_WIDTH, SCR_HEIGHT);
+    const unsigned int window_fbo = headless_target.fbo;
+
+    terrain::cdlod_settings cdlod_settings;
+    terrain::cdlod_mesh cdlod_mesh = terrain::create_cdlod_mesh(cdlod_settings.grid_size);
+    // nodes selected for every chunk, and the first node and node count of each chunk
+    std::vector<glm::vec4> cdlod_nodes;
+    std::vector<terrain::cdlod_chunk> cdlod_chunks;
+
 #pragma region pbr pre process
 
-    unsigned int env_cube_map_id, irradiance_map_id, prefilter_map_id, brdf_lut_map_id;
+    unsigned int env_cube_map_id, prefilter_map_id, brdf_lut_map_id;
+    utilities::sh9_coefficients irradiance_sh{};
     auto [capture_fbo, capture_rbo] =
             pbr_pre_process(cube_map_shader, env_cube_map_id,
-                            irradiance_shader, irradiance_map_id,
+                            irradiance_sh,
                             prefilter_shader, prefilter_map_id,
-                            brdf_lut_shader, brdf_lut_map_id);
+                            brdf_lut_map_id);
 
 #pragma endregion
 
-    bool game_end = false;
-    std::thread chunk_loader(load_chunk, std::ref(map_data), std::ref(game_end),
-                             std::ref(cam), std::ref(perlin), std::ref(scale), std::ref(layer_count));
-    chunk_loader.detach();
+#pragma region specify height range of different terrain environment
 
+    // height range of each texture
+    std::vector<float> height({0.0f, 0.25f, 0.6f, 0.8f, 0.9f, 1.0f});
 
-#pragma region set terrain and pbr texture to shader
+    // the chunk loader turns the height ranges into a splat map per chunk, steep ground is covered with rock
+    terrain::splat_settings splat_settings;
+    splat_settings.height_bands = height;
+    splat_settings.slope_layer = static_cast<int>(std::find(material_layers.begin(), material_layers.end(), "rock") -
+                                                  material_layers.begin());
+    // half of the ground is steeper than 70 degrees at this terrain height, only the steepest fifth turns to rock
+    splat_settings.slope_start = 75.0f;
+    splat_settings.slope_end = 82.0f;
+    chunk_loader.set_splat_settings(splat_settings);
 
-    // load texture
-    std::vector<unsigned int> diff_textures;
-    std::vector<unsigned int> norm_texture;
-    std::vector<unsigned int> arm_texture;
-    load_material_texture(diff_textures, norm_texture, arm_texture);
+#pragma endregion
 
-    int texture_index = 1;
-    terrain_shader.use();
+    // stopped before the gl objects are cleaned up
+    chunk_loader.start(cam.position);
 
-    set_texture(diff_textures, texture_index, "diff", terrain_shader);
-    set_texture(norm_texture, texture_index, "norm", terrain_shader);
-    set_texture(arm_texture, texture_index, "arm", terrain_shader);
 
-    glActiveTexture(GL_TEXTURE0 + texture_index);
-    glBindTexture(GL_TEXTURE_2D, irradiance_map_id);
-    terrain_shader.set_int("irradiance_map", texture_index++);
+#pragma region set terrain and pbr texture to shader
 
-    glActiveTexture(GL_TEXTURE0 + texture_index);
-    glBindTexture(GL_TEXTURE_2D, prefilter_map_id);
-    terrain_shader.set_int("prefilter_map", texture_index++);
+    // material textures are decoded on worker threads and uploaded a few per frame in the render loop,
+    // the terrain is drawn without the maps of a family until all of its textures are ready
+    utilities::texture_pipeline texture_pipeline;
+    auto [diff_array, norm_array, arm_array] = load_material_texture(texture_pipeline);
+
+    // one texture unit per map family, no matter how many materials there are
+    const int diff_texture_index = 1;
+    const int norm_texture_index = 2;
+    const int arm_texture_index = 3;
+    const int prefilter_texture_index = 4;
+    const int brdf_texture_index = 5;
+    const int splat_texture_index = 6;
+    const int g_albedo_texture_index = 7;
+    const int g_normal_texture_index = 8;
+    const int g_arm_texture_index = 9;
+    const int g_depth_texture_index = 10;
+    const int scene_texture_index = 11;
+    bool diff_ready = false;
+    bool norm_ready = false;
+    bool arm_ready = false;
+
+    glActiveTexture(GL_TEXTURE0 + prefilter_texture_index);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilter_map_id);
 
-    glActiveTexture(GL_TEXTURE0 + texture_index);
+    glActiveTexture(GL_TEXTURE0 + brdf_texture_index);
     glBindTexture(GL_TEXTURE_2D, brdf_lut_map_id);
-    terrain_shader.set_int("brdf_lut", texture_index++);
 
 #pragma endregion set texture to shaders
 
-#pragma region specify height range of different terrain environment
+    // the terrain shader is compiled once per combination of the shader options,
+    // every variant gets the uniforms that never change when it is built
+    auto set_image_based_lighting = [&](utilities::shader &variant) {
+        variant.set_int("prefilter_map", prefilter_texture_index)
+                .set_int("brdf_lut", brdf_texture_index);
 
-    // height range of each texture
-    std::vector<float> height({0.0f, 0.25f, 0.6f, 0.8f, 0.9f, 1.0f});
+        // diffuse irradiance is evaluated from spherical harmonics instead of a cube map
+        for (std::size_t i = 0; i < irradiance_sh.size(); ++i) {
+            variant.set_vec3("irradiance_sh[" + std::to_string(i) + "]", irradiance_sh[i]);
+        }
+    };
 
-    for (int i = 0; i < height.size(); ++i) {
-        // set height data to shader
-        std::string uniform_name("material.height[" + std::to_string(i) + "]");
-        terrain_shader.set_float(uniform_name, height[i]);
-    }
+    terrain_shader.variant_setup = [&](utilities::shader &variant) {
+        variant.set_int("height_map", 0)
+                .set_float("terrain_height", terrain_height)
+                .set_int("material.diff", diff_texture_index)
+                .set_int("material.norm", norm_texture_index)
+                .set_int("material.arm", arm_texture_index)
+                .set_int("splat_map", splat_texture_index);
+        set_image_based_lighting(variant);
+    };
 
-#pragma endregion
+    terrain_replay_shader.variant_setup = terrain_shader.variant_setup;
+    terrain_cdlod_shader.variant_setup = terrain_shader.variant_setup;
+
+    terrain_lighting_shader.variant_setup = [&](utilities::shader &variant) {
+        variant.set_int("g_albedo", g_albedo_texture_index)
+                .set_int("g_normal", g_normal_texture_index)
+                .set_int("g_arm", g_arm_texture_index)
+                .set_int("g_depth", g_depth_texture_index);
+        set_image_based_lighting(variant);
+    };
+
+    upscale_shader.variant_setup = [&](utilities::shader &variant) {
+        variant.set_int("scene", scene_texture_index);
+    };
 
 #pragma region shader option
 
@@ -240,25 +410,163 @@ int main() {
     bool gamma_correction = true;
     int light_mode = 2;
     int texture_mode = 2;
-    float DISP = 0.1f;
+    // projections of the triplanar textures: 0 triplanar, 1 biplanar, 2 dominant axis
+    int projection_mode = 0;
+    // shading tiers by view distance: 0 off, 1 on, 2 on and tinted red, green and blue for near, mid and far
+    int shading_lod = 1;
+    float lod_mid_distance = 200.0f;
+    float lod_far_distance = 500.0f;
+    float lod_blend_range = 60.0f;
+    // depth-only pass of the terrain before the shaded one
+    bool depth_prepass = false;
+    // write the materials into a g-buffer and light every pixel once
+    bool deferred_shading = false;
+    // tessellate a chunk once and draw the recorded vertices in every pass and frame until its levels change
+    bool capture_tessellation = false;
+    // 0 tessellated patches, 1 cdlod grids, which need no tessellation shaders
+    int terrain_renderer = 0;
+    // skip the patches hidden behind nearer terrain, see terrain::cull_below_horizon
+    bool horizon_culling = false;
+    // draw the frame at a resolution that keeps its gpu time in the budget and stretch it over the window
+    bool scale_resolution = false;
+    utilities::dynamic_resolution resolution;
+    bool sharpen_upscale = true;
+    float upscale_sharpness = 0.5f;
+
+    // slope band of the splat map, in degrees
+    float slope_start = splat_settings.slope_start;
+    float slope_end = splat_settings.slope_end;
 
     float triplanar_scale = 0.02;
     int triplanar_sharpness = 8;
 
     float ambient_strength = 0.1;
+    // gpu time and primitives of every pass of the frame, the passes must not overlap
+    enum gpu_pass : std::size_t {
+        terrain_pass, normal_pass, sky_box_pass, upscale_pass, im_gui_pass, texture_upload_pass, chunk_upload_pass
+    };
+    utilities::gpu_profiler profiler({"terrain", "normal", "sky box", "upscale", "imgui", "texture uploads",
+                                      "chunk uploads"});
+    bool write_profile = false;
+
+    // shaded samples of the terrain pass, measured with queries read one frame late
+    unsigned int terrain_queries[2];
+    glGenQueries(2, terrain_queries);
+    unsigned int frame_count = 0;
+    float terrain_pass_samples = 0.0f;
+    // start and end of the gpu work of a frame, read one frame late like the terrain queries
+    unsigned int frame_timestamps[4];
+    glGenQueries(4, frame_timestamps);
+    // framebuffer the frame is drawn into, the scene target while the resolution is scaled
+    unsigned int frame_fbo = 0;
+
+    // gpu time of the terrain pass and difference to triplanar of every projection mode,
+    // measured on request for the current view, empty until then
+    const std::vector<std::string> projection_names = {"triplanar", "biplanar", "dominant axis"};
+    bool compare_projections = false;
+    std::vector<utilities::render_comparison> projection_comparison;
+
+    // the same for the render paths: forward, forward with pre-pass, deferred, deferred with pre-pass
+    const std::vector<std::string> render_path_names = {"forward", "forward + pre-pass", "deferred",
+                                                        "deferred + pre-pass"};
+    bool compare_paths = false;
+    std::vector<utilities::render_comparison> render_path_comparison;
+
+    // the same for the renderers, with the triangles they draw
+    const std::vector<std::string> renderer_names = {"tessellation", "cdlod"};
+    bool compare_renderers = false;
+    std::vector<utilities::render_comparison> renderer_comparison;
+
+    // throughput of the material fetches, measured once the texture arrays are uploaded
+    bool benchmark_material = false;
+    bool material_benchmarked = false;
+    utilities::material_fetch_result material_fetch;
+
+    // tessellation level of a captured chunk, halved for every ring of chunks around the camera down to the minimum.
+    // 16 segments per patch is one quad per height map texel, the 64 of the tessellated path would not fit in memory
+    const terrain::capture_settings capture_settings{16, 4};
+    // raised when the heights or the normals change, the chunks are captured again
+    unsigned int capture_version = 1;
+    // chunks holding a capture, it is released when they leave the render distance
+    std::vector<terrain::map_chunk *> captured_chunks;
+    int chunks_captured = 0;
+
+    // patches of the chunks in render distance in the order they are drawn, patch_numbers * patch_numbers per chunk
+    std::vector<terrain::horizon_patch> horizon_patches;
+    std::vector<unsigned char> patch_visible;
+    std::vector<unsigned char> chunk_visible;
+    // runs of visible patches of a chunk for glMultiDrawArrays
+    std::vector<GLint> patch_firsts;
+    std::vector<GLsizei> patch_counts;
+    float culled_patch_fraction = 0.0f;
+    float culled_chunk_fraction = 0.0f;
+    float horizon_culling_time = 0.0f;
+
+    // camera path recorded every frame and replayed as a benchmark without vsync, see utilities::camera_path
+    const std::string camera_path_file = "camera_path.cpath";
+    const std::string replay_report_file = "replay_report.json";
+    bool recording_path = false;
+    std::vector<utilities::camera_pose> recorded_path;
+    bool replaying = false;
+    std::vector<utilities::camera_pose> replay_path;
+    std::size_t replay_frame = 0;
+    // 0 waits for every chunk in render distance before a frame, outside of its time,
+    // 1 leaves the waiting to the frame like in normal use
+    int replay_wait_policy = 0;
+    const std::string replay_wait_policy_names[2] = {"wait", "stream"};
+    double replay_frame_start = 0.0;
+    std::vector<float> replay_frame_times;
+    std::vector<float> replay_chunk_latencies;
+    // chunks that entered the render distance during the replay, and when for those not drawable yet
+    std::unordered_set<std::pair<int, int>, terrain::pair_hash> replay_seen_chunks;
+    std::unordered_map<std::pair<int, int>, double, terrain::pair_hash> replay_pending_chunks;
+    bool replay_reported = false;
+    utilities::replay_report last_replay_report;
+
+    auto start_replay = [&](const std::string &path) {
+        try {
+            replay_path = utilities::read_camera_path(path);
+        } catch (std::exception &e) {
+            std::cout << e.what() << std::endl;
+            replay_path.clear();
+        }
+
+        if (!replay_path.empty()) {
+            replaying = true;
+            replay_frame = 0;
+            replay_frame_times.clear();
+            replay_chunk_latencies.clear();
+            replay_seen_chunks.clear();
+            replay_pending_chunks.clear();
+            // frames as fast as they are drawn
+            if (!headless)
+                glfwSwapInterval(0);
+        }
+    };
+
     float light_x = 1.0f;
     float light_y = 1000.0f;
     float light_z = 1.0f;
 
     // callback for im_gui
     std::function<void()> gui_config_callback = [&]() {
-        ImGui::Text("time = %f", glfwGetTime());
+        ImGui::Text("time = %f", get_time());
         ImGui::SliderFloat("Y: ", &y_value, 0, 0.01f, "%.6f");
-        ImGui::SliderFloat("HEIGHT_SCALE: ", &HEIGHT_SCALE, 0.0f, 1.0f);
+        if (ImGui::SliderFloat("HEIGHT_SCALE: ", &HEIGHT_SCALE, 0.0f, 1.0f))
+            ++capture_version;
         ImGui::Checkbox("Show Normal: ", &show_normal);
         ImGui::RadioButton("No Texture: ", &texture_mode, 0);
         ImGui::RadioButton("General Texture: ", &texture_mode, 1);
         ImGui::RadioButton("Triplanar Texture: ", &texture_mode, 2);
+        ImGui::RadioButton("Triplanar Projection: ", &projection_mode, 0);
+        ImGui::RadioButton("Biplanar Projection: ", &projection_mode, 1);
+        ImGui::RadioButton("Dominant Axis Projection: ", &projection_mode, 2);
+        ImGui::RadioButton("Full Shading: ", &shading_lod, 0);
+        ImGui::RadioButton("Shading LOD: ", &shading_lod, 1);
+        ImGui::RadioButton("Show Shading LOD: ", &shading_lod, 2);
+        ImGui::SliderFloat("lod_mid_distance: ", &lod_mid_distance, 0.0f, view_distance);
+        ImGui::SliderFloat("lod_far_distance: ", &lod_far_distance, lod_mid_distance, view_distance);
+        ImGui::SliderFloat("lod_blend_range: ", &lod_blend_range, 1.0f, 200.0f);
         ImGui::Checkbox("Enable Tangent: ", &enable_tangent);
         ImGui::Checkbox("Use Whiteout: ", &use_whiteout);
         ImGui::Checkbox("Gamma Correction: ", &gamma_correction);
@@ -267,142 +575,860 @@ int main() {
         ImGui::RadioButton("PBR Lighting: ", &light_mode, 2);
 
         ImGui::NewLine();
-        ImGui::InputFloat("scale: ", &scale, 0, 0.00005f, "%.6f");
-        ImGui::SliderInt("layer_count: ", &layer_count, 1, 10);
+        bool noise_changed = ImGui::InputFloat("scale: ", &scale, 0, 0.00005f, "%.6f");
+        noise_changed |= ImGui::SliderInt("layer_count: ", &layer_count, 1, 10);
+        if (noise_changed)
+            publish_generation_parameters();
+        // published with the next snapshot. the chunk loader generates with the octave function, which does not
+        // take them yet, so they do not regenerate the chunks on their own
         ImGui::InputFloat("lacunarity: ", &lacunarity, 0, 0.01f);
         ImGui::InputFloat("layer_lacunarity: ", &layer_lacunarity, 0, 0.01f);
         ImGui::InputFloat("layer_amplitude: ", &layer_amplitude, 0, 0.01f);
+        ImGui::TextDisabled("lacunarity and amplitudes: not used by the octave generation yet");
 
         ImGui::SliderFloat("ambient_strength: ", &ambient_strength, 0, 1);
         ImGui::InputFloat("light_x: ", &light_x);
         ImGui::InputFloat("light_y: ", &light_y);
         ImGui::InputFloat("light_z: ", &light_z);
-        ImGui::SliderFloat("DISP: ", &DISP, 0.0f, 1.0f);
 
         ImGui::SliderFloat("tri_scale: ", &triplanar_scale, 0.0f, 0.1f);
         ImGui::SliderInt("tri_sharpness: ", &triplanar_sharpness, 1, 8);
 
-        if (ImGui::Button("Generate Map")) {
+        const utilities::gpu_pass_statistics &terrain_statistics = profiler.get_statistics(terrain_pass);
+        ImGui::Text("terrain pass: %.3f ms, %.1f Msamples/s, %.2f M triangles", terrain_statistics.mean_time,
+                    terrain_statistics.mean_time > 0.0f
+                    ? terrain_pass_samples / (terrain_statistics.mean_time * 1000.0f) : 0.0f,
+                    terrain_statistics.mean_primitives / 1e6f);
+        ImGui::Text("terrain shader variants: %zu", terrain_shader.variant_count());
+
+        // the primitives of the terrain pass are the tessellated triangles, or the recorded ones while capturing
+        for (std::size_t pass = 0; pass < profiler.pass_count(); ++pass) {
+            const utilities::gpu_pass_statistics &statistics = profiler.get_statistics(pass);
+            if (statistics.sample_count == 0) continue;
+            ImGui::Text("%s: %.3f ms, p95 %.3f, p99 %.3f, %llu primitives", profiler.get_pass_name(pass).c_str(),
+                        statistics.mean_time, statistics.p95_time, statistics.p99_time,
+                        static_cast<unsigned long long>(statistics.primitives));
+        }
+        if (replaying) {
+            ImGui::Text("replaying frame %zu of %zu", replay_frame + 1, replay_path.size());
+        } else {
+            if (ImGui::Button(recording_path ? "Stop Recording" : "Record Camera Path")) {
+                if (!recording_path) {
+                    recorded_path.clear();
+                } else {
+                    try {
+                        utilities::write_camera_path(camera_path_file, recorded_path);
+                        std::cout << recorded_path.size() << " frames written to " << camera_path_file << std::endl;
+                    } catch (std::exception &e) {
+                        std::cout << e.what() << std::endl;
+                    }
+                }
+                recording_path = !recording_path;
+            }
+            if (recording_path)
+                ImGui::Text("recorded frames: %zu", recorded_path.size());
 
-            int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
-            int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
+            ImGui::RadioButton("Replay Waits For Chunks: ", &replay_wait_policy, 0);
+            ImGui::RadioButton("Replay Streams Chunks: ", &replay_wait_policy, 1);
+            if (!recording_path && ImGui::Button("Replay Camera Path"))
+                start_replay(camera_path_file);
+        }
+        if (replay_reported) {
+            ImGui::Text("replay: %zu frames, p50 %.2f ms, p95 %.2f, p99 %.2f, %zu hitches",
+                        last_replay_report.frame_count, last_replay_report.p50_time, last_replay_report.p95_time,
+                        last_replay_report.p99_time, last_replay_report.hitch_count);
+            ImGui::Text("chunks: %zu, max latency %.1f ms", last_replay_report.chunk_count,
+                        last_replay_report.max_chunk_latency);
+        }
 
-            for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
-                for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
+        if (ImGui::Button("Dump CPU Trace")) {
+            if (utilities::write_chrome_trace("cpu_trace.json"))
+                std::cout << "cpu trace written to cpu_trace.json" << std::endl;
+            else
+                std::cout << "failed to write cpu_trace.json" << std::endl;
+        }
+        if (ImGui::Checkbox("Write Profile CSV: ", &write_profile)) {
+            if (!write_profile)
+                profiler.close_csv();
+            else if (!profiler.open_csv("gpu_profile.csv")) {
+                std::cout << "failed to open gpu_profile.csv" << std::endl;
+                write_profile = false;
+            }
+        }
 
-                    terrain::map_chunk &map = map_data.at({x, y});
+        if (ImGui::Button("Compare Projections"))
+            compare_projections = true;
+        for (auto &mode: projection_comparison) {
+            ImGui::Text("%s: %.3f ms, mae %.4f, psnr %.1f dB", mode.name.c_str(), mode.time,
+                        mode.difference.mean_absolute_error, mode.difference.psnr);
+        }
 
-                    //                terrain::get_height_map(map.second.height_data, perlin, map_width, map_height,
-//                                        scale, layer_count, lacunarity, layer_lacunarity, layer_amplitude,
-//                                        static_cast<float >(map.second.grid_x), static_cast<float>(map.second.grid_y));
+        ImGui::Checkbox("Depth Pre-pass: ", &depth_prepass);
+        ImGui::Checkbox("Deferred Shading: ", &deferred_shading);
+        ImGui::Checkbox("Capture Tessellation: ", &capture_tessellation);
+        if (capture_tessellation) {
+            std::size_t capture_bytes = 0;
+            for (auto *chunk: captured_chunks)
+                capture_bytes += chunk->capture.vertex_capacity * 10 * sizeof(float);
+            ImGui::Text("captured chunks: %zu, %.1f MB, %d in the last pass", captured_chunks.size(),
+                        static_cast<double>(capture_bytes) / (1024.0 * 1024.0), chunks_captured);
+        }
+        ImGui::RadioButton("Tessellation Renderer: ", &terrain_renderer, 0);
+        ImGui::RadioButton("CDLOD Renderer: ", &terrain_renderer, 1);
+        ImGui::Checkbox("Dynamic Resolution: ", &scale_resolution);
+        if (scale_resolution) {
+            ImGui::SliderFloat("Frame Budget (ms): ", &resolution.target_time, 4.0f, 50.0f);
+            // the scene target has the native size, the scale cannot go above 1
+            ImGui::SliderFloat("Min Scale: ", &resolution.min_scale, 0.25f, 1.0f);
+            ImGui::SliderFloat("Max Scale: ", &resolution.max_scale, 0.25f, 1.0f);
+            resolution.max_scale = std::max(resolution.max_scale, resolution.min_scale);
+            resolution.scale = std::clamp(resolution.scale, resolution.min_scale, resolution.max_scale);
+            ImGui::Checkbox("Sharpen Upscale: ", &sharpen_upscale);
+            if (sharpen_upscale)
+                ImGui::SliderFloat("Sharpness: ", &upscale_sharpness, 0.0f, 1.0f);
+            ImGui::Text("scale: %.2f, %d x %d, gpu frame: %.2f ms", resolution.scale,
+                        utilities::get_scaled_size(SCR_WIDTH, resolution.scale),
+                        utilities::get_scaled_size(SCR_HEIGHT, resolution.scale), resolution.frame_time);
+        }
+        ImGui::Checkbox("Horizon Culling: ", &horizon_culling);
+        if (horizon_culling) {
+            ImGui::Text("culled patches: %.1f%%, chunks: %.1f%%, %.3f ms", culled_patch_fraction * 100.0f,
+                        culled_chunk_fraction * 100.0f, horizon_culling_time);
+        }
+        if (ImGui::Button("Compare Renderers"))
+            compare_renderers = true;
+        for (auto &renderer: renderer_comparison) {
+            ImGui::Text("%s: %.3f ms, %.2f M triangles, mae %.4f", renderer.name.c_str(), renderer.time,
+                        static_cast<double>(renderer.primitives) / 1e6, renderer.difference.mean_absolute_error);
+        }
 
-                    terrain::get_height_map(map.height_data, perlin, texture_width, texture_height,
-                                            scale, layer_count, static_cast<float >(map.grid_x),
-                                            static_cast<float>(map.grid_y));
+        if (ImGui::Button("Compare Render Paths"))
+            compare_paths = true;
+        for (auto &path: render_path_comparison) {
+            ImGui::Text("%s: %.3f ms, mae %.4f, max %.3f", path.name.c_str(), path.time,
+                        path.difference.mean_absolute_error, path.difference.max_error);
+        }
 
-                    glBindTexture(GL_TEXTURE_2D, map.height_map_id);
-                    // to support non-power-of-two heightmap textures
-                    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (diff_ready && norm_ready && arm_ready && ImGui::Button("Benchmark Material Fetch"))
+            benchmark_material = true;
+        if (material_benchmarked) {
+            ImGui::Text("texture arrays: %.3f ms, %.0f Mpix/s", material_fetch.texture_arrays.time,
+                        material_fetch.texture_arrays.pixel_rate);
+            ImGui::Text("separate samplers: %.3f ms, %.0f Mpix/s", material_fetch.separate_samplers.time,
+                        material_fetch.separate_samplers.pixel_rate);
+        }
 
-                    // use GL_RED format
-                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, texture_width, texture_height, 0, GL_RED, GL_FLOAT,
-                                 map.height_data.data());
+        if (ImGui::CollapsingHeader("Texture Assets")) {
+            for (auto &asset: texture_pipeline.get_assets()) {
+                if (asset.ready)
+                    ImGui::Text("%s%s: decode %.2f ms, upload %.2f ms", asset.name.c_str(),
+                                asset.cooked ? " (cooked)" : "", asset.decode_time, asset.upload_time);
+                else
+                    ImGui::Text("%s: loading...", asset.name.c_str());
+            }
+            for (auto &array: texture_pipeline.get_arrays()) {
+                if (array.ready)
+                    ImGui::Text("%s array: mipmaps %.2f ms", array.name.c_str(), array.mipmap_time);
+            }
+        }
 
-                    // generate mipmap for texture
-                    glGenerateMipmap(GL_TEXTURE_2D);
-                }
+        if (ImGui::CollapsingHeader("Splat Map")) {
+            bool splat_changed = false;
+            // every band stays between its neighbours
+            for (std::size_t i = 1; i + 1 < height.size(); ++i) {
+                std::string label = material_layers[i] + " height: ";
+                splat_changed |= ImGui::SliderFloat(label.c_str(), &height[i], height[i - 1], height[i + 1]);
+            }
+            splat_changed |= ImGui::SliderFloat("slope_start: ", &slope_start, 0.0f, 90.0f);
+            splat_changed |= ImGui::SliderFloat("slope_end: ", &slope_end, slope_start, 90.0f);
+
+            // only the splat maps are rebuilt, the heights stay
+            if (splat_changed) {
+                splat_settings.height_bands = height;
+                splat_settings.slope_start = slope_start;
+                splat_settings.slope_end = std::max(slope_end, slope_start);
+                chunk_loader.set_splat_settings(splat_settings);
             }
         }
+
+        bool caching = chunk_loader.octave_caching;
+        if (ImGui::Checkbox("Octave Caching: ", &caching))
+            chunk_loader.octave_caching = caching;
+        ImGui::Text("octave cache: %.1f MB, %d octaves computed per texel for the last regenerated chunk",
+                    static_cast<float>(chunk_loader.octave_cache_size) / (1024.0f * 1024.0f),
+                    chunk_loader.generated_octaves.load());
+
+        bool progressive = chunk_loader.progressive_generation;
+        if (ImGui::Checkbox("Progressive Generation: ", &progressive))
+            chunk_loader.progressive_generation = progressive;
+        ImGui::Text("coarse chunks: %d", chunk_loader.coarse_chunk_count.load());
+
+        // the same parameters again, the chunk loader regenerates every chunk in the background
+        if (ImGui::Button("Generate Map"))
+            publish_generation_parameters();
     };
 
 #pragma endregion option
 
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-//    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    while (!glfwWindowShouldClose(window)) {
+#pragma region terrain pass
+
+    // textures of the chunks the chunk loader hands over in chunk_loader.update
+    auto upload_chunk = [&](terrain::map_chunk &chunk, terrain::chunk_update update) {
+        switch (update) {
+            case terrain::chunk_update::created:
+                load_height_map_task(chunk);
+                break;
+            case terrain::chunk_update::regenerated:
+                // chunks without textures yet take the new data when they are loaded
+                if (chunk.height_map_id != 0) {
+                    terrain::reload_height_map(chunk.height_map_id, texture_width, texture_height, chunk.height_data);
+                    terrain::update_splat_map(chunk.splat_map_id, texture_width, texture_height, chunk.splat_data);
+                }
+                // captured again with the new heights
+                chunk.capture.version = 0;
+                break;
+            case terrain::chunk_update::splat_rebuilt:
+                if (chunk.splat_map_id != 0)
+                    terrain::update_splat_map(chunk.splat_map_id, texture_width, texture_height, chunk.splat_data);
+                break;
+            case terrain::chunk_update::evicted:
+                // every chunk is kept, evict_range is 0
+                break;
+        }
+    };
 
-        utilities::config_im_gui_loop("Debug", gui_config_callback);
+    // the chunk at a grid position, waits for the chunk loader if it is not generated yet
+    auto wait_for_chunk = [&](int x, int y) -> terrain::map_chunk & {
+        if (!map_data.contains({x, y})) {
+            std::cout << "waiting for chunk " << x << ", " << y << std::endl;
+            chunk_loader.insert_new_chunks(upload_chunk);
+            while (!map_data.contains({x, y})) {
+                poll_events();
+                std::this_thread::yield();
+                chunk_loader.insert_new_chunks(upload_chunk);
+            }
+        }
+        return map_data.at({x, y});
+    };
 
-        // per-frame time logic
-        // --------------------
-        auto currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+    // variant of the terrain shader for the options and the textures loaded so far
+    auto terrain_defines = [&](int projection) -> utilities::shader_defines {
+        return {
+                {"TEXTURE_MODE",     std::to_string(diff_ready ? texture_mode : 0)},
+                {"LIGHT_MODE",       std::to_string(light_mode)},
+                {"ENABLE_TANGENT",   enable_tangent && norm_ready ? "1" : "0"},
+                {"USE_WHITEOUT",     use_whiteout ? "1" : "0"},
+                {"GAMMA_CORRECTION", gamma_correction ? "1" : "0"},
+                {"USE_ARM",          arm_ready ? "1" : "0"},
+                {"PROJECTION_MODE",  std::to_string(projection)},
+                {"SHADING_LOD",      std::to_string(shading_lod)}
+        };
+    };
 
-        utilities::process_input(window, cam, deltaTime, 0.5f);
+    // index of a chunk in the order the chunks in render distance are drawn
+    auto chunk_index = [&](int x, int y, int current_grid_x, int current_grid_y) -> int {
+        return (x - current_grid_x + render_distance) * (2 * render_distance + 1) + (y - current_grid_y + render_distance);
+    };
 
-        // render
-        // ------
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // find the patches and chunks in render distance that are hidden behind nearer terrain from the camera,
+    // waits for chunks that are not generated yet
+    auto cull_terrain = [&]() {
+        TRACE_SCOPE("cull_terrain");
+        auto cull_start = std::chrono::steady_clock::now();
 
-        // render the triangle
-        glBindVertexArray(terrain_vao);
+        int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
+        int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
+        const int patches = static_cast<int>(patch_numbers);
+        const float patch_size = static_cast<float>(map_width) / static_cast<float>(patches);
+        const int chunk_patches = patches * patches;
 
-        glm::mat4 projection = cam.get_projection_matrix(SCR_WIDTH, SCR_HEIGHT, 0.1f, view_distance);
+        horizon_patches.clear();
 
-        // camera/view transformation
-        glm::mat4 view = cam.get_view_matrix();
+        for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
+            for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
+                terrain::map_chunk &map = wait_for_chunk(x, y);
+                glm::vec2 chunk_corner(static_cast<float>(map.grid_x * map_width) - map_width * 0.5f,
+                                       static_cast<float>(map.grid_y * map_height) - map_height * 0.5f);
+
+                // the same order as the patches in terrain_vao
+                for (int i = 0; i < patches; ++i) {
+                    for (int j = 0; j < patches; ++j) {
+                        int patch = i * patches + j;
+                        glm::vec2 min_corner = chunk_corner + glm::vec2(i, j) * patch_size;
+                        horizon_patches.push_back({
+                                min_corner, min_corner + patch_size,
+                                map.patch_min_heights[patch] * terrain_height - terrain_height / 3.0f,
+                                map.patch_max_heights[patch] * terrain_height - terrain_height / 3.0f
+                        });
+                    }
+                }
+            }
+        }
 
-        // calculate the model matrix for each object and pass it to shader before drawing
-        glm::mat4 model = glm::mat4(1.0f);
+        std::size_t culled_patches = terrain::cull_below_horizon(horizon_patches, cam.position, patch_visible);
 
-#pragma region render terrain
+        std::size_t chunk_count = horizon_patches.size() / chunk_patches;
+        std::size_t culled_chunks = 0;
+        chunk_visible.assign(chunk_count, 0);
+        for (std::size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            auto first = patch_visible.begin() + static_cast<std::ptrdiff_t>(chunk * chunk_patches);
+            chunk_visible[chunk] = std::find(first, first + chunk_patches, 1) != first + chunk_patches;
+            if (!chunk_visible[chunk]) ++culled_chunks;
+        }
 
-        terrain_shader.use();
-        terrain_shader
-                .set_mat4("projection", projection)
-                .set_mat4("view", view)
-                .set_vec3("light.view_pos", cam.position)
-                .set_vec3("light.light_pos", glm::vec3(light_x, light_y, light_z))
-                .set_vec3("light.light_color", glm::vec3(1, 1, 1))
-                .set_float("light.ambient_strength", ambient_strength)
-                .set_float("y_value", y_value)
-                .set_float("HEIGHT_SCALE", HEIGHT_SCALE)
-                .set_float("material.triplanar_scale", triplanar_scale)
-                .set_int("material.triplanar_sharpness", triplanar_sharpness)
-                .set_bool("enable_tangent", enable_tangent)
-                .set_bool("use_whiteout", use_whiteout)
-                .set_bool("gamma_correction", gamma_correction)
-                .set_int("light_mode", light_mode)
-                .set_int("texture_mode", texture_mode);
+        culled_patch_fraction = static_cast<float>(culled_patches) / static_cast<float>(horizon_patches.size());
+        culled_chunk_fraction = static_cast<float>(culled_chunks) / static_cast<float>(chunk_count);
+        horizon_culling_time = std::chrono::duration<float, std::milli>(
+                std::chrono::steady_clock::now() - cull_start).count();
+    };
+
+    // draw every chunk in render distance with the program in use, waits for chunks that are not generated yet
+    auto draw_chunks = [&](utilities::shader &program) {
+        glBindVertexArray(terrain_vao);
+        const int chunk_patches = static_cast<int>(patch_numbers * patch_numbers);
 
         int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
         int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
 
         for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
             for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
+                terrain::map_chunk &map = wait_for_chunk(x, y);
 
-                while (!map_data.contains({x, y})) {
-                    glfwPollEvents();
-                    std::cout << "waiting for chunk loading..." << std::endl;
-                }
+                if (map.height_map_id == 0) { load_height_map_task(map); }
 
-                terrain::map_chunk &map = map_data.at({x, y});
+                int chunk = chunk_index(x, y, current_grid_x, current_grid_y);
+                if (horizon_culling && !chunk_visible[chunk]) continue;
 
-                if (map.height_map_id == 0) { load_height_map_task(map); }
+                glActiveTexture(GL_TEXTURE0 + splat_texture_index);
+                glBindTexture(GL_TEXTURE_2D, map.splat_map_id);
 
                 glActiveTexture(GL_TEXTURE0);
                 glBindTexture(GL_TEXTURE_2D, map.height_map_id);
-                model = glm::mat4(1.0f);
+                glm::mat4 model = glm::mat4(1.0f);
                 model = glm::translate(model, glm::vec3
                         (
                                 map.grid_x * map_width,
                                 0,
                                 map.grid_y * map_height
                         ));
-                terrain_shader
+                program
                         .set_mat4("model", model);
 
-                glDrawArrays(GL_PATCHES, 0, static_cast<GLsizei>(NUM_PATCH_PTS * patch_numbers * patch_numbers));
+                if (!horizon_culling) {
+                    glDrawArrays(GL_PATCHES, 0, static_cast<GLsizei>(NUM_PATCH_PTS * patch_numbers * patch_numbers));
+                    continue;
+                }
+
+                // neighbouring visible patches are drawn as one run
+                patch_firsts.clear();
+                patch_counts.clear();
+                int first_patch = chunk * chunk_patches;
+                for (int patch = 0; patch < chunk_patches; ++patch) {
+                    if (!patch_visible[first_patch + patch]) continue;
+
+                    auto first_vertex = static_cast<GLint>(NUM_PATCH_PTS * patch);
+                    if (!patch_counts.empty() && patch_firsts.back() + patch_counts.back() == first_vertex)
+                        patch_counts.back() += static_cast<GLsizei>(NUM_PATCH_PTS);
+                    else {
+                        patch_firsts.push_back(first_vertex);
+                        patch_counts.push_back(static_cast<GLsizei>(NUM_PATCH_PTS));
+                    }
+                }
+
+                glMultiDrawArrays(GL_PATCHES, patch_firsts.data(), patch_counts.data(),
+                                  static_cast<GLsizei>(patch_counts.size()));
+            }
+        }
+    };
+
+    // the captures belong to the tessellated renderer
+    auto use_captures = [&]() { return terrain_renderer == 0 && capture_tessellation; };
+
+    auto release_captures = [&]() {
+        for (auto *chunk: captured_chunks)
+            terrain::delete_terrain_capture(chunk->capture);
+        captured_chunks.clear();
+    };
+
+    // record the tessellation of every chunk in render distance whose levels or heights changed since its capture,
+    // release the captures of the chunks that left the render distance
+    auto capture_chunks = [&]() {
+        TRACE_SCOPE("capture_chunks");
+        int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
+        int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
+
+        std::erase_if(captured_chunks, [&](terrain::map_chunk *chunk) {
+            if (std::abs(chunk->grid_x - current_grid_x) <= render_distance &&
+                std::abs(chunk->grid_y - current_grid_y) <= render_distance)
+                return false;
+            terrain::delete_terrain_capture(chunk->capture);
+            return true;
+        });
+
+        chunks_captured = 0;
+
+        for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
+            for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
+                terrain::map_chunk &map = wait_for_chunk(x, y);
+
+                if (map.height_map_id == 0) { load_height_map_task(map); }
+
+                int level = terrain::get_capture_level(x, y, current_grid_x, current_grid_y, capture_settings);
+                std::array<int, 4> border_levels =
+                        terrain::get_capture_border_levels(x, y, current_grid_x, current_grid_y, capture_settings);
+                if (terrain::is_capture_current(map.capture, level, border_levels, capture_version))
+                    continue;
+
+                if (map.capture.vao == 0) captured_chunks.push_back(&map);
+                if (chunks_captured++ == 0)
+                    terrain::begin_terrain_capture(terrain_capture_shader, HEIGHT_SCALE);
+
+                terrain::capture_chunk(map, terrain_capture_shader, terrain_vao, patch_numbers, NUM_PATCH_PTS,
+                                       static_cast<float>(map_width), level, border_levels, capture_version);
+            }
+        }
+
+        if (chunks_captured > 0)
+            terrain::end_terrain_capture();
+    };
+
+    // draw the captures of the chunks in render distance with the program in use, see capture_chunks
+    auto draw_captured_chunks = [&]() {
+        int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
+        int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
+
+        for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
+            for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
+
+                terrain::map_chunk &map = map_data.at({x, y});
+
+                // a capture holds the whole chunk, only chunks hidden completely are skipped
+                if (horizon_culling && !chunk_visible[chunk_index(x, y, current_grid_x, current_grid_y)]) continue;
+
+                terrain::draw_terrain_capture(map, splat_texture_index);
+            }
+        }
+
+        glActiveTexture(GL_TEXTURE0);
+    };
+
+    // select the nodes of every chunk in render distance and draw them as instances of one grid
+    // with the program in use, waits for chunks that are not generated yet
+    auto draw_cdlod_chunks = [&](utilities::shader &program) {
+        int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
+        int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
+
+        cdlod_nodes.clear();
+        cdlod_chunks.clear();
+
+        for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
+            for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
+                terrain::map_chunk &map = wait_for_chunk(x, y);
+
+                if (map.height_map_id == 0) { load_height_map_task(map); }
+
+                // the nodes of a chunk span its patches, only chunks hidden completely are skipped
+                if (horizon_culling && !chunk_visible[chunk_index(x, y, current_grid_x, current_grid_y)]) continue;
+
+                terrain::select_cdlod_chunk(cdlod_nodes, cdlod_chunks, map, static_cast<float>(map_width),
+                                            cam.position, cdlod_settings);
+            }
+        }
+
+        terrain::draw_cdlod_chunks(program, cdlod_mesh, cdlod_nodes, cdlod_chunks, cam.position,
+                                   static_cast<float>(map_width), cdlod_settings, splat_texture_index);
+    };
+
+    // light of the forward terrain shader and the deferred lighting pass
+    auto set_light = [&](utilities::shader &program) {
+        program
+                .set_vec3("light.view_pos", cam.position)
+                .set_vec3("light.light_pos", glm::vec3(light_x, light_y, light_z))
+                .set_vec3("light.light_color", glm::vec3(1, 1, 1))
+                .set_float("light.ambient_strength", ambient_strength);
+    };
+
+    auto render_terrain = [&](const utilities::shader_defines &defines, const glm::mat4 &projection,
+                              const glm::mat4 &view) {
+        // captured chunks are replayed and cdlod grids are drawn with the same fragment shader
+        utilities::shader &program = terrain_renderer == 1 ? terrain_cdlod_shader
+                                                           : use_captures() ? terrain_replay_shader : terrain_shader;
+
+        // the options select a variant instead of branching on uniforms in the shaders
+        program.use_variant(defines);
+        set_light(program);
+
+        program
+                .set_mat4("projection", projection)
+                .set_mat4("view", view)
+                .set_float("y_value", y_value)
+                .set_float("HEIGHT_SCALE", HEIGHT_SCALE)
+                .set_float("material.triplanar_scale", triplanar_scale)
+                .set_int("material.triplanar_sharpness", triplanar_sharpness)
+                .set_float("shading_lod.mid_distance", lod_mid_distance)
+                .set_float("shading_lod.far_distance", std::max(lod_far_distance, lod_mid_distance))
+                .set_float("shading_lod.blend_range", lod_blend_range);
+
+        if (terrain_renderer == 1)
+            draw_cdlod_chunks(terrain_cdlod_shader);
+        else if (use_captures())
+            draw_captured_chunks();
+        else
+            draw_chunks(terrain_shader);
+    };
+
+    // depth of the terrain only, the same vertex and tessellation shaders as the colour pass
+    auto render_terrain_depth = [&](const glm::mat4 &projection, const glm::mat4 &view) {
+        if (terrain_renderer == 1) {
+            terrain_cdlod_depth_shader.use();
+            terrain_cdlod_depth_shader
+                    .set_mat4("projection", projection)
+                    .set_mat4("view", view)
+                    .set_float("HEIGHT_SCALE", HEIGHT_SCALE);
+
+            draw_cdlod_chunks(terrain_cdlod_depth_shader);
+            return;
+        }
+
+        if (use_captures()) {
+            terrain_replay_depth_shader.use();
+            terrain_replay_depth_shader
+                    .set_mat4("projection", projection)
+                    .set_mat4("view", view);
+
+            draw_captured_chunks();
+            return;
+        }
+
+        terrain_depth_shader.use();
+        terrain_depth_shader
+                .set_mat4("projection", projection)
+                .set_mat4("view", view)
+                .set_float("HEIGHT_SCALE", HEIGHT_SCALE);
+
+        draw_chunks(terrain_depth_shader);
+    };
+
+    // the terrain into the default framebuffer, shaded forward or through the g-buffer,
+    // the depth pre-pass lets only the visible fragments of overlapping hills reach the material shader
+    auto render_terrain_path = [&](const utilities::shader_defines &defines, const glm::mat4 &projection,
+                                   const glm::mat4 &view, bool prepass, bool deferred) {
+        TRACE_SCOPE("render_terrain_path");
+        // nothing is tessellated while the levels of the chunks stay the same
+        if (use_captures())
+            capture_chunks();
+
+        // every pass of the frame draws the same patches
+        if (horizon_culling)
+            cull_terrain();
+
+        if (deferred) {
+            glBindFramebuffer(GL_FRAMEBUFFER, terrain_g_buffer.fbo);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        if (prepass) {
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            render_terrain_depth(projection, view);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            // the depth is final, GL_LEQUAL passes exactly the fragments that won the pre-pass
+            glDepthMask(GL_FALSE);
+        }
+
+        if (deferred) {
+            // the g-buffer variant leaves the lighting to the lighting pass
+            auto g_buffer_defines = defines;
+            g_buffer_defines["DEFERRED"] = "1";
+            g_buffer_defines.erase("LIGHT_MODE");
+            g_buffer_defines.erase("GAMMA_CORRECTION");
+            render_terrain(g_buffer_defines, projection, view);
+        } else {
+            render_terrain(defines, projection, view);
+        }
+
+        glDepthMask(GL_TRUE);
+
+        if (!deferred) return;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, frame_fbo);
+
+        terrain_lighting_shader.use_variant({
+                {"LIGHT_MODE",       defines.at("LIGHT_MODE")},
+                {"GAMMA_CORRECTION", defines.at("GAMMA_CORRECTION")}
+        });
+        set_light(terrain_lighting_shader);
+        terrain_lighting_shader.set_mat4("inverse_view_projection", glm::inverse(projection * view));
+
+        glActiveTexture(GL_TEXTURE0 + g_albedo_texture_index);
+        glBindTexture(GL_TEXTURE_2D, terrain_g_buffer.albedo_id);
+        glActiveTexture(GL_TEXTURE0 + g_normal_texture_index);
+        glBindTexture(GL_TEXTURE_2D, terrain_g_buffer.normal_id);
+        glActiveTexture(GL_TEXTURE0 + g_arm_texture_index);
+        glBindTexture(GL_TEXTURE_2D, terrain_g_buffer.arm_id);
+        glActiveTexture(GL_TEXTURE0 + g_depth_texture_index);
+        glBindTexture(GL_TEXTURE_2D, terrain_g_buffer.depth_id);
+        glActiveTexture(GL_TEXTURE0);
+
+        // the lighting pass copies the depth of the g-buffer for the sky box and the normal pass
+        glDepthFunc(GL_ALWAYS);
+        render_quad();
+        glDepthFunc(GL_LEQUAL);
+    };
+
+    // render the view with every projection mode, time the terrain pass and compare the image to triplanar
+    auto compare_projection_modes = [&](const glm::mat4 &projection, const glm::mat4 &view) {
+        projection_comparison = utilities::compare_renders(projection_names, [&](std::size_t mode) {
+            render_terrain_path(terrain_defines(static_cast<int>(mode)), projection, view, depth_prepass,
+                                deferred_shading);
+        }, SCR_WIDTH, SCR_HEIGHT);
+    };
+
+    // render the view forward and deferred, with and without the pre-pass, and compare the images to forward
+    auto compare_render_paths = [&](const glm::mat4 &projection, const glm::mat4 &view) {
+        auto defines = terrain_defines(projection_mode);
+        render_path_comparison = utilities::compare_renders(render_path_names, [&](std::size_t path) {
+            render_terrain_path(defines, projection, view, path % 2 == 1, path >= 2);
+        }, SCR_WIDTH, SCR_HEIGHT);
+    };
+
+    // render the view with every renderer, time the terrain pass, count its triangles and compare the image to
+    // the tessellated one
+    auto compare_terrain_renderers = [&](const glm::mat4 &projection, const glm::mat4 &view) {
+        auto defines = terrain_defines(projection_mode);
+        int current_renderer = terrain_renderer;
+        renderer_comparison = utilities::compare_renders(renderer_names, [&](std::size_t renderer) {
+            terrain_renderer = static_cast<int>(renderer);
+            render_terrain_path(defines, projection, view, depth_prepass, deferred_shading);
+        }, SCR_WIDTH, SCR_HEIGHT, true);
+        terrain_renderer = current_renderer;
+    };
+
+#pragma endregion
+
+#pragma region camera path replay
+
+    // note when the chunks in render distance become drawable, a chunk is drawable once its height map is uploaded
+    auto track_replay_chunks = [&]() {
+        double now = get_time();
+
+        int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
+        int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
+
+        for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
+            for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
+                std::pair<int, int> grid(x, y);
+                bool drawable = map_data.contains(grid) && map_data.at(grid).height_map_id != 0;
+
+                if (replay_seen_chunks.insert(grid).second) {
+                    if (drawable)
+                        replay_chunk_latencies.push_back(0.0f);
+                    else
+                        replay_pending_chunks.emplace(grid, now);
+                } else if (auto pending = replay_pending_chunks.find(grid);
+                        drawable && pending != replay_pending_chunks.end()) {
+                    replay_chunk_latencies.push_back(static_cast<float>((now - pending->second) * 1000.0));
+                    replay_pending_chunks.erase(pending);
+                }
             }
         }
+    };
+
+    // generate and upload every chunk in render distance
+    auto wait_for_chunks = [&]() {
+        int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
+        int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
+
+        for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
+            for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
+                load_height_map_task(wait_for_chunk(x, y));
+            }
+        }
+    };
+
+    auto finish_replay = [&]() {
+        replaying = false;
+        if (!headless)
+            glfwSwapInterval(1);
+
+        // chunks still pending left the render distance before they became drawable
+        last_replay_report = utilities::make_replay_report(replay_frame_times, replay_chunk_latencies);
+        replay_reported = true;
+
+        const utilities::replay_report &report = last_replay_report;
+        std::cout << "replay (" << replay_wait_policy_names[replay_wait_policy] << "): " << report.frame_count
+                  << " frames, mean " << report.mean_time << " ms, p50 " << report.p50_time << ", p95 "
+                  << report.p95_time << ", p99 " << report.p99_time << ", max " << report.max_time << ", "
+                  << report.hitch_count << " hitches, " << report.chunk_count << " chunks, max latency "
+                  << report.max_chunk_latency << " ms" << std::endl;
+
+        try {
+            utilities::write_replay_report(replay_report_file, report, replay_wait_policy_names[replay_wait_policy]);
+        } catch (std::exception &e) {
+            std::cout << e.what() << std::endl;
+        }
+    };
+
+#pragma endregion
+
+    if (!start_camera_path.empty()) {
+        start_replay(start_camera_path);
+        if (replaying && headless)
+            headless_frames = static_cast<int>(replay_path.size());
+    }
+    if (headless && !frame_directory.empty())
+        std::filesystem::create_directories(frame_directory);
+    int headless_frame = 0;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, window_fbo);
+    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+//    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    while (headless ? headless_frame < headless_frames : !glfwWindowShouldClose(window)) {
+        TRACE_SCOPE("frame");
+
+        if (!headless)
+            utilities::config_im_gui_loop("Debug", gui_config_callback);
+
+        // per-frame time logic
+        // --------------------
+        auto currentFrame = static_cast<float>(get_time());
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        if (replaying) {
+            // the recorded pose instead of the input, the frame is timed from here to the end of its uploads
+            if (!headless)
+                utilities::process_input(window);
+            const utilities::camera_pose &pose = replay_path[replay_frame];
+            cam.set_pose(pose.position, pose.yaw, pose.pitch, pose.zoom);
+            chunk_loader.set_camera_position(cam.position);
+
+            track_replay_chunks();
+            if (replay_wait_policy == 0) {
+                wait_for_chunks();
+                track_replay_chunks();
+            }
+            replay_frame_start = get_time();
+        } else if (!headless) {
+            utilities::process_input(window, cam, deltaTime, 0.5f);
+            if (recording_path)
+                recorded_path.push_back({cam.position, cam.yaw, cam.pitch, cam.zoom});
+        }
+        chunk_loader.set_camera_position(cam.position);
+
+        glm::mat4 projection = cam.get_projection_matrix(SCR_WIDTH, SCR_HEIGHT, 0.1f, view_distance);
+
+        // camera/view transformation
+        glm::mat4 view = cam.get_view_matrix();
+
+        // the comparison draws into the back buffer before the frame does
+        if (compare_projections) {
+            compare_projection_modes(projection, view);
+            compare_projections = false;
+        }
+        if (compare_paths) {
+            compare_render_paths(projection, view);
+            compare_paths = false;
+        }
+        if (compare_renderers) {
+            compare_terrain_renderers(projection, view);
+            compare_renderers = false;
+        }
+        if (benchmark_material) {
+            material_fetch = utilities::benchmark_material_fetch(
+                    material_fetch_shader, texture_pipeline.get_texture_id(diff_array),
+                    texture_pipeline.get_texture_id(norm_array), texture_pipeline.get_texture_id(arm_array),
+                    static_cast<int>(material_layers.size()), SCR_WIDTH, SCR_HEIGHT);
+            std::cout << "material fetch over " << material_fetch.layer_count << " layers, texture arrays: "
+                      << material_fetch.texture_arrays.time << " ms, separate samplers: "
+                      << material_fetch.separate_samplers.time << " ms" << std::endl;
+            benchmark_material = false;
+            material_benchmarked = true;
+        }
+
+        // the captures are only kept while they are used
+        if (!use_captures() && !captured_chunks.empty())
+            release_captures();
+
+        // render
+        // ------
+
+        // the scaled frame goes into a corner of the scene target and is stretched over the window at the end
+        int frame_width = SCR_WIDTH;
+        int frame_height = SCR_HEIGHT;
+        frame_fbo = window_fbo;
+        if (scale_resolution) {
+            frame_width = utilities::get_scaled_size(SCR_WIDTH, resolution.scale);
+            frame_height = utilities::get_scaled_size(SCR_HEIGHT, resolution.scale);
+            frame_fbo = scene_target.fbo;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, frame_fbo);
+        glViewport(0, 0, frame_width, frame_height);
+
+        unsigned int *timestamps = frame_timestamps + (frame_count % 2) * 2;
+        glQueryCounter(timestamps[0], GL_TIMESTAMP);
+
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+#pragma region render terrain
+
+        // bind every family of material textures as soon as it is completely uploaded
+        if (!texture_pipeline.is_finished()) {
+            profiler.begin_pass(texture_upload_pass);
+            texture_pipeline.upload(texture_upload_budget);
+            profiler.end_pass();
+
+            if (!diff_ready && (diff_ready = texture_pipeline.is_ready(diff_array)))
+                set_texture(texture_pipeline.get_texture_id(diff_array), diff_texture_index);
+            if (!norm_ready && (norm_ready = texture_pipeline.is_ready(norm_array)))
+                set_texture(texture_pipeline.get_texture_id(norm_array), norm_texture_index);
+            if (!arm_ready && (arm_ready = texture_pipeline.is_ready(arm_array)))
+                set_texture(texture_pipeline.get_texture_id(arm_array), arm_texture_index);
+        }
+
+        // queries of this frame go into one half, the other half holds the results of the last frame
+        unsigned int *frame_queries = terrain_queries + (frame_count % 2);
+        profiler.begin_pass(terrain_pass);
+        glBeginQuery(GL_SAMPLES_PASSED, frame_queries[0]);
+
+        render_terrain_path(terrain_defines(projection_mode), projection, view, depth_prepass, deferred_shading);
+
+        glEndQuery(GL_SAMPLES_PASSED);
+        profiler.end_pass();
+
+        if (frame_count++ > 0) {
+            unsigned int *last_queries = terrain_queries + (frame_count % 2);
+            GLuint64 samples;
+            glGetQueryObjectui64v(last_queries[0], GL_QUERY_RESULT, &samples);
+
+            // smooth over roughly the last second
+            terrain_pass_samples = glm::mix(terrain_pass_samples, static_cast<float>(samples), 0.02f);
+
+            unsigned int *last_timestamps = frame_timestamps + (frame_count % 2) * 2;
+            GLuint64 frame_start, frame_end;
+            glGetQueryObjectui64v(last_timestamps[0], GL_QUERY_RESULT, &frame_start);
+            glGetQueryObjectui64v(last_timestamps[1], GL_QUERY_RESULT, &frame_end);
+
+            if (scale_resolution)
+                utilities::update_dynamic_resolution(resolution, static_cast<float>(frame_end - frame_start) / 1e6f);
+        }
 
 #pragma endregion
 
 #pragma region render normal of terrain
 
-        if (show_normal) {
+        if (show_normal)
+            profiler.begin_pass(normal_pass);
+
+        // the captures of the terrain pass are drawn again instead of tessellating the terrain a second time
+        if (show_normal && use_captures()) {
+            normal_replay_shader.use();
+            normal_replay_shader
+                    .set_mat4("projection", projection)
+                    .set_mat4("view", view);
+
+            draw_captured_chunks();
+        } else if (show_normal) {
             normal_shader.use();
             normal_shader
                     .set_mat4("projection", projection)
@@ -410,13 +1436,16 @@ int main() {
                     .set_float("y_value", y_value)
                     .set_float("HEIGHT_SCALE", HEIGHT_SCALE);
 
+            int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
+            int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
+
             for (int x = current_grid_x - render_distance; x <= current_grid_x + render_distance; ++x) {
                 for (int y = current_grid_y - render_distance; y <= current_grid_y + render_distance; ++y) {
 
                     terrain::map_chunk &map = map_data.at({x, y});
 
                     glBindTexture(GL_TEXTURE_2D, map.height_map_id);
-                    model = glm::mat4(1.0f);
+                    glm::mat4 model = glm::mat4(1.0f);
                     model = glm::translate(model, glm::vec3
                             (
                                     map.grid_x * map_width,
@@ -431,11 +1460,15 @@ int main() {
             }
         }
 
+        if (show_normal)
+            profiler.end_pass();
+
 #pragma endregion
 
 #pragma region render sky box
 
         // render skybox (render as last to prevent overdraw)
+        profiler.begin_pass(sky_box_pass);
         background_shader.use();
         background_shader
                 .set_mat4("projection", projection)
@@ -444,44 +1477,125 @@ int main() {
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_CUBE_MAP, env_cube_map_id);
         render_cube();
+        profiler.end_pass();
 
 #pragma endregion
 
-        utilities::render_im_gui();
+#pragma region upscale
+
+        if (scale_resolution) {
+            profiler.begin_pass(upscale_pass);
+            glBindFramebuffer(GL_FRAMEBUFFER, window_fbo);
+            glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+            glDisable(GL_DEPTH_TEST);
+
+            upscale_shader.use_variant({{"SHARPEN", sharpen_upscale ? "1" : "0"}});
+            upscale_shader
+                    .set_vec2("uv_scale", static_cast<float>(frame_width) / static_cast<float>(scene_target.width),
+                              static_cast<float>(frame_height) / static_cast<float>(scene_target.height))
+                    .set_float("sharpness", upscale_sharpness);
+
+            glActiveTexture(GL_TEXTURE0 + scene_texture_index);
+            glBindTexture(GL_TEXTURE_2D, scene_target.color_id);
+            glActiveTexture(GL_TEXTURE0);
+            render_quad();
+
+            glEnable(GL_DEPTH_TEST);
+            profiler.end_pass();
+        }
+
+        glQueryCounter(timestamps[1], GL_TIMESTAMP);
+
+#pragma endregion
 
-        // swap the color buffer
-        glfwSwapBuffers(window);
+        if (headless) {
+            // the frame is finished once it is read back, or waited for when it is not written
+            TRACE_SCOPE("write frame");
+            if (!frame_directory.empty()) {
+                char file_name[32];
+                std::snprintf(file_name, sizeof(file_name), "frame_%04d.png", headless_frame);
+                try {
+                    utilities::write_framebuffer_png((std::filesystem::path(frame_directory) / file_name).string(),
+                                                     SCR_WIDTH, SCR_HEIGHT);
+                } catch (std::exception &e) {
+                    std::cout << e.what() << std::endl;
+                }
+            } else {
+                glFinish();
+            }
+            ++headless_frame;
+        } else {
+            // the interface is always drawn at the native resolution
+            profiler.begin_pass(im_gui_pass);
+            utilities::render_im_gui();
+            profiler.end_pass();
+
+            // swap the color buffer, waits for the vertical sync
+            TRACE_SCOPE("swap buffers");
+            glfwSwapBuffers(window);
+        }
         // checks if any events are triggered per frame
-        glfwPollEvents();
+        poll_events();
+
+        profiler.begin_pass(chunk_upload_pass);
 
-        // check task end of pre frame
-        if (!main_thread_task.empty()) {
-            load_height_map_task(*main_thread_task.front());
-            main_thread_task.pop();
+        // one new chunk per frame, the rebuilt splat maps, and the regenerated chunks at once
+        chunk_loader.update(upload_chunk);
+
+        profiler.end_pass();
+        profiler.end_frame();
+
+        if (replaying) {
+            replay_frame_times.push_back(static_cast<float>((get_time() - replay_frame_start) * 1000.0));
+            track_replay_chunks();
+            if (++replay_frame == replay_path.size())
+                finish_replay();
         }
     }
 
 #pragma region clean memory
 
-    game_end = true;
+    chunk_loader.stop();
 
     glDeleteVertexArrays(1, &terrain_vao);
     glDeleteBuffers(1, &terrain_vbo);
-    glDeleteProgram(terrain_shader.id);
+    terrain_shader.delete_programs();
+    terrain_replay_shader.delete_programs();
+    terrain_capture_shader.delete_programs();
+    glDeleteProgram(terrain_replay_depth_shader.id);
+    glDeleteProgram(normal_replay_shader.id);
+    release_captures();
+    terrain_cdlod_shader.delete_programs();
+    glDeleteProgram(terrain_cdlod_depth_shader.id);
+    terrain::delete_cdlod_mesh(cdlod_mesh);
+    terrain_lighting_shader.delete_programs();
+    glDeleteProgram(terrain_depth_shader.id);
+    utilities::delete_g_buffer(terrain_g_buffer);
+    upscale_shader.delete_programs();
+    material_fetch_shader.delete_programs();
+    utilities::delete_scene_target(scene_target);
+    if (headless)
+        utilities::delete_scene_target(headless_target);
     glDeleteProgram(normal_shader.id);
     glDeleteProgram(background_shader.id);
-    glDeleteProgram(irradiance_shader.id);
     glDeleteProgram(cube_map_shader.id);
-    glDeleteProgram(brdf_lut_shader.id);
     glDeleteProgram(prefilter_shader.id);
     glDeleteFramebuffers(1, &capture_fbo);
+    glDeleteQueries(2, terrain_queries);
+    profiler.close_csv();
+    profiler.delete_queries();
+    glDeleteQueries(4, frame_timestamps);
     glDeleteRenderbuffers(1, &capture_rbo);
 
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (headless) {
+        utilities::delete_headless_context(headless_context);
+    } else {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
 
-    glfwTerminate();
+        glfwTerminate();
+    }
 
 #pragma endregion
 
@@ -495,103 +1609,48 @@ int main() {
  */
 void
 load_height_map_task(terrain::map_chunk &chunk) {
+    TRACE_SCOPE("load_height_map_task");
+    // the render loop may have loaded the chunk before its task came up
+    if (chunk.height_map_id != 0) return;
+
     // subthreads cannot access the OpenGL context
     // so, loading heightmaps should be done in the main thread
     chunk.height_map_id = terrain::load_height_map(
             texture_width,
             texture_height, chunk.height_data);
+    chunk.splat_map_id = terrain::load_splat_map(texture_width, texture_height, chunk.splat_data);
 }
 
 /**
- * Subthreads continuously calculate data for surrounding map tiles by a few units
- * @param map_data store coords
- * @param game_end be used to stop subthreads
- * @param cam camera to get position
- * @param perlin perlin algorithm
- * @param scale perlin scale
- * @param layer_count perlin layer count
+ * Queue the material textures, the diffuse maps first so that the terrain gets its colors early
+ * @param pipeline texture pipeline
+ * @return texture array indices of the diffuse, normal and ao/roughness/metallic maps
  */
-void
-load_chunk(std::unordered_map<std::pair<int, int>, terrain::map_chunk, terrain::pair_hash> &map_data, bool &game_end,
-           utilities::camera &cam, siv::PerlinNoise &perlin, float &scale, int &layer_count) {
-
-    // expand the loading range after first load
-    int expand_range = 0;
-
-    std::cout << "chunk loader starting..." << std::endl;
-    while (!game_end) {
-
-        int current_grid_x = static_cast<int>(std::trunc(cam.position.x / map_width + 0.5));
-        int current_grid_y = static_cast<int>(std::trunc(cam.position.z / map_height + 0.5));
-
-        for (int x = current_grid_x - render_distance - expand_range;
-             x <= current_grid_x + render_distance + expand_range; ++x) {
-            for (int y = current_grid_y - render_distance - expand_range;
-                 y <= current_grid_y + render_distance + expand_range; ++y) {
-
-                if (!map_data.contains({x, y})) {
-
-                    std::vector<float> height_data(texture_width * texture_height);
-                    terrain::get_height_map(height_data, perlin, texture_width, texture_height,
-                                            scale, layer_count, static_cast<float>(x), static_cast<float>(y));
-
-                    map_data.insert({std::pair<int, int>(x, y),
-                                     terrain::map_chunk(x, y, std::move(height_data))});
-
-                    main_thread_task.push(&map_data.at({x, y}));
-                }
-            }
-        }
-
-        expand_range = 3;
-    }
-    std::cout << "chunk loader stopped" << std::endl;
-}
-
-void load_material_texture(std::vector<unsigned int> &diff_textures) {
-    diff_textures.push_back(utilities::load_texture("../assets/images/sand/", "sand_diff.png"));
-    diff_textures.push_back(
-            utilities::load_texture("../assets/images/grass/", "grass_diff.png"));
-    diff_textures.push_back(utilities::load_texture("../assets/images/mud/", "mud_diff.png"));
-    diff_textures.push_back(utilities::load_texture("../assets/images/rock/", "rock_diff.png"));
-    diff_textures.push_back(utilities::load_texture("../assets/images/snow/", "snow_diff.png"));
-}
-
-void load_material_texture(std::vector<unsigned int> &diff_texture, std::vector<unsigned int> &norm_textures) {
-    load_material_texture(diff_texture);
+std::tuple<std::size_t, std::size_t, std::size_t>
+load_material_texture(utilities::texture_pipeline &pipeline) {
+    auto layer_paths = [](const std::string &suffix) {
+        std::vector<std::string> paths;
+        for (auto &material: material_layers)
+            paths.push_back("../assets/images/" + material + "/" + material + suffix);
+        return paths;
+    };
 
-    norm_textures.push_back(utilities::load_texture("../assets/images/sand/", "sand_nor.png"));
-    norm_textures.push_back(
-            utilities::load_texture("../assets/images/grass/", "grass_nor.png"));
-    norm_textures.push_back(
-            utilities::load_texture("../assets/images/mud/", "mud_nor.png"));
-    norm_textures.push_back(utilities::load_texture("../assets/images/rock/", "rock_nor.png"));
-    norm_textures.push_back(utilities::load_texture("../assets/images/snow/", "snow_nor.png"));
-}
+    std::size_t diff_array = pipeline.enqueue_array("diff", layer_paths("_diff.png"));
+    std::size_t norm_array = pipeline.enqueue_array("norm", layer_paths("_nor.png"));
+    std::size_t arm_array = pipeline.enqueue_array("arm", layer_paths("_arm.png"));
 
-void load_material_texture(std::vector<unsigned int> &diff_texture, std::vector<unsigned int> &norm_textures,
-                           std::vector<unsigned int> &arm_texture) {
-    load_material_texture(diff_texture, norm_textures);
-
-    arm_texture.push_back(utilities::load_texture("../assets/images/sand/", "sand_arm.png"));
-    arm_texture.push_back(
-            utilities::load_texture("../assets/images/grass/", "grass_arm.png"));
-    arm_texture.push_back(
-            utilities::load_texture("../assets/images/mud/", "mud_arm.png"));
-    arm_texture.push_back(utilities::load_texture("../assets/images/rock/", "rock_arm.png"));
-    arm_texture.push_back(utilities::load_texture("../assets/images/snow/", "snow_arm.png"));
+    return {diff_array, norm_array, arm_array};
 }
 
-void set_texture(std::vector<unsigned int> &textures, int &texture_index,
-                 std::string &&texture_name, utilities::shader &shader_program) {
-    for (int i = 0; i < textures.size(); ++i) {
-        glActiveTexture(GL_TEXTURE0 + texture_index);
-        glBindTexture(GL_TEXTURE_2D, textures[i]);
-        // set texture to shader
-        std::string uniform_name("material." + texture_name + "[" + std::to_string(i) + "]");
-        shader_program.set_int(uniform_name, texture_index);
-        texture_index++;
-    }
+/**
+ * Bind a texture array of material maps to its unit, the samplers of the terrain shader point to the units
+ * from the start
+ * @param texture_array_id texture array
+ * @param texture_index texture unit
+ */
+void set_texture(unsigned int texture_array_id, int texture_index) {
+    glActiveTexture(GL_TEXTURE0 + texture_index);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array_id);
 }
 
 void render_cube() {
@@ -701,11 +1760,22 @@ void render_quad() {
     glBindVertexArray(0);
 }
 
+/**
+ * Prepare the image based lighting: sky box, diffuse irradiance, prefilter map and brdf lut
+ * @param cube_map_shader converts the equirectangular hdr to a cube map
+ * @param env_cube_map_id output sky box
+ * @param irradiance_sh output diffuse irradiance as spherical harmonics
+ * @param prefilter_shader
+ * @param prefilter_map_id output prefilter map
+ * @param brdf_lut_map_id output brdf lut
+ * @return capture framebuffer and renderbuffer
+ */
 std::tuple<unsigned int, unsigned int>
 pbr_pre_process(utilities::shader &cube_map_shader, unsigned int &env_cube_map_id,
-                utilities::shader &irradiance_shader, unsigned int &irradiance_map_id,
+                utilities::sh9_coefficients &irradiance_sh,
                 utilities::shader &prefilter_shader, unsigned int &prefilter_map_id,
-                utilities::shader &brdf_shader, unsigned int &brdf_lut_map_id) {
+                unsigned int &brdf_lut_map_id) {
+    TRACE_SCOPE("pbr_pre_process");
 
     // set framebuffer and renderbuffer for rending sky box
     unsigned int capture_fbo, capture_rbo;
@@ -713,10 +1783,34 @@ pbr_pre_process(utilities::shader &cube_map_shader, unsigned int &env_cube_map_i
     glGenFramebuffers(1, &capture_fbo);
     glGenRenderbuffers(1, &capture_rbo);
 
-    // load hdr texture
     stbi_set_flip_vertically_on_load(true);
-    unsigned int hdr_texture = utilities::load_texture(std::string("../assets/images/"),
-                                                       std::string("farm_field_puresky_4k.hdr"), true);
+    int hdr_width, hdr_height;
+    unsigned int hdr_texture;
+
+    std::string sky_path("../assets/images/farm_field_puresky_4k.hdr");
+    if (std::filesystem::exists(utilities::cooked_texture_path(sky_path))) {
+        // the cooked sky is BC6H and carries its spherical harmonics, nothing to decode
+        std::vector<float> metadata;
+        hdr_texture = utilities::load_compressed_texture(
+                "", utilities::cooked_texture_path(sky_path), hdr_width, hdr_height, metadata, GL_CLAMP_TO_EDGE);
+        if (metadata.size() != irradiance_sh.size() * 3)
+            throw std::runtime_error("cooked sky without spherical harmonics, cook it again");
+        for (std::size_t i = 0; i < irradiance_sh.size(); ++i)
+            irradiance_sh[i] = glm::vec3(metadata[i * 3], metadata[i * 3 + 1], metadata[i * 3 + 2]);
+    } else {
+        // load hdr texture, every decoded scanline is projected onto spherical harmonics on the decoding threads
+        std::unique_ptr<utilities::sh9_projector> projector;
+        std::once_flag projector_created;
+        hdr_texture = utilities::load_texture_hdr(
+                std::string("../assets/images/"), std::string("farm_field_puresky_4k.hdr"), hdr_width, hdr_height,
+                [&projector, &projector_created](int row, const float *rgb, int width, int height) {
+                    std::call_once(projector_created, [&]() {
+                        projector = std::make_unique<utilities::sh9_projector>(width, height);
+                    });
+                    projector->add_row(row, rgb, 3);
+                });
+        irradiance_sh = projector->coefficients();
+    }
 
     // fov 90 to capture all scene
     glm::mat4 capture_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
@@ -744,21 +1838,14 @@ pbr_pre_process(utilities::shader &cube_map_shader, unsigned int &env_cube_map_i
     env_cube_map_id = render_sky_box(cube_map_shader, hdr_texture,
                                      capture_fbo, capture_rbo, capture_views);
 
-    irradiance_shader.use();
-    irradiance_shader
-            .set_int("environment_map", 0)
-            .set_mat4("projection", capture_projection);
-    irradiance_map_id = render_irradiance_map(irradiance_shader, env_cube_map_id,
-                                              capture_fbo, capture_rbo, capture_views);
-
     prefilter_shader.use();
     prefilter_shader
             .set_int("environment_map", 0)
             .set_mat4("projection", capture_projection);
     prefilter_map_id = render_prefilter_map(prefilter_shader, env_cube_map_id, capture_fbo, capture_rbo, capture_views);
 
-    brdf_shader.use();
-    brdf_lut_map_id = render_brdf_lut_map(brdf_shader, capture_fbo, capture_rbo);
+    // the split-sum lut does not depend on the scene, it is baked into the executable
+    brdf_lut_map_id = load_brdf_lut_map();
 
     return {capture_fbo, capture_rbo};
 }
@@ -824,57 +1911,6 @@ render_sky_box(utilities::shader &cube_map_shader, unsigned int &hdr_texture,
     return env_cube_map_id;
 }
 
-unsigned int
-render_irradiance_map(utilities::shader &irradiance_shader, unsigned int &env_cube_map_id,
-                      unsigned int &capture_fbo, unsigned int &capture_rbo, std::vector<glm::mat4> &capture_views) {
-
-    unsigned int irradiance_map_id;
-    glGenTextures(1, &irradiance_map_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradiance_map_id);
-
-    // set texture type
-    for (unsigned int i = 0; i < 6; ++i) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F,
-                     irradiance_resolution, irradiance_resolution, 0,
-                     GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, capture_fbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, capture_rbo);
-
-    // set render buffer as depth attachment
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, irradiance_resolution, irradiance_resolution);
-    // bind depth attachment for framebuffer
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, capture_rbo);
-
-    irradiance_shader.use();
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, env_cube_map_id);
-
-    // configure the viewport to the capture dimensions.
-    glViewport(0, 0, irradiance_resolution, irradiance_resolution);
-
-    // render each face of irradiance cube map
-    for (unsigned int i = 0; i < 6; ++i) {
-        irradiance_shader.set_mat4("view", capture_views[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradiance_map_id, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        render_cube();
-    }
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    return irradiance_map_id;
-}
-
 unsigned int
 render_prefilter_map(utilities::shader &prefilter_shader, unsigned int &env_cube_map_id,
                      unsigned int &capture_fbo, unsigned int &capture_rbo, std::vector<glm::mat4> &capture_views) {
@@ -933,33 +1969,34 @@ render_prefilter_map(utilities::shader &prefilter_shader, unsigned int &env_cube
     return prefilter_map_id;
 }
 
+/**
+ * Upload the brdf lut baked at build time, see utilities/brdf_lut.h
+ * @return texture id
+ */
 unsigned int
-render_brdf_lut_map(utilities::shader &brdf_shader, unsigned int &capture_fbo, unsigned int &capture_rbo) {
+load_brdf_lut_map() {
     unsigned int brdf_lut_map_id;
     glGenTextures(1, &brdf_lut_map_id);
 
-    // pre-allocate enough memory for the LUT texture.
     glBindTexture(GL_TEXTURE_2D, brdf_lut_map_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, brdf_resolution, brdf_resolution, 0, GL_RG, GL_FLOAT, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, utilities::brdf::lut_resolution, utilities::brdf::lut_resolution, 0,
+                 GL_RG, GL_FLOAT, utilities::brdf::lut.data());
     // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    glBindFramebuffer(GL_FRAMEBUFFER, capture_fbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, capture_rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, brdf_resolution, brdf_resolution);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdf_lut_map_id, 0);
-
-    glViewport(0, 0, brdf_resolution, brdf_resolution);
-
-    brdf_shader.use();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    render_quad();
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
+    glBindTexture(GL_TEXTURE_2D, 0);
     return brdf_lut_map_id;
 }
+
+/**
+ * seconds since the first call, the clock of the frame without a glfw window
+ * @return
+ */
+double
+get_time() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
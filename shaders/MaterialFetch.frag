@@ -0,0 +1,62 @@
+#version 460 core
+
+// the triplanar material fetches of PerlinMap.frag, timed by utilities::benchmark_material_fetch once through
+// the texture arrays and once through the separate samplers the terrain used before them. the layers change
+// between fragments like the splat layers of the terrain, so the sampler index is not dynamically uniform
+
+// permutation options, injected by utilities::shader
+#ifndef SEPARATE_SAMPLERS
+#define SEPARATE_SAMPLERS 0
+#endif
+
+// utilities::separate_sampler_count
+#define MAX_TEXTURES 5
+
+out vec4 FragColor;
+
+in vec2 tex_coords;
+
+#if SEPARATE_SAMPLERS
+uniform sampler2D diff[MAX_TEXTURES];
+uniform sampler2D norm[MAX_TEXTURES];
+uniform sampler2D arm[MAX_TEXTURES];
+#define FETCH(map, coord, layer) texture(map[layer], coord)
+#else
+uniform sampler2DArray diff;
+uniform sampler2DArray norm;
+uniform sampler2DArray arm;
+#define FETCH(map, coord, layer) texture(map, vec3(coord, layer))
+#endif
+
+uniform int layer_count;
+
+// world position and normal of a rolling surface, so all three projections take part
+vec3 frag_pos;
+vec3 weights;
+
+#define TRIPLANAR(map, layer) \
+    (FETCH(map, frag_pos.yz, layer) * weights.x + \
+     FETCH(map, frag_pos.xz, layer) * weights.y + \
+     FETCH(map, frag_pos.xy, layer) * weights.z)
+
+void main()
+{
+    vec2 ground = tex_coords * 64.0;
+    frag_pos = vec3(ground.x, sin(ground.x) * cos(ground.y) * 2.0, ground.y);
+    vec3 normal = normalize(vec3(-cos(ground.x) * cos(ground.y), 1.0, sin(ground.x) * sin(ground.y)));
+    weights = abs(normal) / (abs(normal.x) + abs(normal.y) + abs(normal.z));
+
+    // small blocks of fragments share their layers, neighbouring blocks in a warp do not
+    ivec2 block = ivec2(gl_FragCoord.xy) / 4;
+    int lower = (block.x * 7 + block.y * 13) % layer_count;
+    int upper = (lower + 1) % layer_count;
+    float blend = fract(frag_pos.y);
+
+    vec4 color = mix(TRIPLANAR(diff, lower), TRIPLANAR(diff, upper), blend);
+    vec4 normal_map = mix(TRIPLANAR(norm, lower), TRIPLANAR(norm, upper), blend);
+    vec4 ao_roughness_metallic = mix(TRIPLANAR(arm, lower), TRIPLANAR(arm, upper), blend);
+
+    // every fetch reaches the output so none of them is optimised away
+    FragColor = vec4(color.rgb * ao_roughness_metallic.r + normal_map.rgb * ao_roughness_metallic.g,
+                     ao_roughness_metallic.b);
+}
@@ -0,0 +1,12 @@
+#version 460 core
+
+// one triangle over the whole target, made up from the vertex index so no vertex buffer is bound
+
+out vec2 tex_coords;
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    tex_coords = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 460 core
+
+// normals of the terrain recorded with transform feedback, see TerrainReplay.vert. same output as NormalTest.tese
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+#include "terrain_normal.glsl"
+
+uniform mat4 view;
+
+out VS_OUT {
+    vec3 normal;
+    vec3 tangent;
+    vec3 bitangent;
+    mat3 tangent_space;
+} vs_out;
+
+void main() {
+    // the captured normal is in world space, NormalTest.geom draws in view space
+    mat3 normalMatrix = transpose(inverse(mat3(view)));
+    vs_out.normal = normalize(normalMatrix * aNormal);
+
+    tangent_frame(vs_out.normal, vs_out.tangent, vs_out.bitangent);
+    vs_out.tangent_space = mat3(vs_out.tangent, vs_out.bitangent, vs_out.normal);
+
+    gl_Position = view * vec4(aPos, 1.0);
+}
@@ -1,30 +1,69 @@
 #version 460 core
 
-#define MAX_TEXTURES 5
+// permutation options, utilities::shader compiles one variant per combination in use
+// and injects them after #version, the defaults only apply when the file is compiled on its own.
+// TEXTURE_MODE: 0 no texture, 1 general, 2 triplanar
+#ifndef TEXTURE_MODE
+#define TEXTURE_MODE 2
+#endif
+// LIGHT_MODE: 0 no lighting, 1 phong, 2 pbr
+#ifndef LIGHT_MODE
+#define LIGHT_MODE 2
+#endif
+#ifndef ENABLE_TANGENT
+#define ENABLE_TANGENT 1
+#endif
+#ifndef USE_WHITEOUT
+#define USE_WHITEOUT 1
+#endif
+#ifndef GAMMA_CORRECTION
+#define GAMMA_CORRECTION 1
+#endif
+// 0 while the arm maps are still loading
+#ifndef USE_ARM
+#define USE_ARM 1
+#endif
+// PROJECTION_MODE of the triplanar textures: 0 all three projections, 1 biplanar (the two dominant ones),
+// 2 only the dominant one with dithered transitions
+#ifndef PROJECTION_MODE
+#define PROJECTION_MODE 0
+#endif
+
+// SHADING_LOD: 0 every fragment is shaded in full, 1 cheaper tiers with the distance, 2 tiers tinted for debugging
+#ifndef SHADING_LOD
+#define SHADING_LOD 1
+#endif
+
+// DEFERRED: 1 writes the surface into the g-buffer instead of lighting it, see TerrainLighting.frag
+#ifndef DEFERRED
+#define DEFERRED 0
+#endif
+
+#if PROJECTION_MODE == 0
+#define PROJECTION_COUNT 3
+#elif PROJECTION_MODE == 1
+#define PROJECTION_COUNT 2
+#else
+#define PROJECTION_COUNT 1
+#endif
+
+#include "terrain_splat.glsl"
+#include "terrain_lighting.glsl"
 
 struct terrain_material {
-    sampler2D diff[MAX_TEXTURES];
-    sampler2D norm[MAX_TEXTURES];
-    sampler2D arm[MAX_TEXTURES];
-    float height[MAX_TEXTURES + 1];
+    // one layer per material
+    sampler2DArray diff;
+    sampler2DArray norm;
+    sampler2DArray arm;
 
     float triplanar_scale;
     int triplanar_sharpness;
 };
 
-struct light_data {
-    vec3 light_pos;
-    vec3 view_pos;
-    vec3 light_color;
-
-    float ambient_strength;
-    float specular_strength;
-    float specular_pow;
-};
-
 in terrain_data {
     float height;
     float height_01;
+    vec2 height_coord;
     vec2 tex_coord;
     vec3 frag_pos;
 
@@ -34,334 +73,324 @@ in terrain_data {
     vec3 blended_normal;
 } data;
 
-uniform terrain_material material;
-uniform light_data light;
-
-// IBL
-uniform samplerCube irradiance_map;
-uniform samplerCube prefilter_map;
-uniform sampler2D brdf_lut;
-
-uniform bool enable_tangent;
-uniform bool use_whiteout;
-uniform bool gamma_correction;
-uniform int texture_mode;
-uniform int light_mode;
+// view distances where the mid and the far tier take over, each blended in over blend_range
+struct shading_lod_data {
+    float mid_distance;
+    float far_distance;
+    float blend_range;
+};
 
+uniform terrain_material material;
+uniform shading_lod_data shading_lod;
+
+#if DEFERRED
+// rgb albedo and the share of the far tier
+layout (location = 0) out vec4 g_albedo;
+layout (location = 1) out vec4 g_normal;
+layout (location = 2) out vec4 g_arm;
+#else
 out vec4 FragColor;
+#endif
 
 in vec3 weights;
 
-float lower_bound;
-float upper_bound;
+// layers of the splat map and the blend factor between them
 int texture_upper_index;
 int texture_lower_index;
+float texture_blend;
 
-const float PI = 3.14159265359;
-
-vec3 blinn_phong_lighting(vec3 normal, vec3 diff, float ao) {
-    // ambient
-    vec3 ambient = light.ambient_strength * diff * light.light_color * ao;
-
-    // diffuse
-    vec3 light_dir = normalize(light.light_pos - data.frag_pos);
-    float diff_factor = max(dot(normal, light_dir), 0.0);
-    vec3 diffuse = diff * diff_factor * light.light_color;
+// scaled position of the projections and its screen space gradients, taken before any tier branches
+vec3 projection_pos;
+vec3 projection_pos_dx;
+vec3 projection_pos_dy;
+vec2 tex_coord_dx;
+vec2 tex_coord_dy;
 
-    // specular
+// projections sampled by this fragment: texture coordinate, its screen space gradients and weight
+vec2 projection_coord[PROJECTION_COUNT];
+vec2 projection_dx[PROJECTION_COUNT];
+vec2 projection_dy[PROJECTION_COUNT];
+float projection_weight[PROJECTION_COUNT];
 
-    return vec3(ambient + diffuse);
+vec4 get_diff(vec2 tex) {
+    vec4 base_color = textureGrad(material.diff, vec3(tex, texture_lower_index), tex_coord_dx, tex_coord_dy);
+    vec4 next_color = textureGrad(material.diff, vec3(tex, texture_upper_index), tex_coord_dx, tex_coord_dy);
+    return mix(base_color, next_color, texture_blend);
 }
 
-// ----------------------------------------------------------------------------
-// Easy trick to get tangent-normals to world-space to keep PBR code simplified.
-// Don't worry if you don't get what's going on; you generally want to do normal
-// mapping the usual way for performance anyways; I do plan make a note of this
-// technique somewhere later in the normal mapping tutorial.
-//vec3 getNormalFromMap()
-//{
-//    vec3 tangentNormal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
-//
-//    vec3 Q1  = dFdx(WorldPos);
-//    vec3 Q2  = dFdy(WorldPos);
-//    vec2 st1 = dFdx(TexCoords);
-//    vec2 st2 = dFdy(TexCoords);
-//
-//    vec3 N   = normalize(Normal);
-//    vec3 T  = normalize(Q1*st2.t - Q2*st1.t);
-//    vec3 B  = -normalize(cross(N, T));
-//    mat3 TBN = mat3(T, B, N);
-//
-//    return normalize(TBN * tangentNormal);
-//}
-
-// ----------------------------------------------------------------------------
-float DistributionGGX(vec3 N, vec3 H, float roughness)
-{
-    float a = roughness * roughness;
-    float a2 = a * a;
-    float NdotH = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH * NdotH;
-
-    float nom = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-
-    return nom / denom;
+// coordinate of a point projected along an axis, 0 is x
+vec2 axis_coord(vec3 p, int axis) {
+    return axis == 0 ? p.yz : (axis == 1 ? p.xz : p.xy);
 }
 
-// ----------------------------------------------------------------------------
-float GeometrySchlickGGX(float NdotV, float roughness)
-{
-    float r = (roughness + 1.0);
-    float k = (r * r) / 8.0;
+// the two heaviest axes of the normal and the weight of the second one against the first
+void heaviest_axes(out int first, out int second, out float second_weight) {
+    vec3 n = abs(normalize(data.w_normal));
+
+    // axes from the heaviest to the lightest
+    ivec3 order = n.x > n.y ?
+                  (n.x > n.z ? (n.y > n.z ? ivec3(0, 1, 2) : ivec3(0, 2, 1)) : ivec3(2, 0, 1)) :
+                  (n.y > n.z ? (n.x > n.z ? ivec3(1, 0, 2) : ivec3(1, 2, 0)) : ivec3(2, 1, 0));
 
-    float nom = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
+    // the lightest axis is subtracted, so the dropped projection has faded out when two axes swap
+    vec2 w = max(vec2(n[order.x], n[order.y]) - n[order.z], 0.0);
+    w = pow(w, vec2(material.triplanar_sharpness));
 
-    return nom / denom;
+    first = order.x;
+    second = order.y;
+    second_weight = w.y / (w.x + w.y + 1e-6);
 }
 
-// ----------------------------------------------------------------------------
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
-{
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
-    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
+// one axis, the second heaviest is picked as often as its weight so the transition is dithered
+int dithered_axis() {
+    int first, second;
+    float second_weight;
+    heaviest_axes(first, second, second_weight);
 
-    return ggx1 * ggx2;
+    // interleaved gradient noise
+    float threshold = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    return second_weight > threshold ? second : first;
 }
 
-// ----------------------------------------------------------------------------
-vec3 fresnelSchlick(float cosTheta, vec3 F0)
-{
-    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+void set_projection(int index, int axis, float weight) {
+    projection_coord[index] = axis_coord(projection_pos, axis);
+    projection_dx[index] = axis_coord(projection_pos_dx, axis);
+    projection_dy[index] = axis_coord(projection_pos_dy, axis);
+    projection_weight[index] = weight;
 }
 
-// ----------------------------------------------------------------------------
-vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
-{
-    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
-}
+// gradients of the projected coordinates, needed by every tier and only valid in uniform control flow
+void prepare_gradients() {
+    projection_pos = data.frag_pos * material.triplanar_scale;
+    // explicit gradients, neighbouring fragments may pick other axes
+    projection_pos_dx = dFdx(projection_pos);
+    projection_pos_dy = dFdy(projection_pos);
 
-vec3 pbr_lighting(vec3 N, vec3 albedo, float ao, float roughness, float metallic) {
-
-    // input lighting data
-    vec3 view_dir = normalize(light.view_pos - data.frag_pos);
-
-    // calculate reflectance at normal incidence; if dia-electric (like plastic) use F0
-    // of 0.04 and if it's a metal, use the albedo color as F0 (metallic workflow)
-    vec3 F0 = vec3(0.04);
-    F0 = mix(F0, albedo, metallic);
-
-    //-----------------------------------------------------------------------------------------------------------------
-    //------------------------------------------compute direct light--------------------------------------------------
-    // reflectance equation
-    vec3 Lo = vec3(0.0);
-
-    // calculate per-light radiance
-    vec3 light_dir = normalize(light.light_pos - data.frag_pos);
-    vec3 half_dir = normalize(view_dir + light_dir);
-
-    // compute light attenuation
-    //    float distance = length(light_data.light_pos - data.frag_pos);
-    //    float attenuation = 1.0 / (distance * distance);
-    //    vec3 radiance = light_data.light_color * attenuation;
-
-    // Cook-Torrance BRDF
-    float NDF = DistributionGGX(N, half_dir, roughness);
-    float G = GeometrySmith(N, view_dir, light_dir, roughness);
-    vec3 Frenel = fresnelSchlick(max(dot(half_dir, view_dir), 0.0), F0);
-
-    vec3 numerator = NDF * G * Frenel;
-    float denominator = 4.0 * max(dot(N, view_dir), 0.0) * max(dot(N, light_dir), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
-    vec3 specular_direct_light = numerator / denominator;
-
-    // kS is equal to Fresnel
-    vec3 kS_direct_light = Frenel;
-    // for energy conservation, the diffuse and specular light can't
-    // be above 1.0 (unless the surface emits light); to preserve this
-    // relationship the diffuse component (kD) should equal 1.0 - kS.
-    vec3 kD_direct_light = vec3(1.0) - kS_direct_light;
-    // multiply kD by the inverse metalness such that only non-metals
-    // have diffuse lighting, or a linear blend if partly metal (pure metals
-    // have no diffuse light).
-    kD_direct_light *= 1.0 - metallic;
-
-    // scale light by NdotL
-    float NdotL = max(dot(N, light_dir), 0.0);
-
-    // add to outgoing radiance Lo
-    // note that already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
-    Lo += (kD_direct_light * albedo / PI + specular_direct_light) * NdotL;
-
-    // ambient lighting (we now use IBL as the ambient term)
-    vec3 F = fresnelSchlickRoughness(max(dot(N, view_dir), 0.0), F0, roughness);
-
-    vec3 kS_ambient_light = F;
-    vec3 kD_ambient_light = 1.0 - kS_ambient_light;
-    kD_ambient_light *= 1.0 - metallic;
-
-    vec3 irradiance = texture(irradiance_map, N).rgb;
-    vec3 diffuse = irradiance * albedo;
-    //-----------------------------------------------------------------------------------------------------------------
-    //-----------------------------------------------------------------------------------------------------------------
-
-
-    //-----------------------------------------------------------------------------------------------------------------
-    //-----------------------sample prefilter and brdf texture to compute ambient light--------------------------------
-    // sample both the pre-filter map and the BRDF lut and combine them together
-    // as per the Split-Sum approximation to get the IBL specular part.
-    vec3 relfect_dir = reflect(-view_dir, N); // reflect direction to sample prefilter map
-    const float MAX_REFLECTION_LOD = 4.0; // calculate the mipmap level based on roughness
-    vec3 prefilteredColor = textureLod(prefilter_map, relfect_dir, roughness * MAX_REFLECTION_LOD).rgb;
-
-    // sample the response of the BRDF in the direction of that viewing angle
-    vec2 brdf = texture(brdf_lut, vec2(max(dot(N, view_dir), 0.0), roughness)).rg;
-    vec3 specular_ambient_light = prefilteredColor * (F * brdf.x + brdf.y);
-
-    // compute ambient light partion
-    vec3 ambient = (kD_ambient_light * diffuse + specular_ambient_light) * ao;
-    //-----------------------------------------------------------------------------------------------------------------
-    //-----------------------------------------------------------------------------------------------------------------
-
-    // combine ambient light and diffuse
-    return ambient * light.ambient_strength + Lo;
+    tex_coord_dx = dFdx(data.tex_coord);
+    tex_coord_dy = dFdy(data.tex_coord);
 }
 
-vec4 get_diff(vec2 tex) {
-    // the percentage of the height value within the current height range.
-    //    float percentage = (data.height_01 - lower_bound) / (upper_bound - lower_bound);
+// choose the projections of this fragment once, every material map samples the same ones
+void prepare_projection() {
+#if PROJECTION_MODE == 0
+    set_projection(0, 0, weights.x);
+    set_projection(1, 1, weights.y);
+    set_projection(2, 2, weights.z);
+#elif PROJECTION_MODE == 1
+    int first, second;
+    float second_weight;
+    heaviest_axes(first, second, second_weight);
+
+    set_projection(0, first, 1.0 - second_weight);
+    set_projection(1, second, second_weight);
+#else
+    set_projection(0, dithered_axis(), 1.0);
+#endif
+}
 
-    vec4 base_color = texture2D(material.diff[texture_lower_index], tex);
-    vec4 next_color = texture2D(material.diff[texture_upper_index], tex);
-    return mix(base_color, next_color, smoothstep(lower_bound, upper_bound, data.height_01));
+// weighted sum of the projections of one layer of a material map
+vec4 sample_projected(sampler2DArray map, int layer) {
+    vec4 color = vec4(0.0);
+    for (int i = 0; i < PROJECTION_COUNT; ++i) {
+        color += textureGrad(map, vec3(projection_coord[i], layer), projection_dx[i], projection_dy[i]) *
+                 projection_weight[i];
+    }
+    return color;
 }
 
 // triplanar to sample diff texture
 vec4 get_diff_triplanar() {
-    vec4 x_color = texture2D(material.diff[texture_lower_index], data.frag_pos.yz * material.triplanar_scale);
-    vec4 y_color = texture2D(material.diff[texture_lower_index], data.frag_pos.xz * material.triplanar_scale);
-    vec4 z_color = texture2D(material.diff[texture_lower_index], data.frag_pos.xy * material.triplanar_scale);
-
-    vec4 base_color = x_color * weights.x + y_color * weights.y + z_color * weights.z;
-
-    x_color = texture2D(material.diff[texture_upper_index], data.frag_pos.yz * material.triplanar_scale);
-    y_color = texture2D(material.diff[texture_upper_index], data.frag_pos.xz * material.triplanar_scale);
-    z_color = texture2D(material.diff[texture_upper_index], data.frag_pos.xy * material.triplanar_scale);
+    vec4 base_color = sample_projected(material.diff, texture_lower_index);
+    vec4 next_color = sample_projected(material.diff, texture_upper_index);
 
-    vec4 next_color = x_color * weights.x + y_color * weights.y + z_color * weights.z;
-
-    return mix(base_color, next_color, smoothstep(lower_bound, upper_bound, data.height_01));
+    return mix(base_color, next_color, texture_blend);
 }
 
 // triplanar to sample normal texture
 vec4 get_normal_triplanar() {
-    vec4 x_color = texture2D(material.norm[texture_lower_index], data.frag_pos.yz * material.triplanar_scale);
-    vec4 y_color = texture2D(material.norm[texture_lower_index], data.frag_pos.xz * material.triplanar_scale);
-    vec4 z_color = texture2D(material.norm[texture_lower_index], data.frag_pos.xy * material.triplanar_scale);
-
-    vec4 base_normal = (x_color * weights.x + y_color * weights.y + z_color * weights.z);
-
-    x_color = texture2D(material.norm[texture_upper_index], data.frag_pos.yz * material.triplanar_scale);
-    y_color = texture2D(material.norm[texture_upper_index], data.frag_pos.xz * material.triplanar_scale);
-    z_color = texture2D(material.norm[texture_upper_index], data.frag_pos.xy * material.triplanar_scale);
-
-    vec4 next_normal = (x_color * weights.x + y_color * weights.y + z_color * weights.z);
+    vec4 base_normal = sample_projected(material.norm, texture_lower_index);
+    vec4 next_normal = sample_projected(material.norm, texture_upper_index);
 
     base_normal = base_normal * 2 - 1;
     next_normal = next_normal * 2 - 1;
 
-    if (use_whiteout) {
-        return vec4(normalize(vec3(base_normal.xy + next_normal.xy, base_normal.z * next_normal.z)), 1.0f);
-    }
+    // rebuild z from x and y, cooked BC5 normal maps only store those two
+    base_normal.z = sqrt(max(1.0 - dot(base_normal.xy, base_normal.xy), 0.0));
+    next_normal.z = sqrt(max(1.0 - dot(next_normal.xy, next_normal.xy), 0.0));
 
+#if USE_WHITEOUT
+    return vec4(normalize(vec3(base_normal.xy + next_normal.xy, base_normal.z * next_normal.z)), 1.0f);
+#else
     return normalize(base_normal + next_normal);
+#endif
 }
 
 // triplanar to sample arm texture
 vec4 get_arm_triplanar(vec2 tex) {
-    vec4 x_color = texture2D(material.arm[texture_lower_index], data.frag_pos.yz * material.triplanar_scale);
-    vec4 y_color = texture2D(material.arm[texture_lower_index], data.frag_pos.xz * material.triplanar_scale);
-    vec4 z_color = texture2D(material.arm[texture_lower_index], data.frag_pos.xy * material.triplanar_scale);
+    vec4 base_color = sample_projected(material.arm, texture_lower_index);
+    vec4 next_color = sample_projected(material.arm, texture_upper_index);
 
-    vec4 base_color = x_color * weights.x + y_color * weights.y + z_color * weights.z;
+    return mix(base_color, next_color, texture_blend);
+}
 
-    x_color = texture2D(material.arm[texture_upper_index], data.frag_pos.yz * material.triplanar_scale);
-    y_color = texture2D(material.arm[texture_upper_index], data.frag_pos.xz * material.triplanar_scale);
-    z_color = texture2D(material.arm[texture_upper_index], data.frag_pos.xy * material.triplanar_scale);
+void get_tex_data() {
+    get_splat(data.height_coord, texture_lower_index, texture_upper_index, texture_blend);
+}
 
-    vec4 next_color = x_color * weights.x + y_color * weights.y + z_color * weights.z;
 
-    return mix(base_color, next_color, smoothstep(lower_bound, upper_bound, data.height_01));
+// one layer of a material map projected along a single axis
+vec4 sample_axis(sampler2DArray map, int layer, int axis) {
+    return textureGrad(map, vec3(axis_coord(projection_pos, axis), layer),
+                       axis_coord(projection_pos_dx, axis), axis_coord(projection_pos_dy, axis));
 }
 
-void get_tex_data() {
-    texture_upper_index = 0;
+// material of a fragment before lighting
+struct terrain_surface {
+    vec3 albedo;
+    vec3 normal;
+    vec3 arm;
+};
 
-    for (int i = 0; i < MAX_TEXTURES + 1; i++) {
-        if (data.height_01 < material.height[i]) {
-            texture_upper_index = i;
-            break;
-        }
-    }
+// full material: every projection of the mode, normal maps and arm maps
+terrain_surface near_surface() {
+    terrain_surface surface;
+    surface.albedo = vec3(data.height_01, data.height_01, data.height_01);
+    surface.normal = normalize(data.w_normal);
+
+#if USE_ARM
+    surface.arm = get_arm_triplanar(data.tex_coord).xyz;
+#else
+    // without arm maps: no occlusion, fully rough, not metallic
+    surface.arm = vec3(1.0, 1.0, 0.0);
+#endif
+
+#if TEXTURE_MODE == 1
+    surface.albedo = get_diff(data.tex_coord).xyz;
+#elif TEXTURE_MODE == 2
+    surface.albedo = get_diff_triplanar().xyz;
+#endif
+
+#if ENABLE_TANGENT
+    mat3 tbn = mat3(normalize(data.tangent), normalize(data.bitangent), normalize(data.w_normal));
 
-    texture_upper_index = clamp(texture_upper_index, 0, MAX_TEXTURES - 1);
-    texture_lower_index = clamp(texture_upper_index - 1, 0, MAX_TEXTURES - 1);
+    // transform normal of normal map from tangent space to world space,
+    // the interpolated frame is not orthonormal and a longer normal makes the GGX highlights explode
+    surface.normal = normalize(tbn * get_normal_triplanar().xyz);
+#endif
 
-    lower_bound = material.height[texture_lower_index];
-    upper_bound = material.height[texture_upper_index];
+    return surface;
 }
 
+// mid range: the dominant projection only and the normal of the height map instead of the normal maps
+terrain_surface mid_surface() {
+    terrain_surface surface;
+    surface.albedo = vec3(data.height_01, data.height_01, data.height_01);
+    surface.normal = normalize(data.w_normal);
+
+#if TEXTURE_MODE == 2 || USE_ARM
+    int axis = dithered_axis();
+#endif
+
+#if USE_ARM
+    surface.arm = mix(sample_axis(material.arm, texture_lower_index, axis),
+                      sample_axis(material.arm, texture_upper_index, axis), texture_blend).xyz;
+#else
+    surface.arm = vec3(1.0, 1.0, 0.0);
+#endif
+
+#if TEXTURE_MODE == 1
+    surface.albedo = get_diff(data.tex_coord).xyz;
+#elif TEXTURE_MODE == 2
+    surface.albedo = mix(sample_axis(material.diff, texture_lower_index, axis),
+                         sample_axis(material.diff, texture_upper_index, axis), texture_blend).xyz;
+#endif
+
+    return surface;
+}
+
+// far away: the mean colour of the splat layers, from the last mip of the diff maps, lit by light_far_surface
+terrain_surface far_surface() {
+    terrain_surface surface;
+    surface.albedo = vec3(data.height_01, data.height_01, data.height_01);
+    surface.normal = normalize(data.w_normal);
+    surface.arm = vec3(1.0, 1.0, 0.0);
+
+#if TEXTURE_MODE != 0
+    // the lod is clamped to the 1x1 level, the same texel for every fragment of a layer
+    surface.albedo = mix(textureLod(material.diff, vec3(0.5, 0.5, texture_lower_index), 16.0),
+                         textureLod(material.diff, vec3(0.5, 0.5, texture_upper_index), 16.0), texture_blend).xyz;
+#endif
+
+    return surface;
+}
+
+#if DEFERRED
+// the g-buffer takes the blended material, the far tier keeps its own lighting through its share in g_albedo.a
+void blend_surface(inout terrain_surface blended, terrain_surface surface, float weight) {
+    blended.albedo += surface.albedo * weight;
+    blended.normal += surface.normal * weight;
+    blended.arm += surface.arm * weight;
+}
+#endif
 
 void main()
 {
     get_tex_data();
-
-    mat3 tbn = mat3(normalize(data.tangent), normalize(data.bitangent), normalize(data.w_normal));
-
-    vec3 color = vec3(data.height_01, data.height_01, data.height_01);
-    vec3 tex_noraml = normalize(data.w_normal);
-
-    vec3 arm = get_arm_triplanar(data.tex_coord).xyz;
-
-    switch (texture_mode) {
-        case 0:
-            break;
-        case 1:
-            color = get_diff(data.tex_coord).xyz;
-            break;
-        case 2:
-            color = get_diff_triplanar().xyz;
-            break;
-        default:
-            break;
+    prepare_gradients();
+    prepare_projection();
+
+    float mid_factor = 0.0;
+    float far_factor = 0.0;
+
+#if SHADING_LOD != 0
+    // share of the next tier, each tier blends into the next one over blend_range so nothing pops
+    float view_distance = distance(light.view_pos, data.frag_pos);
+    mid_factor = smoothstep(shading_lod.mid_distance, shading_lod.mid_distance + shading_lod.blend_range,
+                            view_distance);
+    far_factor = smoothstep(shading_lod.far_distance, shading_lod.far_distance + shading_lod.blend_range,
+                            view_distance);
+#endif
+
+#if SHADING_LOD == 2
+    vec3 tint = mix(mix(vec3(1.0, 0.6, 0.6), vec3(0.6, 1.0, 0.6), mid_factor), vec3(0.6, 0.6, 1.0), far_factor);
+#endif
+
+    // only the blend bands pay for two tiers
+#if DEFERRED
+    terrain_surface surface = terrain_surface(vec3(0.0), vec3(0.0), vec3(0.0));
+    if (mid_factor < 1.0) blend_surface(surface, near_surface(), 1.0 - mid_factor);
+    if (mid_factor > 0.0 && far_factor < 1.0) blend_surface(surface, mid_surface(), mid_factor * (1.0 - far_factor));
+    if (far_factor > 0.0) blend_surface(surface, far_surface(), far_factor);
+
+#if SHADING_LOD == 2
+    surface.albedo *= tint;
+#endif
+
+    g_albedo = vec4(surface.albedo, far_factor);
+    g_normal = vec4(normalize(surface.normal), 1.0);
+    g_arm = vec4(surface.arm, 1.0);
+#else
+    vec3 color = vec3(0.0);
+    terrain_surface surface;
+    if (mid_factor < 1.0) {
+        surface = near_surface();
+        color += light_surface(surface.albedo, surface.normal, surface.arm, data.frag_pos) * (1.0 - mid_factor);
     }
-
-    if (enable_tangent) {
-        // transform normal of normal map from tangent space to world space
-        tex_noraml = tbn * get_normal_triplanar().xyz;
+    if (mid_factor > 0.0 && far_factor < 1.0) {
+        surface = mid_surface();
+        color += light_surface(surface.albedo, surface.normal, surface.arm, data.frag_pos) *
+                 mid_factor * (1.0 - far_factor);
     }
-
-    switch (light_mode) {
-        case 0:
-            break;
-        case 1:
-            color = blinn_phong_lighting(tex_noraml, color, arm.r);
-            break;
-        case 2: // material properties
-            vec3 albedo = pow(color, vec3(2.2));
-            color = pbr_lighting(tex_noraml, color, arm.r, arm.g, arm.b);
-            break;
-        default:
-            break;
+    if (far_factor > 0.0) {
+        surface = far_surface();
+        color += light_far_surface(surface.albedo, surface.normal, data.frag_pos) * far_factor;
     }
 
-    if (gamma_correction) {
-        color.rgb = pow(color.rgb / (color.rgb + vec3(1.0)), vec3(1.0 / 2.2));
-    }
+#if SHADING_LOD == 2
+    color *= tint;
+#endif
 
     //    FragColor = vec4(data.blended_normal, 1.0f);
-    FragColor = vec4(color, 1.0f);
+    FragColor = vec4(tone_map(color), 1.0f);
+#endif
 }
\ No newline at end of file
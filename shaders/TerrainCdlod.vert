@@ -0,0 +1,104 @@
+#version 460 core
+
+// the terrain drawn as instanced grids of terrain::select_cdlod_nodes instead of tessellated patches.
+// the heights are fetched here and every vertex morphs into the grid of the next coarser level towards the end
+// of the range of its node, the output is the same as the one of PerlinMap.tese
+layout (location = 0) in vec2 aGrid; // position in the node from 0 to 1
+layout (location = 1) in vec4 aNode; // x and z of the lower corner in model space, side and level of the node
+
+#include "terrain_normal.glsl"
+
+out terrain_data {
+    float height; // real value of height
+    float height_01; // height value range (0,1)
+    vec2 height_coord; // texture coordinate of the height and splat map
+    vec2 tex_coord;
+    vec3 frag_pos;
+
+    vec3 w_normal;
+    vec3 tangent;
+    vec3 bitangent;
+    vec3 blended_normal;
+} data;
+
+struct terrain_material {
+    // one layer per material
+    sampler2DArray diff;
+    sampler2DArray norm;
+    sampler2DArray arm;
+
+    float triplanar_scale;
+    int triplanar_sharpness;
+};
+
+// settings of terrain::cdlod_settings
+struct cdlod_data {
+    float grid_size;
+    float leaf_range;
+    float morph_ratio;
+    float chunk_size;
+};
+
+uniform sampler2D height_map;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+uniform float terrain_height;
+uniform float HEIGHT_SCALE;
+
+uniform terrain_material material;
+uniform cdlod_data cdlod;
+uniform vec3 camera_pos;
+
+out vec3 weights;
+
+// the depth pre-pass draws with this shader in another program, the positions must match exactly
+invariant gl_Position;
+
+/**
+ * share of the coarser grid at a distance, 0 up to the morph start of the level and 1 at the end of its range
+ */
+float morph_factor(float distance, float level) {
+    float range_end = cdlod.leaf_range * exp2(level);
+    float range_start = level > 0.0 ? range_end * 0.5 : 0.0;
+    float morph_start = mix(range_start, range_end, cdlod.morph_ratio);
+
+    return clamp((distance - morph_start) / (range_end - morph_start), 0.0, 1.0);
+}
+
+void main() {
+    vec2 local_pos = aNode.xy + aGrid * aNode.z;
+
+    // the selection measures the same distance in the xz plane, so both sides of a level change agree
+    float distance = length((model * vec4(local_pos.x, 0.0, local_pos.y, 1.0)).xz - camera_pos.xz);
+
+    // odd vertices slide onto the middle of the edge of the coarser grid
+    vec2 odd_offset = fract(aGrid * cdlod.grid_size * 0.5) * 2.0 / cdlod.grid_size;
+    vec2 grid = aGrid - odd_offset * morph_factor(distance, aNode.w);
+    local_pos = aNode.xy + grid * aNode.z;
+
+    // chunk from 0 to 1, then the height texel centres like generate_terrain_vertices
+    data.tex_coord = local_pos / cdlod.chunk_size + 0.5;
+    data.height_coord = (data.tex_coord * cdlod.chunk_size + 1.0) / (cdlod.chunk_size + 2.0);
+
+    data.height_01 = textureLod(height_map, data.height_coord, 0.0).x;
+    data.height = data.height_01 * terrain_height - (terrain_height / 3.0f);
+
+    vec4 p = vec4(local_pos.x, data.height, local_pos.y, 1.0);
+    data.frag_pos = vec3(model * p);
+
+    data.w_normal = height_map_normal(height_map, data.height_coord, HEIGHT_SCALE);
+    mat3 normalMatrix = transpose(inverse(mat3(model)));
+    data.w_normal = normalize(normalMatrix * data.w_normal);
+    tangent_frame(data.w_normal, data.tangent, data.bitangent);
+
+    weights = abs(data.w_normal);
+    weights = vec3(pow(weights.x, material.triplanar_sharpness),
+                   pow(weights.y, material.triplanar_sharpness),
+                   pow(weights.z, material.triplanar_sharpness));
+
+    weights = weights / (weights.x + weights.y + weights.z);
+
+    gl_Position = projection * view * model * p;
+}
@@ -0,0 +1,6 @@
+#version 460 core
+
+// depth pre-pass of the terrain, the colour pass then only shades the visible fragments
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#version 460 core
+
+// deferred lighting of the terrain, every covered pixel of the g-buffer is lit exactly once.
+// LIGHT_MODE and GAMMA_CORRECTION are injected by utilities::shader like for PerlinMap.frag
+
+#include "terrain_lighting.glsl"
+
+out vec4 FragColor;
+
+in vec2 tex_coords;
+
+// written by PerlinMap.frag compiled with DEFERRED
+uniform sampler2D g_albedo;
+uniform sampler2D g_normal;
+uniform sampler2D g_arm;
+uniform sampler2D g_depth;
+
+// rebuilds the world position from the depth
+uniform mat4 inverse_view_projection;
+
+void main()
+{
+    // one texel per pixel, the g-buffer may be drawn into a scaled corner of its textures
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(g_depth, texel, 0).r;
+
+    // nothing of the terrain here, the sky box is drawn later
+    if (depth >= 1.0) discard;
+
+    vec4 clip_pos = vec4(vec3(tex_coords, depth) * 2.0 - 1.0, 1.0);
+    vec4 world_pos = inverse_view_projection * clip_pos;
+    vec3 frag_pos = world_pos.xyz / world_pos.w;
+
+    vec4 albedo = texelFetch(g_albedo, texel, 0);
+    vec3 normal = normalize(texelFetch(g_normal, texel, 0).xyz);
+    vec3 arm = texelFetch(g_arm, texel, 0).xyz;
+
+    // the share of the far tier is lit like the forward path lights it
+    vec3 color = mix(light_surface(albedo.rgb, normal, arm, frag_pos),
+                     light_far_surface(albedo.rgb, normal, frag_pos), albedo.a);
+
+    FragColor = vec4(tone_map(color), 1.0);
+    // the sky box and the normal debug pass test against the terrain
+    gl_FragDepth = depth;
+}
\ No newline at end of file
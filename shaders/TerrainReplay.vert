@@ -0,0 +1,67 @@
+#version 460 core
+
+// vertices of the terrain recorded from PerlinMap.tese with transform feedback, in the layout of
+// terrain::allocate_terrain_capture. passes on what the tessellation evaluation shader would output
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTex_h;
+layout (location = 3) in vec2 aTex;
+
+#include "terrain_normal.glsl"
+
+out terrain_data {
+    float height; // real value of height
+    float height_01; // height value range (0,1)
+    vec2 height_coord; // texture coordinate of the height and splat map
+    vec2 tex_coord;
+    vec3 frag_pos;
+
+    vec3 w_normal;
+    vec3 tangent;
+    vec3 bitangent;
+    vec3 blended_normal;
+} data;
+
+struct terrain_material {
+    // one layer per material
+    sampler2DArray diff;
+    sampler2DArray norm;
+    sampler2DArray arm;
+
+    float triplanar_scale;
+    int triplanar_sharpness;
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+uniform float terrain_height;
+
+uniform terrain_material material;
+
+out vec3 weights;
+
+// the depth pre-pass replays with this shader in another program, the positions must match exactly
+invariant gl_Position;
+
+void main() {
+    // the captured positions are in world space already
+    data.frag_pos = aPos;
+    data.height = aPos.y;
+    data.height_01 = (aPos.y + terrain_height / 3.0f) / terrain_height;
+    data.height_coord = aTex_h;
+    data.tex_coord = aTex;
+
+    data.w_normal = aNormal;
+    tangent_frame(data.w_normal, data.tangent, data.bitangent);
+
+    // the triplanar sharpness may change after the capture
+    weights = abs(data.w_normal);
+    weights = vec3(pow(weights.x, material.triplanar_sharpness),
+                   pow(weights.y, material.triplanar_sharpness),
+                   pow(weights.z, material.triplanar_sharpness));
+
+    weights = weights / (weights.x + weights.y + weights.z);
+
+    gl_Position = projection * view * vec4(aPos, 1.0);
+}
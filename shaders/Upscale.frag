@@ -0,0 +1,44 @@
+#version 460 core
+
+// stretches the scaled scene of the dynamic resolution over the default framebuffer
+
+// permutation options, injected by utilities::shader
+#ifndef SHARPEN
+#define SHARPEN 0
+#endif
+
+out vec4 FragColor;
+
+in vec2 tex_coords;
+
+uniform sampler2D scene;
+// share of the scene texture covered by the scaled frame
+uniform vec2 uv_scale;
+// strength of the sharpening, 0 leaves the bilinear result
+uniform float sharpness;
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    // texels outside of the scaled frame hold an older frame
+    vec2 uv_max = uv_scale - texel * 0.5;
+    vec2 uv = min(tex_coords * uv_scale, uv_max);
+
+    vec3 color = texture(scene, uv).rgb;
+
+#if SHARPEN
+    // unsharp mask over the four neighbours, clamped to their range so edges do not ring
+    vec3 north = texture(scene, min(uv + vec2(0.0, texel.y), uv_max)).rgb;
+    vec3 south = texture(scene, max(uv - vec2(0.0, texel.y), texel * 0.5)).rgb;
+    vec3 east = texture(scene, min(uv + vec2(texel.x, 0.0), uv_max)).rgb;
+    vec3 west = texture(scene, max(uv - vec2(texel.x, 0.0), texel * 0.5)).rgb;
+
+    vec3 low = min(min(min(north, south), min(east, west)), color);
+    vec3 high = max(max(max(north, south), max(east, west)), color);
+
+    vec3 blur = (north + south + east + west) * 0.25;
+    color = clamp(color + (color - blur) * sharpness, low, high);
+#endif
+
+    FragColor = vec4(color, 1.0);
+}
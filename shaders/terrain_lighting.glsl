@@ -0,0 +1,248 @@
+// lighting of the terrain, shared by the forward terrain shader and the deferred lighting pass.
+// included with #include, so no #version here
+
+// permutation options, see PerlinMap.frag
+// LIGHT_MODE: 0 no lighting, 1 phong, 2 pbr
+#ifndef LIGHT_MODE
+#define LIGHT_MODE 2
+#endif
+#ifndef GAMMA_CORRECTION
+#define GAMMA_CORRECTION 1
+#endif
+
+struct light_data {
+    vec3 light_pos;
+    vec3 view_pos;
+    vec3 light_color;
+
+    float ambient_strength;
+    float specular_strength;
+    float specular_pow;
+};
+
+uniform light_data light;
+
+// IBL
+// L2 spherical harmonics of the diffuse irradiance, projected from the hdr on the cpu
+uniform vec3 irradiance_sh[9];
+uniform samplerCube prefilter_map;
+uniform sampler2D brdf_lut;
+
+const float PI = 3.14159265359;
+
+vec3 blinn_phong_lighting(vec3 normal, vec3 diff, float ao, vec3 frag_pos) {
+    // ambient
+    vec3 ambient = light.ambient_strength * diff * light.light_color * ao;
+
+    // diffuse
+    vec3 light_dir = normalize(light.light_pos - frag_pos);
+    float diff_factor = max(dot(normal, light_dir), 0.0);
+    vec3 diffuse = diff * diff_factor * light.light_color;
+
+    // specular
+
+    return vec3(ambient + diffuse);
+}
+
+// ----------------------------------------------------------------------------
+// Easy trick to get tangent-normals to world-space to keep PBR code simplified.
+// Don't worry if you don't get what's going on; you generally want to do normal
+// mapping the usual way for performance anyways; I do plan make a note of this
+// technique somewhere later in the normal mapping tutorial.
+//vec3 getNormalFromMap()
+//{
+//    vec3 tangentNormal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+//
+//    vec3 Q1  = dFdx(WorldPos);
+//    vec3 Q2  = dFdy(WorldPos);
+//    vec2 st1 = dFdx(TexCoords);
+//    vec2 st2 = dFdy(TexCoords);
+//
+//    vec3 N   = normalize(Normal);
+//    vec3 T  = normalize(Q1*st2.t - Q2*st1.t);
+//    vec3 B  = -normalize(cross(N, T));
+//    mat3 TBN = mat3(T, B, N);
+//
+//    return normalize(TBN * tangentNormal);
+//}
+
+// ----------------------------------------------------------------------------
+float DistributionGGX(vec3 N, vec3 H, float roughness)
+{
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(dot(N, H), 0.0);
+    float NdotH2 = NdotH * NdotH;
+
+    float nom = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+
+    return nom / denom;
+}
+
+// ----------------------------------------------------------------------------
+float GeometrySchlickGGX(float NdotV, float roughness)
+{
+    float r = (roughness + 1.0);
+    float k = (r * r) / 8.0;
+
+    float nom = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+
+    return nom / denom;
+}
+
+// ----------------------------------------------------------------------------
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
+{
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
+    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
+
+    return ggx1 * ggx2;
+}
+
+// ----------------------------------------------------------------------------
+vec3 fresnelSchlick(float cosTheta, vec3 F0)
+{
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+// ----------------------------------------------------------------------------
+vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
+{
+    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+// evaluate the irradiance in the direction of normal, same basis order as project_irradiance_sh9
+vec3 irradiance_from_sh(vec3 n) {
+    return irradiance_sh[0] * 0.282095
+    + irradiance_sh[1] * 0.488603 * n.y
+    + irradiance_sh[2] * 0.488603 * n.z
+    + irradiance_sh[3] * 0.488603 * n.x
+    + irradiance_sh[4] * 1.092548 * n.x * n.y
+    + irradiance_sh[5] * 1.092548 * n.y * n.z
+    + irradiance_sh[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+    + irradiance_sh[7] * 1.092548 * n.x * n.z
+    + irradiance_sh[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+vec3 pbr_lighting(vec3 N, vec3 albedo, float ao, float roughness, float metallic, vec3 frag_pos) {
+
+    // input lighting data
+    vec3 view_dir = normalize(light.view_pos - frag_pos);
+
+    // calculate reflectance at normal incidence; if dia-electric (like plastic) use F0
+    // of 0.04 and if it's a metal, use the albedo color as F0 (metallic workflow)
+    vec3 F0 = vec3(0.04);
+    F0 = mix(F0, albedo, metallic);
+
+    //-----------------------------------------------------------------------------------------------------------------
+    //------------------------------------------compute direct light--------------------------------------------------
+    // reflectance equation
+    vec3 Lo = vec3(0.0);
+
+    // calculate per-light radiance
+    vec3 light_dir = normalize(light.light_pos - frag_pos);
+    vec3 half_dir = normalize(view_dir + light_dir);
+
+    // compute light attenuation
+    //    float distance = length(light_data.light_pos - frag_pos);
+    //    float attenuation = 1.0 / (distance * distance);
+    //    vec3 radiance = light_data.light_color * attenuation;
+
+    // Cook-Torrance BRDF
+    float NDF = DistributionGGX(N, half_dir, roughness);
+    float G = GeometrySmith(N, view_dir, light_dir, roughness);
+    vec3 Frenel = fresnelSchlick(max(dot(half_dir, view_dir), 0.0), F0);
+
+    vec3 numerator = NDF * G * Frenel;
+    float denominator = 4.0 * max(dot(N, view_dir), 0.0) * max(dot(N, light_dir), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
+    vec3 specular_direct_light = numerator / denominator;
+
+    // kS is equal to Fresnel
+    vec3 kS_direct_light = Frenel;
+    // for energy conservation, the diffuse and specular light can't
+    // be above 1.0 (unless the surface emits light); to preserve this
+    // relationship the diffuse component (kD) should equal 1.0 - kS.
+    vec3 kD_direct_light = vec3(1.0) - kS_direct_light;
+    // multiply kD by the inverse metalness such that only non-metals
+    // have diffuse lighting, or a linear blend if partly metal (pure metals
+    // have no diffuse light).
+    kD_direct_light *= 1.0 - metallic;
+
+    // scale light by NdotL
+    float NdotL = max(dot(N, light_dir), 0.0);
+
+    // add to outgoing radiance Lo
+    // note that already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+    Lo += (kD_direct_light * albedo / PI + specular_direct_light) * NdotL;
+
+    // ambient lighting (we now use IBL as the ambient term)
+    vec3 F = fresnelSchlickRoughness(max(dot(N, view_dir), 0.0), F0, roughness);
+
+    vec3 kS_ambient_light = F;
+    vec3 kD_ambient_light = 1.0 - kS_ambient_light;
+    kD_ambient_light *= 1.0 - metallic;
+
+    vec3 irradiance = max(irradiance_from_sh(N), vec3(0.0));
+    vec3 diffuse = irradiance * albedo;
+    //-----------------------------------------------------------------------------------------------------------------
+    //-----------------------------------------------------------------------------------------------------------------
+
+
+    //-----------------------------------------------------------------------------------------------------------------
+    //-----------------------sample prefilter and brdf texture to compute ambient light--------------------------------
+    // sample both the pre-filter map and the BRDF lut and combine them together
+    // as per the Split-Sum approximation to get the IBL specular part.
+    vec3 relfect_dir = reflect(-view_dir, N); // reflect direction to sample prefilter map
+    const float MAX_REFLECTION_LOD = 4.0; // calculate the mipmap level based on roughness
+    vec3 prefilteredColor = textureLod(prefilter_map, relfect_dir, roughness * MAX_REFLECTION_LOD).rgb;
+
+    // sample the response of the BRDF in the direction of that viewing angle
+    // explicit lod, the tiers call this from non-uniform control flow
+    vec2 brdf = textureLod(brdf_lut, vec2(max(dot(N, view_dir), 0.0), roughness), 0.0).rg;
+    vec3 specular_ambient_light = prefilteredColor * (F * brdf.x + brdf.y);
+
+    // compute ambient light partion
+    vec3 ambient = (kD_ambient_light * diffuse + specular_ambient_light) * ao;
+    //-----------------------------------------------------------------------------------------------------------------
+    //-----------------------------------------------------------------------------------------------------------------
+
+    // combine ambient light and diffuse
+    return ambient * light.ambient_strength + Lo;
+}
+
+// lighting of the near and mid tier of the shading lod
+vec3 light_surface(vec3 albedo, vec3 normal, vec3 arm, vec3 frag_pos) {
+#if LIGHT_MODE == 1
+    return blinn_phong_lighting(normal, albedo, arm.r, frag_pos);
+#elif LIGHT_MODE == 2
+    return pbr_lighting(normal, albedo, arm.r, arm.g, arm.b, frag_pos);
+#else
+    return albedo;
+#endif
+}
+
+// lighting of the far tier, without occlusion and specular
+vec3 light_far_surface(vec3 albedo, vec3 normal, vec3 frag_pos) {
+#if LIGHT_MODE == 1
+    return blinn_phong_lighting(normal, albedo, 1.0, frag_pos);
+#elif LIGHT_MODE == 2
+    // the diffuse terms of pbr_lighting, without fresnel
+    vec3 light_dir = normalize(light.light_pos - frag_pos);
+    vec3 irradiance = max(irradiance_from_sh(normal), vec3(0.0));
+    return albedo * (max(dot(normal, light_dir), 0.0) / PI + irradiance * light.ambient_strength);
+#else
+    return albedo;
+#endif
+}
+
+vec3 tone_map(vec3 color) {
+#if GAMMA_CORRECTION
+    color = pow(color / (color + vec3(1.0)), vec3(1.0 / 2.2));
+#endif
+    return color;
+}
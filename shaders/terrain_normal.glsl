@@ -0,0 +1,37 @@
+// normal and tangent frame of the terrain surface, shared by the tessellation evaluation and replay shaders.
+// included with #include, so no #version here
+
+/**
+ * normal of the height map in model space, from the differences of the neighbouring heights
+ * @param height_map height map of the chunk
+ * @param tex_coord texture coordinate of the vertex
+ * @param height_scale scale of the sampled heights
+ */
+vec3 height_map_normal(sampler2D height_map, vec2 tex_coord, float height_scale) {
+
+    float uTexelSize = 1.0 / 256.0;
+    float vTexelSize = 1.0 / 256.0;
+
+    // Sample heights around the current texture coordinate
+    float left = texture(height_map, tex_coord + vec2(-uTexelSize, 0.0)).x * height_scale * 2.0 - 1.0;
+    float right = texture(height_map, tex_coord + vec2(uTexelSize, 0.0)).x * height_scale * 2.0 - 1.0;
+    float up = texture(height_map, tex_coord + vec2(0.0, vTexelSize)).x * height_scale * 2.0 - 1.0;
+    float down = texture(height_map, tex_coord + vec2(0.0, -vTexelSize)).x * height_scale * 2.0 - 1.0;
+
+    // construct the normal directly based on the cross-product formula.
+    return normalize(vec3(left - right, uTexelSize, down - up));
+}
+
+/**
+ * tangent and bitangent around a normal, the tangent lies in the horizontal plane where possible
+ */
+void tangent_frame(vec3 normal, out vec3 tangent, out vec3 bitangent) {
+    // may be change the order of cross
+    if (abs(dot(normal, vec3(0, 1, 0))) < 0.999) {
+        tangent = normalize(cross(vec3(0, 1, 0), normal));
+    } else {
+        tangent = normalize(cross(vec3(1, 0, 0), normal));
+    }
+
+    bitangent = normalize(cross(normal, tangent));
+}
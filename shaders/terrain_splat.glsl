@@ -0,0 +1,18 @@
+// material layers of the terrain from the splat map of the chunk, built by terrain::get_splat_map.
+// included with #include, so no #version here
+
+// rgba8 per height map texel: first layer, second layer, blend factor towards the second layer, slope
+uniform sampler2D splat_map;
+
+/**
+ * the two material layers at a point of the chunk and how far to blend from the first to the second
+ * @param height_coord texture coordinate of the height map
+ */
+void get_splat(vec2 height_coord, out int first_index, out int second_index, out float blend) {
+    // one fetch of the nearest texel, the indices must not be interpolated
+    vec4 splat = texture(splat_map, height_coord);
+
+    first_index = int(splat.r * 255.0 + 0.5);
+    second_index = int(splat.g * 255.0 + 0.5);
+    blend = splat.b;
+}
@@ -0,0 +1,210 @@
+#include "cdlod.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace terrain {
+
+    namespace {
+        // distance in the xz plane from the camera to a node, the vertex shader morphs by the same distance
+        float
+        node_distance(const glm::vec2 &origin, float size, const glm::vec2 &camera) {
+            float dx = std::max({origin.x - camera.x, 0.0f, camera.x - (origin.x + size)});
+            float dz = std::max({origin.y - camera.y, 0.0f, camera.y - (origin.y + size)});
+            return std::sqrt(dx * dx + dz * dz);
+        }
+
+        void
+        select_node(std::vector<glm::vec4> &nodes, const glm::vec2 &origin, float size, int level,
+                    const glm::vec2 &camera, const cdlod_settings &settings) {
+            // a node is split while the finer level reaches into it
+            if (level == 0 || node_distance(origin, size, camera) > settings.leaf_range * std::exp2f(level - 1)) {
+                nodes.emplace_back(origin.x, origin.y, size, static_cast<float>(level));
+                return;
+            }
+
+            float half = size * 0.5f;
+            select_node(nodes, origin, half, level - 1, camera, settings);
+            select_node(nodes, origin + glm::vec2(half, 0.0f), half, level - 1, camera, settings);
+            select_node(nodes, origin + glm::vec2(0.0f, half), half, level - 1, camera, settings);
+            select_node(nodes, origin + glm::vec2(half, half), half, level - 1, camera, settings);
+        }
+    }
+
+    /**
+     * create the grid every node is drawn with, and an empty instance buffer
+     * @param grid_size quads per side
+     * @return the mesh
+     */
+    cdlod_mesh
+    create_cdlod_mesh(int grid_size) {
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+
+        // positions from 0 to 1, exact for power of two grid sizes so the morph in the shader is exact too
+        for (int z = 0; z <= grid_size; ++z) {
+            for (int x = 0; x <= grid_size; ++x) {
+                vertices.push_back(static_cast<float>(x) / static_cast<float>(grid_size));
+                vertices.push_back(static_cast<float>(z) / static_cast<float>(grid_size));
+            }
+        }
+
+        // two counter-clockwise triangles per quad seen from above, like the tessellated patches
+        for (int z = 0; z < grid_size; ++z) {
+            for (int x = 0; x < grid_size; ++x) {
+                unsigned int i00 = z * (grid_size + 1) + x;
+                unsigned int i01 = i00 + 1;
+                unsigned int i10 = i00 + grid_size + 1;
+                unsigned int i11 = i10 + 1;
+
+                indices.insert(indices.end(), {i00, i10, i01, i01, i10, i11});
+            }
+        }
+
+        cdlod_mesh mesh;
+        mesh.index_count = static_cast<int>(indices.size());
+
+        glGenVertexArrays(1, &mesh.vao);
+        glBindVertexArray(mesh.vao);
+
+        glGenBuffers(1, &mesh.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(float) * vertices.size()), vertices.data(),
+                     GL_STATIC_DRAW);
+
+        // grid position attribute
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+        glEnableVertexAttribArray(0);
+
+        glGenBuffers(1, &mesh.ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(unsigned int) * indices.size()),
+                     indices.data(), GL_STATIC_DRAW);
+
+        glGenBuffers(1, &mesh.instance_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.instance_vbo);
+
+        // node attribute, one per instance
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), nullptr);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        return mesh;
+    }
+
+    /**
+     * replace the instance data with the nodes selected for this frame
+     * @param mesh
+     * @param nodes from select_cdlod_nodes
+     */
+    void
+    upload_cdlod_nodes(cdlod_mesh &mesh, const std::vector<glm::vec4> &nodes) {
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.instance_vbo);
+
+        // grow only, the node count changes a little with every camera move
+        if (nodes.size() > mesh.instance_capacity) {
+            mesh.instance_capacity = std::max(nodes.size(), mesh.instance_capacity * 2);
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(glm::vec4) * mesh.instance_capacity),
+                         nullptr, GL_STREAM_DRAW);
+        }
+
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(sizeof(glm::vec4) * nodes.size()), nodes.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void
+    delete_cdlod_mesh(cdlod_mesh &mesh) {
+        glDeleteVertexArrays(1, &mesh.vao);
+        glDeleteBuffers(1, &mesh.vbo);
+        glDeleteBuffers(1, &mesh.ebo);
+        glDeleteBuffers(1, &mesh.instance_vbo);
+        mesh = cdlod_mesh();
+    }
+
+    /**
+     * Append the nodes of a chunk to draw for the camera, finer ones nearer to it.
+     * Neighbouring nodes differ by one level at most, the vertex shader morphs the finer one into the coarser
+     * one towards the end of its range so their edges meet
+     * @param nodes target vector
+     * @param origin lower x and z corner of the chunk in model space
+     * @param size side of the chunk, a power of two multiple of the leaf size
+     * @param camera x and z of the camera in model space of the chunk
+     * @param settings
+     */
+    void
+    select_cdlod_nodes(std::vector<glm::vec4> &nodes, const glm::vec2 &origin, float size, const glm::vec2 &camera,
+                       const cdlod_settings &settings) {
+        int level = static_cast<int>(std::round(std::log2(size / settings.leaf_size)));
+        select_node(nodes, origin, size, level, camera, settings);
+    }
+
+    /**
+     * Append the nodes of a chunk and remember where they are in the instance buffer
+     * @param nodes nodes of every chunk of the frame
+     * @param chunks chunks of the frame
+     * @param chunk chunk to select the nodes of
+     * @param chunk_size side of a chunk, the chunk is centred on its grid position
+     * @param camera_position world position of the camera
+     * @param settings
+     */
+    void
+    select_cdlod_chunk(std::vector<glm::vec4> &nodes, std::vector<cdlod_chunk> &chunks, const map_chunk &chunk,
+                       float chunk_size, const glm::vec3 &camera_position, const cdlod_settings &settings) {
+        // the nodes are in model space of the chunk
+        glm::vec2 chunk_position(static_cast<float>(chunk.grid_x) * chunk_size,
+                                 static_cast<float>(chunk.grid_y) * chunk_size);
+        auto first_node = static_cast<int>(nodes.size());
+        select_cdlod_nodes(nodes, glm::vec2(chunk_size * -0.5f), chunk_size,
+                           glm::vec2(camera_position.x, camera_position.z) - chunk_position, settings);
+        chunks.push_back({&chunk, first_node, static_cast<int>(nodes.size()) - first_node});
+    }
+
+    /**
+     * Upload the nodes of the frame and draw them chunk by chunk as instances of the grid with a program
+     * made of TerrainCdlod.vert, the program is already in use
+     * @param program
+     * @param mesh
+     * @param nodes nodes of every chunk, see select_cdlod_chunk
+     * @param chunks chunks to draw
+     * @param camera_position world position of the camera, the morph depends on the distance to it
+     * @param chunk_size side of a chunk
+     * @param settings settings the nodes were selected with
+     * @param splat_texture_index texture unit of the splat map
+     */
+    void
+    draw_cdlod_chunks(utilities::shader &program, cdlod_mesh &mesh, const std::vector<glm::vec4> &nodes,
+                      const std::vector<cdlod_chunk> &chunks, const glm::vec3 &camera_position, float chunk_size,
+                      const cdlod_settings &settings, int splat_texture_index) {
+        upload_cdlod_nodes(mesh, nodes);
+
+        program
+                .set_vec3("camera_pos", camera_position)
+                .set_float("cdlod.grid_size", static_cast<float>(settings.grid_size))
+                .set_float("cdlod.leaf_range", settings.leaf_range)
+                .set_float("cdlod.morph_ratio", settings.morph_ratio)
+                .set_float("cdlod.chunk_size", chunk_size);
+
+        glBindVertexArray(mesh.vao);
+
+        for (const cdlod_chunk &chunk: chunks) {
+            glActiveTexture(GL_TEXTURE0 + splat_texture_index);
+            glBindTexture(GL_TEXTURE_2D, chunk.chunk->splat_map_id);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, chunk.chunk->height_map_id);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f),
+                                             glm::vec3(static_cast<float>(chunk.chunk->grid_x) * chunk_size, 0,
+                                                       static_cast<float>(chunk.chunk->grid_y) * chunk_size));
+            program
+                    .set_mat4("model", model);
+
+            glDrawElementsInstancedBaseInstance(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT, nullptr,
+                                                chunk.node_count, static_cast<GLuint>(chunk.first_node));
+        }
+    }
+}
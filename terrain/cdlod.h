@@ -0,0 +1,69 @@
+#ifndef INC_3DPERLINMAP_CDLOD_H
+#define INC_3DPERLINMAP_CDLOD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "map_chunk.h"
+#include "../utilities/shader.h"
+
+namespace terrain {
+
+    // continuous distance-dependent level of detail: a quadtree of square nodes per chunk, every node is drawn as
+    // the same instanced grid and TerrainCdlod.vert fetches the heights, no tessellation shaders are needed
+    struct cdlod_settings {
+        // quads per side of the grid of a node
+        int grid_size = 32;
+        // side of the smallest nodes, level 0
+        float leaf_size = 32.0f;
+        // nodes of level 0 are used up to this distance, every level doubles it
+        float leaf_range = 160.0f;
+        // part of its range from where a level morphs into the next coarser one.
+        // neighbouring levels only meet without cracks while leaf_range * morph_ratio >= 2.83 * leaf_size
+        float morph_ratio = 0.7f;
+    };
+
+    // the grid mesh and the per node instance data: x and z of the lower corner, side and level of the node
+    struct cdlod_mesh {
+        unsigned int vao = 0;
+        unsigned int vbo = 0;
+        unsigned int ebo = 0;
+        unsigned int instance_vbo = 0;
+        int index_count = 0;
+        // size of the instance buffer in nodes
+        std::size_t instance_capacity = 0;
+    };
+
+    // nodes of one chunk in the instance buffer, see select_cdlod_chunk
+    struct cdlod_chunk {
+        const map_chunk *chunk = nullptr;
+        int first_node = 0;
+        int node_count = 0;
+    };
+
+    cdlod_mesh
+    create_cdlod_mesh(int grid_size);
+
+    void
+    upload_cdlod_nodes(cdlod_mesh &mesh, const std::vector<glm::vec4> &nodes);
+
+    void
+    delete_cdlod_mesh(cdlod_mesh &mesh);
+
+    void
+    select_cdlod_nodes(std::vector<glm::vec4> &nodes, const glm::vec2 &origin, float size, const glm::vec2 &camera,
+                       const cdlod_settings &settings);
+
+    void
+    select_cdlod_chunk(std::vector<glm::vec4> &nodes, std::vector<cdlod_chunk> &chunks, const map_chunk &chunk,
+                       float chunk_size, const glm::vec3 &camera_position, const cdlod_settings &settings);
+
+    void
+    draw_cdlod_chunks(utilities::shader &program, cdlod_mesh &mesh, const std::vector<glm::vec4> &nodes,
+                      const std::vector<cdlod_chunk> &chunks, const glm::vec3 &camera_position, float chunk_size,
+                      const cdlod_settings &settings, int splat_texture_index);
+}
+
+#endif //INC_3DPERLINMAP_CDLOD_H
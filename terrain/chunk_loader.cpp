@@ -0,0 +1,399 @@
+#include "chunk_loader.h"
+#include "horizon_culling.h"
+#include "../utilities/cpu_trace.h"
+#include "../utilities/system_memory.h"
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace terrain {
+
+    chunk_loader::chunk_loader(const chunk_loader_settings &settings)
+            : settings(settings) {
+    }
+
+    chunk_loader::~chunk_loader() {
+        stop();
+    }
+
+    /**
+     * Start the loader thread, the generation parameters and splat settings must be set before
+     * @param position camera position the first chunks are generated around
+     */
+    void
+    chunk_loader::start(const glm::vec3 &position) {
+        if (loader.joinable()) return;
+        if (generation_snapshot.load() == nullptr)
+            throw std::runtime_error("the chunk loader needs generation parameters before it starts");
+
+        set_camera_position(position);
+        loader = std::jthread([this](std::stop_token stop_token) { load_loop(stop_token); });
+    }
+
+    /**
+     * Stop the loader thread and wait for it, the current job is cancelled
+     */
+    void
+    chunk_loader::stop() {
+        if (!loader.joinable()) return;
+        loader.request_stop();
+        loader.join();
+    }
+
+    /**
+     * Publish new noise parameters, the loader regenerates the chunks built with older ones nearest first and
+     * cancels the work they supersede. The old heights are kept until then
+     * @param parameters tagged with the next epoch, never changed after this call
+     */
+    void
+    chunk_loader::set_generation_parameters(std::shared_ptr<generation_parameters> parameters) {
+        parameters->epoch = generation_epoch + 1;
+
+        unsigned int epoch = parameters->epoch;
+        generation_snapshot = std::shared_ptr<const generation_parameters>(std::move(parameters));
+        generation_epoch = epoch;
+    }
+
+    /**
+     * Hand new splat settings to the loader, it rebuilds the splat map of every chunk built with older ones
+     * @param settings height bands and slope layer
+     */
+    void
+    chunk_loader::set_splat_settings(const splat_settings &settings) {
+        std::lock_guard<std::mutex> lock(splat_mutex);
+        shared_splat_settings = settings;
+        ++splat_version;
+    }
+
+    /**
+     * Move the center of the loading range, the loader picks it up with its next pass
+     * @param position camera position
+     */
+    void
+    chunk_loader::set_camera_position(const glm::vec3 &position) {
+        std::lock_guard<std::mutex> lock(camera_mutex);
+        camera_position = position;
+    }
+
+    /**
+     * Apply the changes of the chunk map made by the loader: new chunks are moved in and queued for the upload,
+     * dropped chunks are handed to the callback and erased
+     * @param upload called with chunk_update::evicted before a chunk is erased
+     */
+    void
+    chunk_loader::insert_new_chunks(const chunk_upload &upload) {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        while (!chunk_changes.empty()) {
+            chunk_change &change = chunk_changes.front();
+            if (change.chunk) {
+                chunks.insert_or_assign(change.grid, std::move(*change.chunk));
+                created_uploads.push(change.grid);
+                --pending_new_chunks;
+            } else if (auto chunk = chunks.find(change.grid); chunk != chunks.end()) {
+                upload(chunk->second, chunk_update::evicted);
+                chunks.erase(chunk);
+            }
+
+            if (--pending_changes[change.grid] == 0)
+                pending_changes.erase(change.grid);
+            chunk_changes.pop();
+        }
+    }
+
+    /**
+     * Bring the chunk map up to date with the loader and hand what changed to the callback: the new chunks in the
+     * order they were generated, the rebuilt splat maps, and the regenerated chunks of the latest parameters all
+     * at once, so that no frame mixes two generations. Regenerations of a superseded epoch are dropped
+     * @param upload uploads the data of a chunk
+     * @param max_created new chunks handed over in this call, the others wait for the next ones
+     * @return new chunks handed over
+     */
+    std::size_t
+    chunk_loader::update(const chunk_upload &upload, std::size_t max_created) {
+        TRACE_SCOPE("chunk loader update");
+        insert_new_chunks(upload);
+
+        std::size_t created = 0;
+        while (created < max_created && !created_uploads.empty()) {
+            // dropped before it came up
+            auto chunk = chunks.find(created_uploads.front());
+            created_uploads.pop();
+            if (chunk == chunks.end()) continue;
+
+            upload(chunk->second, chunk_update::created);
+            ++created;
+        }
+
+        std::queue<std::pair<std::pair<int, int>, std::vector<unsigned char>>> rebuilt_splat_maps;
+        {
+            std::lock_guard<std::mutex> lock(splat_mutex);
+            std::swap(rebuilt_splat_maps, splat_rebuilds);
+        }
+        for (; !rebuilt_splat_maps.empty(); rebuilt_splat_maps.pop()) {
+            auto &[grid, splat_data] = rebuilt_splat_maps.front();
+            auto chunk = chunks.find(grid);
+            if (chunk == chunks.end()) continue;
+
+            chunk->second.splat_data = std::move(splat_data);
+            upload(chunk->second, chunk_update::splat_rebuilt);
+        }
+
+        // the loader reads the heights under generation_mutex, the data is swapped under it and uploaded after
+        std::vector<map_chunk *> regenerated_chunks;
+        {
+            TRACE_SCOPE("swap regenerated chunks");
+            std::lock_guard<std::mutex> lock(generation_mutex);
+            for (; !regenerations.empty(); regenerations.pop()) {
+                chunk_regeneration &task = regenerations.front();
+                auto entry = chunks.find(task.grid);
+                if (task.epoch != generation_epoch || entry == chunks.end()) continue;
+
+                map_chunk &chunk = entry->second;
+                chunk.height_data = std::move(task.replacement.height_data);
+                chunk.slope_data = std::move(task.replacement.slope_data);
+                chunk.splat_data = std::move(task.replacement.splat_data);
+                chunk.patch_min_heights = std::move(task.replacement.patch_min_heights);
+                chunk.patch_max_heights = std::move(task.replacement.patch_max_heights);
+                regenerated_chunks.push_back(&chunk);
+            }
+        }
+        for (map_chunk *chunk: regenerated_chunks)
+            upload(*chunk, chunk_update::regenerated);
+
+        return created;
+    }
+
+    /**
+     * @return chunks generated by the loader that were not handed to the callback yet
+     */
+    std::size_t
+    chunk_loader::get_upload_queue_size() {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        return created_uploads.size() + pending_new_chunks;
+    }
+
+    /**
+     * Look a chunk up from the loader thread
+     * @return the chunk, nullptr while it is not moved in yet or a change of it is still pending
+     */
+    map_chunk *
+    chunk_loader::find_loaded_chunk(int x, int y) {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        if (pending_changes.contains({x, y})) return nullptr;
+        auto chunk = chunks.find({x, y});
+        return chunk == chunks.end() ? nullptr : &chunk->second;
+    }
+
+    /**
+     * Continuously generate the chunks around the camera with the latest parameters, see chunk_loader
+     * @param stop_token stops the loader
+     */
+    void
+    chunk_loader::load_loop(std::stop_token stop_token) {
+        const int texture_width = settings.texture_width;
+        const int texture_height = settings.texture_height;
+
+        // expand the loading range after first load
+        int expand_range = 0;
+
+        // copy of the splat settings, taken whenever they change
+        splat_settings current_splat_settings;
+        unsigned int current_splat_version = 0;
+
+        // chunks generated and not dropped, the chunk map has them once update moved them in
+        std::unordered_set<std::pair<int, int>, pair_hash> generated_chunks;
+
+        // chunks with octave sums, see octave_caching
+        std::unordered_set<std::pair<int, int>, pair_hash> cached_chunks;
+        const std::size_t cache_chunk_size = sizeof(double) * texture_width * texture_height;
+
+        /**
+         * build new heights, slopes, bounds and splat map for a chunk with a snapshot of the parameters
+         * @return false when a newer epoch or the stop of the loader cancelled it
+         */
+        auto regenerate_chunk = [&](map_chunk &chunk, const generation_parameters &parameters,
+                                    bool use_octave_sums) {
+            TRACE_SCOPE("regenerate chunk");
+            auto cancelled = [&]() { return generation_epoch != parameters.epoch || stop_token.stop_requested(); };
+
+            map_chunk replacement(chunk.grid_x, chunk.grid_y, std::vector<float>(texture_width * texture_height));
+            int octaves = parameters.layer_count;
+            if (use_octave_sums) {
+                octaves = update_height_map(replacement.height_data, chunk.octaves, parameters.perlin,
+                                            texture_width, texture_height, parameters.scale, parameters.layer_count,
+                                            static_cast<float>(chunk.grid_x), static_cast<float>(chunk.grid_y),
+                                            cancelled);
+                if (octaves < 0) return false;
+            } else if (!get_height_map(replacement.height_data, parameters.perlin, texture_width, texture_height,
+                                       parameters.scale, parameters.layer_count, static_cast<float>(chunk.grid_x),
+                                       static_cast<float>(chunk.grid_y), cancelled)) {
+                return false;
+            }
+            generated_octaves = octaves;
+
+            get_slope_map(replacement.slope_data, replacement.height_data, texture_width, texture_height,
+                          settings.terrain_height);
+            get_patch_height_bounds(replacement.patch_min_heights, replacement.patch_max_heights,
+                                    replacement.height_data, texture_width, texture_height, settings.patch_numbers);
+            get_splat_map(replacement.splat_data, replacement.height_data, replacement.slope_data,
+                          texture_width, texture_height, current_splat_settings);
+
+            chunk.generation_epoch = parameters.epoch;
+            chunk.sample_step = 1;
+            chunk.splat_version = current_splat_version;
+
+            std::lock_guard<std::mutex> lock(generation_mutex);
+            regenerations.push({{chunk.grid_x, chunk.grid_y}, std::move(replacement), parameters.epoch});
+            return true;
+        };
+
+        // queue a change of the chunk map for update, the loader leaves the chunk alone until it is applied
+        auto push_change = [&](const std::pair<int, int> &grid, std::optional<map_chunk> &&chunk) {
+            std::lock_guard<std::mutex> lock(chunk_mutex);
+            pending_new_chunks += chunk.has_value();
+            chunk_changes.push({grid, std::move(chunk)});
+            ++pending_changes[grid];
+        };
+
+        TRACE_THREAD_NAME("chunk loader");
+        std::cout << "chunk loader starting..." << std::endl;
+        while (!stop_token.stop_requested()) {
+
+            {
+                std::lock_guard<std::mutex> lock(splat_mutex);
+                if (current_splat_version != splat_version) {
+                    current_splat_settings = shared_splat_settings;
+                    current_splat_version = splat_version;
+                }
+            }
+
+            glm::vec3 position;
+            {
+                std::lock_guard<std::mutex> lock(camera_mutex);
+                position = camera_position;
+            }
+            int current_grid_x = static_cast<int>(std::trunc(position.x / settings.map_width + 0.5f));
+            int current_grid_y = static_cast<int>(std::trunc(position.z / settings.map_height + 0.5f));
+            const int range = settings.render_distance + expand_range;
+            bool generated = false;
+
+            for (int x = current_grid_x - range; x <= current_grid_x + range && !stop_token.stop_requested(); ++x) {
+                for (int y = current_grid_y - range;
+                     y <= current_grid_y + range && !stop_token.stop_requested(); ++y) {
+
+                    if (!generated_chunks.contains({x, y})) {
+                        // a chunk built while the parameters change is regenerated with the next epoch
+                        std::shared_ptr<const generation_parameters> parameters = generation_snapshot;
+                        int sample_step = progressive_generation ? settings.coarse_sample_step : 1;
+                        map_chunk chunk = generate_chunk(x, y, *parameters, texture_width, texture_height,
+                                                         settings.terrain_height, settings.patch_numbers,
+                                                         current_splat_settings, current_splat_version, sample_step);
+                        chunk.generation_epoch = parameters->epoch;
+                        chunk.sample_step = sample_step;
+
+                        generated_chunks.emplace(x, y);
+                        ++generated_chunk_count;
+                        generated = true;
+                        push_change({x, y}, std::move(chunk));
+                    } else if (map_chunk *chunk = find_loaded_chunk(x, y);
+                            chunk != nullptr && chunk->splat_version != current_splat_version) {
+                        TRACE_SCOPE("rebuild splat map");
+                        // the settings changed, only the splat map is rebuilt from the heights and slopes
+                        std::vector<unsigned char> splat_data;
+                        {
+                            std::lock_guard<std::mutex> lock(generation_mutex);
+                            get_splat_map(splat_data, chunk->height_data, chunk->slope_data,
+                                          texture_width, texture_height, current_splat_settings);
+                        }
+                        chunk->splat_version = current_splat_version;
+
+                        std::lock_guard<std::mutex> lock(splat_mutex);
+                        splat_rebuilds.emplace(std::pair<int, int>(x, y), std::move(splat_data));
+                    }
+                }
+            }
+
+            // chunks far outside the loading range are dropped, their octave sums go with them
+            if (settings.evict_range > 0) {
+                const int evict_distance = settings.render_distance + settings.prefetch_range + settings.evict_range;
+                std::erase_if(generated_chunks, [&](const std::pair<int, int> &grid) {
+                    if (std::abs(grid.first - current_grid_x) <= evict_distance &&
+                        std::abs(grid.second - current_grid_y) <= evict_distance)
+                        return false;
+                    cached_chunks.erase(grid);
+                    push_change(grid, std::nullopt);
+                    return true;
+                });
+            }
+
+            // octave sums only for the chunks in render distance, and none once caching is turned off
+            bool use_octave_sums = octave_caching;
+            std::erase_if(cached_chunks, [&](const std::pair<int, int> &grid) {
+                if (use_octave_sums && std::abs(grid.first - current_grid_x) <= settings.render_distance &&
+                    std::abs(grid.second - current_grid_y) <= settings.render_distance)
+                    return false;
+                if (map_chunk *chunk = find_loaded_chunk(grid.first, grid.second))
+                    chunk->octaves = octave_cache();
+                return true;
+            });
+
+            // one chunk of an older epoch or with coarse heights per pass, the nearest, so that new chunks still
+            // come first
+            std::shared_ptr<const generation_parameters> parameters = generation_snapshot;
+            map_chunk *stale_chunk = nullptr;
+            int stale_distance = 0;
+            int coarse_chunks = 0;
+            for (int x = current_grid_x - range; x <= current_grid_x + range; ++x) {
+                for (int y = current_grid_y - range; y <= current_grid_y + range; ++y) {
+                    map_chunk *chunk = find_loaded_chunk(x, y);
+                    if (chunk == nullptr) continue;
+                    coarse_chunks += chunk->sample_step > 1;
+                    if (chunk->generation_epoch == parameters->epoch && chunk->sample_step == 1) continue;
+
+                    int distance = (x - current_grid_x) * (x - current_grid_x) +
+                                   (y - current_grid_y) * (y - current_grid_y);
+                    if (stale_chunk == nullptr || distance < stale_distance) {
+                        stale_chunk = chunk;
+                        stale_distance = distance;
+                    }
+                }
+            }
+
+            coarse_chunk_count = coarse_chunks;
+
+            if (stale_chunk != nullptr && !stop_token.stop_requested()) {
+                bool in_render_distance = std::abs(stale_chunk->grid_x - current_grid_x) <= settings.render_distance &&
+                                          std::abs(stale_chunk->grid_y - current_grid_y) <= settings.render_distance;
+                bool cached = use_octave_sums && in_render_distance;
+                if (cached && stale_chunk->octaves.sums.empty()) {
+                    std::size_t available = utilities::get_available_memory();
+                    if (octave_cache_size + cache_chunk_size > settings.octave_cache_budget ||
+                        (available != 0 && available < cache_chunk_size + settings.octave_cache_reserve)) {
+                        // the sums held so far are freed in the next pass
+                        octave_caching = false;
+                        cached = false;
+                        std::cout << "octave caching turned off, " << octave_cache_size / (1024 * 1024)
+                                  << " MB held, " << available / (1024 * 1024) << " MB available" << std::endl;
+                    }
+                }
+                if (regenerate_chunk(*stale_chunk, *parameters, cached) && cached)
+                    cached_chunks.emplace(stale_chunk->grid_x, stale_chunk->grid_y);
+            }
+
+            std::size_t cache_size = 0;
+            for (const std::pair<int, int> &grid: cached_chunks)
+                if (map_chunk *chunk = find_loaded_chunk(grid.first, grid.second))
+                    cache_size += chunk->octaves.sums.capacity() * sizeof(double);
+            octave_cache_size = cache_size;
+
+            // nothing to do until the camera moves or the parameters change
+            if (!generated && stale_chunk == nullptr)
+                std::this_thread::yield();
+
+            expand_range = settings.prefetch_range;
+        }
+        std::cout << "chunk loader stopped" << std::endl;
+    }
+}
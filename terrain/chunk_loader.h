@@ -0,0 +1,172 @@
+#ifndef INC_3DPERLINMAP_CHUNK_LOADER_H
+#define INC_3DPERLINMAP_CHUNK_LOADER_H
+
+#include "terrain_generator.h"
+#include "map_chunk.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace terrain {
+
+    using chunk_map = std::unordered_map<std::pair<int, int>, map_chunk, pair_hash>;
+
+    // layout of the chunks and the range the chunk loader keeps generated around the camera
+    struct chunk_loader_settings {
+        int map_width = 256;
+        int map_height = 256;
+        // size of the height, slope and splat maps
+        int texture_width = 258;
+        int texture_height = 258;
+        float terrain_height = 600.0f;
+        int patch_numbers = 16;
+        int render_distance = 3;
+        // chunks generated beyond the render distance after the first pass
+        int prefetch_range = 3;
+        // chunks farther than this beyond the loading range are dropped, 0 keeps every chunk
+        int evict_range = 0;
+        // new chunks are first generated from every coarse_sample_step-th texel while progressive_generation is on
+        int coarse_sample_step = 4;
+        // the octave sums of one more chunk must fit the budget and leave the reserve to the system
+        std::size_t octave_cache_budget = 64 * 1024 * 1024;
+        std::size_t octave_cache_reserve = 512 * 1024 * 1024;
+    };
+
+    // what changed in a chunk handed to the upload callback
+    enum class chunk_update {
+        // moved in by update, its maps have no textures yet
+        created,
+        // heights, slopes, patch bounds and splat map replaced with those of the latest parameters
+        regenerated,
+        // splat map rebuilt for new splat settings
+        splat_rebuilt,
+        // dropped by the loader, erased once the callback returns
+        evicted
+    };
+
+    // called on the thread that owns the chunks, uploads what changed
+    using chunk_upload = std::function<void(map_chunk &chunk, chunk_update update)>;
+
+    /**
+     * Generates the chunks around the camera on a thread of its own: the missing chunks, then per pass the nearest
+     * chunk that was built with older noise parameters or only as a coarse preview.
+     * The chunks are owned by the thread calling update, the only one that changes the chunk map, and the results
+     * of the loader reach it through update and the upload callback. Everything but the loader thread is meant
+     * to be called from that one thread.
+     */
+    class chunk_loader {
+    public:
+        explicit chunk_loader(const chunk_loader_settings &settings);
+
+        chunk_loader(const chunk_loader &) = delete;
+
+        chunk_loader &operator=(const chunk_loader &) = delete;
+
+        ~chunk_loader();
+
+        void start(const glm::vec3 &position);
+
+        void stop();
+
+        void set_generation_parameters(std::shared_ptr<generation_parameters> parameters);
+
+        void set_splat_settings(const splat_settings &settings);
+
+        void set_camera_position(const glm::vec3 &position);
+
+        void insert_new_chunks(const chunk_upload &upload);
+
+        std::size_t update(const chunk_upload &upload, std::size_t max_created = 1);
+
+        std::size_t get_upload_queue_size();
+
+        // the chunks moved in so far, only update changes the map itself
+        [[nodiscard]] inline chunk_map &get_chunks() { return chunks; }
+
+        [[nodiscard]] inline const chunk_loader_settings &get_settings() const { return settings; }
+
+        [[nodiscard]] inline unsigned int get_generation_epoch() const { return generation_epoch; }
+
+        // octave sums of the chunks in render distance, so that a new layer_count only computes the octaves added
+        // or removed, see update_height_map. the loader turns them off when the sums of one more chunk would not
+        // fit the budget or would leave too little memory to the system
+        std::atomic<bool> octave_caching = true;
+        // new chunks are generated coarse first and shown at once, the loader refines them when no chunk is missing
+        std::atomic<bool> progressive_generation = true;
+
+        // bytes held by the octave sums
+        std::atomic<std::size_t> octave_cache_size = 0;
+        // octaves computed per texel for the last regenerated chunk
+        std::atomic<int> generated_octaves = 0;
+        // chunks in the loading range still showing their coarse heights
+        std::atomic<int> coarse_chunk_count = 0;
+        // new chunks generated so far
+        std::atomic<std::size_t> generated_chunk_count = 0;
+
+    private:
+        // a new chunk, or none to erase the chunk at the grid position
+        struct chunk_change {
+            std::pair<int, int> grid;
+            std::optional<map_chunk> chunk;
+        };
+
+        // heights, slopes, patch bounds and splat map of a chunk regenerated with the parameters of an epoch
+        struct chunk_regeneration {
+            std::pair<int, int> grid;
+            map_chunk replacement;
+            unsigned int epoch;
+        };
+
+        chunk_loader_settings settings;
+        chunk_map chunks;
+
+        // changes of the chunk map in the order the loader made them, applied by update, guarded by chunk_mutex.
+        // the loader looks chunks up under it as well, and skips those with a change still pending
+        std::queue<chunk_change> chunk_changes;
+        std::unordered_map<std::pair<int, int>, int, pair_hash> pending_changes;
+        std::size_t pending_new_chunks = 0;
+        std::mutex chunk_mutex;
+
+        // grid positions of the chunks moved in that were not handed to the callback yet
+        std::queue<std::pair<int, int>> created_uploads;
+
+        // noise parameters the loader generates with. a published snapshot is never changed, the loader takes one
+        // per job and keeps it alive until the job is done
+        std::atomic<std::shared_ptr<const generation_parameters>> generation_snapshot;
+        // epoch of the latest snapshot, a job of an older one is cancelled
+        std::atomic<unsigned int> generation_epoch = 0;
+
+        // regenerated chunks swapped in by update, guarded by generation_mutex. the loader also holds it while it
+        // reads the heights of a chunk update may swap
+        std::queue<chunk_regeneration> regenerations;
+        std::mutex generation_mutex;
+
+        // settings of the splat maps and their version, the splat maps rebuilt for them, guarded by splat_mutex
+        splat_settings shared_splat_settings;
+        unsigned int splat_version = 0;
+        std::queue<std::pair<std::pair<int, int>, std::vector<unsigned char>>> splat_rebuilds;
+        std::mutex splat_mutex;
+
+        // position the loader generates around, guarded by camera_mutex
+        glm::vec3 camera_position{0.0f};
+        std::mutex camera_mutex;
+
+        std::jthread loader;
+
+        map_chunk *find_loaded_chunk(int x, int y);
+
+        void load_loop(std::stop_token stop_token);
+    };
+}
+
+#endif //INC_3DPERLINMAP_CHUNK_LOADER_H
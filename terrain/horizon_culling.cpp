@@ -0,0 +1,177 @@
+#include "horizon_culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <queue>
+
+namespace terrain {
+
+    namespace {
+        const float pi = 3.14159265358979f;
+
+        // nearest and farthest distance in the xz plane from the camera to the rectangle of a patch
+        void
+        patch_distances(const horizon_patch &patch, const glm::vec2 &camera, float &near, float &far) {
+            float dx = std::max({patch.min_corner.x - camera.x, 0.0f, camera.x - patch.max_corner.x});
+            float dz = std::max({patch.min_corner.y - camera.y, 0.0f, camera.y - patch.max_corner.y});
+            near = std::sqrt(dx * dx + dz * dz);
+
+            float fx = std::max(std::abs(camera.x - patch.min_corner.x), std::abs(camera.x - patch.max_corner.x));
+            float fz = std::max(std::abs(camera.y - patch.min_corner.y), std::abs(camera.y - patch.max_corner.y));
+            far = std::sqrt(fx * fx + fz * fz);
+        }
+
+        /**
+         * directions around the camera the rectangle of a patch covers, in bins from the -x axis
+         * @return false when the camera stands on the patch, it covers every direction then
+         */
+        bool
+        patch_bins(const horizon_patch &patch, const glm::vec2 &camera, float bin_size, float &first, float &last) {
+            if (camera.x >= patch.min_corner.x && camera.x <= patch.max_corner.x &&
+                camera.y >= patch.min_corner.y && camera.y <= patch.max_corner.y)
+                return false;
+
+            // the corners spread less than pi around the direction of the centre, which keeps them from wrapping
+            glm::vec2 centre = (patch.min_corner + patch.max_corner) * 0.5f - camera;
+            float centre_angle = std::atan2(centre.y, centre.x);
+
+            float start = std::numeric_limits<float>::max();
+            float end = std::numeric_limits<float>::lowest();
+            for (auto &corner: {patch.min_corner, patch.max_corner,
+                                glm::vec2(patch.min_corner.x, patch.max_corner.y),
+                                glm::vec2(patch.max_corner.x, patch.min_corner.y)}) {
+                glm::vec2 direction = corner - camera;
+                float angle = std::atan2(direction.y, direction.x) - centre_angle;
+                angle -= std::round(angle / (2.0f * pi)) * 2.0f * pi;
+
+                start = std::min(start, angle);
+                end = std::max(end, angle);
+            }
+
+            first = (centre_angle + start + pi) / bin_size;
+            last = (centre_angle + end + pi) / bin_size;
+            return true;
+        }
+    }
+
+    /**
+     * lowest and highest height of every patch of a chunk, from the texels its tessellation samples
+     * @param min_heights target vector, one value from 0 to 1 per patch in the order of generate_terrain_vertices
+     * @param max_heights target vector, the same for the highest heights
+     * @param height_map heights of the chunk with a border of one texel
+     * @param map_width width of height map
+     * @param map_height height of height map
+     * @param patch_numbers patches per side of the chunk
+     */
+    void
+    get_patch_height_bounds(std::vector<float> &min_heights, std::vector<float> &max_heights,
+                            const std::vector<float> &height_map, const int &map_width, const int &map_height,
+                            int patch_numbers) {
+        int patch_width = (map_width - 2) / patch_numbers;
+        int patch_height = (map_height - 2) / patch_numbers;
+
+        min_heights.assign(patch_numbers * patch_numbers, std::numeric_limits<float>::max());
+        max_heights.assign(patch_numbers * patch_numbers, std::numeric_limits<float>::lowest());
+
+        for (int i = 0; i < patch_numbers; ++i) {
+            for (int j = 0; j < patch_numbers; ++j) {
+                int patch = i * patch_numbers + j;
+
+                // linear filtering between the texel centres reads one texel further than the patch reaches
+                for (int x = i * patch_width; x <= (i + 1) * patch_width + 1; ++x) {
+                    for (int y = j * patch_height; y <= (j + 1) * patch_height + 1; ++y) {
+                        float height = height_map[x + y * map_width];
+                        min_heights[patch] = std::min(min_heights[patch], height);
+                        max_heights[patch] = std::max(max_heights[patch], height);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Find the patches hidden behind nearer terrain. The patches are swept front to back from the camera while a
+     * horizon keeps the steepest elevation, per direction around the camera, that nearer terrain is known to
+     * reach. A patch is hidden when its highest point stays below the horizon in every direction it covers.
+     * The horizon only grows by the lowest points of patches that lie completely in front, so no visible
+     * patch is ever culled, whatever way the camera looks
+     * @param patches patches of all chunks in render distance
+     * @param camera position of the camera
+     * @param visible target vector, 1 for every patch that may be visible and 0 for every hidden one
+     * @param bin_count directions of the horizon
+     * @return number of hidden patches
+     */
+    std::size_t
+    cull_below_horizon(const std::vector<horizon_patch> &patches, const glm::vec3 &camera,
+                       std::vector<unsigned char> &visible, int bin_count) {
+        glm::vec2 camera_xz(camera.x, camera.z);
+        float bin_size = 2.0f * pi / static_cast<float>(bin_count);
+
+        std::vector<float> near(patches.size());
+        std::vector<float> far(patches.size());
+        for (std::size_t i = 0; i < patches.size(); ++i)
+            patch_distances(patches[i], camera_xz, near[i], far[i]);
+
+        std::vector<std::size_t> order(patches.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return near[a] < near[b]; });
+
+        // steepest (height - camera height) / distance of the terrain in front, per direction
+        std::vector<float> horizon(bin_count, std::numeric_limits<float>::lowest());
+
+        // swept patches that still reach further than the current one, by their far distance
+        auto further = [&](std::size_t a, std::size_t b) { return far[a] > far[b]; };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(further)> occluders(further);
+
+        auto wrap = [&](int bin) { return ((bin % bin_count) + bin_count) % bin_count; };
+
+        visible.assign(patches.size(), 1);
+        std::size_t hidden_count = 0;
+
+        for (std::size_t index: order) {
+            const horizon_patch &patch = patches[index];
+
+            // every patch completely in front of this one raises the horizon over the directions it covers fully
+            while (!occluders.empty() && far[occluders.top()] <= near[index]) {
+                std::size_t occluder = occluders.top();
+                occluders.pop();
+
+                float first, last;
+                if (!patch_bins(patches[occluder], camera_xz, bin_size, first, last)) continue;
+
+                // the ground under the lowest point of the patch is solid, seen at its flattest elevation
+                float rise = patches[occluder].min_height - camera.y;
+                float elevation = rise / (rise >= 0.0f ? far[occluder] : near[occluder]);
+
+                for (int bin = static_cast<int>(std::ceil(first)); bin + 1 <= static_cast<int>(std::floor(last)); ++bin)
+                    horizon[wrap(bin)] = std::max(horizon[wrap(bin)], elevation);
+            }
+
+            occluders.push(index);
+
+            float first, last;
+            if (!patch_bins(patch, camera_xz, bin_size, first, last)) continue;
+
+            // the highest point of the patch at its steepest elevation
+            float rise = patch.max_height - camera.y;
+            float elevation = rise / (rise >= 0.0f ? near[index] : far[index]);
+
+            bool hidden = true;
+            for (int bin = static_cast<int>(std::floor(first)); bin <= static_cast<int>(std::floor(last)); ++bin) {
+                if (horizon[wrap(bin)] < elevation) {
+                    hidden = false;
+                    break;
+                }
+            }
+
+            if (hidden) {
+                visible[index] = 0;
+                ++hidden_count;
+            }
+        }
+
+        return hidden_count;
+    }
+}
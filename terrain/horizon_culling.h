@@ -0,0 +1,28 @@
+#ifndef INC_3DPERLINMAP_HORIZON_CULLING_H
+#define INC_3DPERLINMAP_HORIZON_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace terrain {
+
+    // a patch of the terrain, its rectangle in the xz plane and the range of its heights in world space
+    struct horizon_patch {
+        glm::vec2 min_corner;
+        glm::vec2 max_corner;
+        float min_height;
+        float max_height;
+    };
+
+    void
+    get_patch_height_bounds(std::vector<float> &min_heights, std::vector<float> &max_heights,
+                            const std::vector<float> &height_map, const int &map_width, const int &map_height,
+                            int patch_numbers);
+
+    std::size_t
+    cull_below_horizon(const std::vector<horizon_patch> &patches, const glm::vec3 &camera,
+                       std::vector<unsigned char> &visible, int bin_count = 2048);
+}
+
+#endif //INC_3DPERLINMAP_HORIZON_CULLING_H
@@ -6,6 +6,7 @@
 #define INC_3DPERLINMAP_MAP_CHUNK_H
 
 #include <vector>
+#include <array>
 #include <iostream>
 
 namespace terrain {
@@ -19,6 +20,30 @@ namespace terrain {
         }
     };
 
+    // tessellated vertices of a chunk recorded with transform feedback, drawn again without tessellating
+    struct terrain_capture {
+        unsigned int vao = 0;
+        unsigned int vbo = 0;
+        // transform feedback object, remembers how many vertices were recorded
+        unsigned int feedback_id = 0;
+        // size of the buffer in vertices
+        std::size_t vertex_capacity = 0;
+
+        // tessellation level of the chunk and of its borders at -x, -z, +x, +z, 0 before the first capture
+        int level = 0;
+        std::array<int, 4> border_levels{};
+        // version of the heights and normals the capture was made with
+        unsigned int version = 0;
+    };
+
+    // sum of the octaves of the height map before it is mapped to 0 to 1, see terrain::update_height_map
+    struct octave_cache {
+        std::vector<double> sums;
+        // octaves in the sums and the perlin scale they were sampled with
+        int layer_count = 0;
+        float scale = 0.0f;
+    };
+
     struct map_chunk {
     public:
         int grid_x;
@@ -26,6 +51,30 @@ namespace terrain {
         std::vector<float> height_data;
         unsigned int height_map_id = 0;
 
+        // slopes in degrees, kept so the splat map can be rebuilt without touching the heights
+        std::vector<float> slope_data;
+        // material layers and blend factor per texel, see terrain::get_splat_map
+        std::vector<unsigned char> splat_data;
+        unsigned int splat_map_id = 0;
+        // version of the splat settings the splat data was built with, only used by the chunk loader
+        unsigned int splat_version = 0;
+        // generation epoch of the noise parameters of the latest heights built for the chunk,
+        // only used by the chunk loader, the main thread swaps the heights in later
+        unsigned int generation_epoch = 0;
+        // texels between the samples of the latest heights built for the chunk, more than 1 for a coarse preview
+        // the chunk loader refines later, see terrain::get_coarse_height_map. only used by the chunk loader
+        int sample_step = 1;
+
+        // lowest and highest height of every patch, see terrain::get_patch_height_bounds
+        std::vector<float> patch_min_heights;
+        std::vector<float> patch_max_heights;
+
+        // only used by the main thread, see terrain::allocate_terrain_capture
+        terrain_capture capture;
+
+        // only used by the chunk loader, empty unless the chunk was regenerated with octave caching
+        octave_cache octaves;
+
         map_chunk(int grid_x, int grid_y)
                 : grid_x(grid_x), grid_y(grid_y) {
         }
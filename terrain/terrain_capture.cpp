@@ -0,0 +1,130 @@
+#include "terrain_capture.h"
+#include "terrain_tool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace terrain {
+
+    /**
+     * tessellation level of a captured chunk by its ring around the chunk of the camera
+     * @param x grid x of the chunk
+     * @param y grid y of the chunk
+     * @param camera_x grid x of the chunk of the camera
+     * @param camera_y grid y of the chunk of the camera
+     * @param settings levels of the captures
+     * @return level of the chunk
+     */
+    int
+    get_capture_level(int x, int y, int camera_x, int camera_y, const capture_settings &settings) {
+        int ring = std::max(std::abs(x - camera_x), std::abs(y - camera_y));
+        return std::max(settings.max_level >> std::min(ring, 16), settings.min_level);
+    }
+
+    /**
+     * a border takes the lower level of the two chunks, both sides then place the same vertices
+     * @return levels of the borders at -x, -z, +x, +z
+     */
+    std::array<int, 4>
+    get_capture_border_levels(int x, int y, int camera_x, int camera_y, const capture_settings &settings) {
+        int level = get_capture_level(x, y, camera_x, camera_y, settings);
+        return {
+                std::min(level, get_capture_level(x - 1, y, camera_x, camera_y, settings)),
+                std::min(level, get_capture_level(x, y - 1, camera_x, camera_y, settings)),
+                std::min(level, get_capture_level(x + 1, y, camera_x, camera_y, settings)),
+                std::min(level, get_capture_level(x, y + 1, camera_x, camera_y, settings))
+        };
+    }
+
+    /**
+     * @param capture capture of a chunk
+     * @param level tessellation level the chunk needs now
+     * @param border_levels border levels the chunk needs now
+     * @param version version of the heights and normals
+     * @return true if the capture was made with the same levels and heights, it does not need to be made again
+     */
+    bool
+    is_capture_current(const terrain_capture &capture, int level, const std::array<int, 4> &border_levels,
+                       unsigned int version) {
+        return capture.level == level && capture.border_levels == border_levels && capture.version == version;
+    }
+
+    /**
+     * set up the capture shader and stop rasterizing, before the first chunk of a pass is captured
+     * @param capture_shader PerlinMap shaders recording the tessellated vertices
+     * @param height_scale
+     */
+    void
+    begin_terrain_capture(utilities::shader &capture_shader, float height_scale) {
+        capture_shader.use_variant({{"CHUNK_LEVELS", "1"}});
+        capture_shader.set_float("HEIGHT_SCALE", height_scale);
+        glEnable(GL_RASTERIZER_DISCARD);
+    }
+
+    /**
+     * tessellate a chunk at fixed levels and record the vertices into its capture, between begin_terrain_capture
+     * and end_terrain_capture
+     * @param chunk chunk with its height map uploaded
+     * @param capture_shader shader set up by begin_terrain_capture
+     * @param patch_vao patches of one chunk, see create_terrain
+     * @param patch_numbers patches per side of a chunk
+     * @param patch_points control points of a patch
+     * @param chunk_size side of a chunk in world units
+     * @param level tessellation level of the chunk
+     * @param border_levels tessellation levels of the borders at -x, -z, +x, +z
+     * @param version version of the heights and normals
+     */
+    void
+    capture_chunk(map_chunk &chunk, utilities::shader &capture_shader, unsigned int patch_vao, int patch_numbers,
+                  int patch_points, float chunk_size, int level, const std::array<int, 4> &border_levels,
+                  unsigned int version) {
+        terrain_capture &capture = chunk.capture;
+        allocate_terrain_capture(capture, get_capture_vertex_count(patch_numbers, level));
+
+        glBindVertexArray(patch_vao);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, chunk.height_map_id);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(chunk.grid_x) * chunk_size, 0,
+                                                                    static_cast<float>(chunk.grid_y) * chunk_size));
+        capture_shader
+                .set_mat4("model", model)
+                .set_float("chunk_level", static_cast<float>(level))
+                .set_vec4("border_levels", glm::vec4(border_levels[0], border_levels[1],
+                                                     border_levels[2], border_levels[3]));
+
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, capture.feedback_id);
+        glBeginTransformFeedback(GL_TRIANGLES);
+        glDrawArrays(GL_PATCHES, 0, static_cast<GLsizei>(patch_points * patch_numbers * patch_numbers));
+        glEndTransformFeedback();
+
+        capture.level = level;
+        capture.border_levels = border_levels;
+        capture.version = version;
+    }
+
+    /**
+     * rasterize again after the last chunk of a pass is captured
+     */
+    void
+    end_terrain_capture() {
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+        glDisable(GL_RASTERIZER_DISCARD);
+    }
+
+    /**
+     * draw the capture of a chunk with the program in use, TerrainReplay.vert
+     * @param chunk captured chunk
+     * @param splat_texture_index texture unit of the splat map
+     */
+    void
+    draw_terrain_capture(const map_chunk &chunk, int splat_texture_index) {
+        glActiveTexture(GL_TEXTURE0 + splat_texture_index);
+        glBindTexture(GL_TEXTURE_2D, chunk.splat_map_id);
+
+        // the vertex count is kept by the transform feedback object
+        glBindVertexArray(chunk.capture.vao);
+        glDrawTransformFeedback(GL_TRIANGLES, chunk.capture.feedback_id);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef INC_3DPERLINMAP_TERRAIN_CAPTURE_H
+#define INC_3DPERLINMAP_TERRAIN_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <array>
+
+#include "map_chunk.h"
+#include "../utilities/shader.h"
+
+// the frame side of the captured terrain: which chunks are tessellated again and how their captures are drawn,
+// the buffers of a capture are managed in terrain_tool.h
+namespace terrain {
+
+    // tessellation levels of the captured chunks, the level is halved for every ring of chunks around the camera
+    struct capture_settings {
+        int max_level = 16;
+        int min_level = 4;
+    };
+
+    int
+    get_capture_level(int x, int y, int camera_x, int camera_y, const capture_settings &settings);
+
+    std::array<int, 4>
+    get_capture_border_levels(int x, int y, int camera_x, int camera_y, const capture_settings &settings);
+
+    bool
+    is_capture_current(const terrain_capture &capture, int level, const std::array<int, 4> &border_levels,
+                       unsigned int version);
+
+    void
+    begin_terrain_capture(utilities::shader &capture_shader, float height_scale);
+
+    void
+    capture_chunk(map_chunk &chunk, utilities::shader &capture_shader, unsigned int patch_vao, int patch_numbers,
+                  int patch_points, float chunk_size, int level, const std::array<int, 4> &border_levels,
+                  unsigned int version);
+
+    void
+    end_terrain_capture();
+
+    void
+    draw_terrain_capture(const map_chunk &chunk, int splat_texture_index);
+}
+
+#endif //INC_3DPERLINMAP_TERRAIN_CAPTURE_H
@@ -0,0 +1,480 @@
+#include "terrain_generator.h"
+#include "horizon_culling.h"
+#include "../utilities/cpu_trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace terrain {
+
+    /**
+     * Generate the vertices of the panel tessellated by patch numbers
+     * @param map_width width of height map
+     * @param map_height height of height map
+     * @param patch_numbers patch numbers
+     * @param vertices target vector
+     */
+    void
+    generate_terrain_vertices(const int map_width, const int map_height,
+                              const int patch_numbers, std::vector<float> &vertices, float u_offset, float v_offset) {
+
+        auto map_width_f = static_cast<float>(map_width);
+        auto map_height_f = static_cast<float>(map_height);
+
+        // compute the coordinates of every corner of each panel
+
+        // compute the reciprocal once to minimize performance impact
+        const float patch_reciprocal = 1.0f / static_cast<float>(patch_numbers);
+
+        // divide the width and height
+        float width_offset_factor = static_cast<float>(map_width) * patch_reciprocal;
+        float height_offset_factor = static_cast<float>(map_height) * patch_reciprocal;
+
+        float u_offset_factor = static_cast<float>(map_width) / static_cast<float>((map_width + 2) * patch_numbers);
+        float v_offset_factor = static_cast<float>(map_height) / static_cast<float>((map_height + 2) * patch_numbers);
+
+        for (auto i = 0; i <= patch_numbers - 1; ++i) {
+            auto x = static_cast<float>(i);
+
+            for (auto j = 0; j <= patch_numbers - 1; ++j) {
+
+                auto z = static_cast<float>(j);
+
+                // coordinates of the left lower corner of the panel
+                vertices.push_back(-map_width_f * 0.5f + x * width_offset_factor);
+                vertices.push_back(0.0f);
+                vertices.push_back(-map_height_f * 0.5f + z * height_offset_factor);
+                vertices.push_back(x * u_offset_factor + u_offset);
+                vertices.push_back(z * v_offset_factor + v_offset);
+                vertices.push_back(x * patch_reciprocal);
+                vertices.push_back(z * patch_reciprocal);
+
+                // coordinates of the right lower corner of the panel
+                vertices.push_back(-map_width_f * 0.5f + (x + 1) * width_offset_factor);
+                vertices.push_back(0.0f);
+                vertices.push_back(-map_height_f * 0.5f + z * height_offset_factor);
+                vertices.push_back((x + 1) * u_offset_factor + u_offset);
+                vertices.push_back(z * v_offset_factor + v_offset);
+                vertices.push_back((x + 1) * patch_reciprocal);
+                vertices.push_back(z * patch_reciprocal);
+
+                // coordinates of the left upper corner of the panel
+                vertices.push_back(-map_width_f * 0.5f + x * width_offset_factor);
+                vertices.push_back(0.0f);
+                vertices.push_back(-map_height_f * 0.5f + (z + 1) * height_offset_factor);
+                vertices.push_back(x * u_offset_factor + u_offset);
+                vertices.push_back((z + 1) * v_offset_factor + v_offset);
+                vertices.push_back(x * patch_reciprocal);
+                vertices.push_back((z + 1) * patch_reciprocal);
+
+                // coordinates of the right upper corner of the panel
+                vertices.push_back(-map_width_f * 0.5f + (x + 1) * width_offset_factor);
+                vertices.push_back(0.0f);
+                vertices.push_back(-map_height_f * 0.5f + (z + 1) * height_offset_factor);
+                vertices.push_back((x + 1) * u_offset_factor + u_offset);
+                vertices.push_back((z + 1) * v_offset_factor + v_offset);
+                vertices.push_back((x + 1) * patch_reciprocal);
+                vertices.push_back((z + 1) * patch_reciprocal);
+            }
+        }
+    }
+
+    /**
+     * Generate perlin noise map
+     * @param height_map target height map
+     * @param perlin perlin instance
+     * @param map_width width of height map
+     * @param map_height height of height map
+     * @param scale used to scale sample point
+     * @param layer_count layer counts
+     * @param lacunarity used to affect the whole sample point
+     * @param layer_lacunarity used to affect the lacunarity per layer
+     * @param layer_amplitude used to affect the amplitude per layer
+     * @param x_offset x sample offset
+     * @param y_offset y sample offset
+     */
+    void
+    get_height_map(std::vector<float> &height_map, const siv::PerlinNoise &perlin, const int &map_width,
+                   const int &map_height, float scale, int layer_count, float lacunarity, float layer_lacunarity,
+                   float layer_amplitude,
+                   float x_offset, float y_offset) {
+
+        float max_possible_height = 0.0f;
+        float amplitude = 1.0f;
+
+        for (int i = 0; i < layer_count; ++i) {
+            // accumulate height value layer by layer
+            max_possible_height += amplitude;
+            // decrease the height layer by layer
+            amplitude *= layer_amplitude;
+        }
+
+        float x_perlin_offset = x_offset * static_cast<float>(map_width - 2);
+        float y_perlin_offset = y_offset * static_cast<float>(map_height - 2);
+
+        for (int x = 0; x < map_width; ++x) {
+            for (int y = 0; y < map_height; ++y) {
+                float current_pixel_height = 0.0f;
+
+                float current_layer_lacunarity = 1.0f;
+                float current_layer_amplitude = 1.0f;
+
+                float sample_x =
+                        (static_cast<float>(x) + x_perlin_offset) * scale;
+                float sample_y =
+                        (static_cast<float>(y) + y_perlin_offset) * scale;
+
+                for (int i = 0; i < layer_count; ++i) {
+                    sample_x *= current_layer_lacunarity;
+                    sample_y *= current_layer_lacunarity;
+
+                    // sample perlin
+                    current_pixel_height += static_cast<float>(perlin.noise2D_01(sample_x, sample_y) *
+                                                               current_layer_amplitude);
+                    current_layer_lacunarity *= layer_lacunarity;
+                    current_layer_amplitude *= layer_amplitude;
+                }
+
+                current_pixel_height /= max_possible_height;
+                height_map[x + y * map_height] = current_pixel_height;
+            }
+        }
+    }
+
+    /**
+     * Generate perlin noise map by octave function
+     * @param height_map target height map
+     * @param perlin perlin instance
+     * @param map_width width of height map
+     * @param map_height height of height map
+     * @param scale used to scale sample point
+     * @param layer_count layer counts
+     * @param x_offset x sample offset
+     * @param y_offset y sample offset
+     * @param cancelled asked once per column, the height map is left incomplete when it returns true
+     * @return false when cancelled
+     */
+    bool
+    get_height_map(std::vector<float> &height_map, const siv::PerlinNoise &perlin, const int &map_width,
+                   const int &map_height, float scale, int layer_count, float x_offset, float y_offset,
+                   const std::function<bool()> &cancelled) {
+        TRACE_SCOPE("get_height_map");
+
+        float x_perlin_offset = x_offset * static_cast<float>(map_width - 2);
+        float y_perlin_offset = y_offset * static_cast<float>(map_height - 2);
+
+        for (int x = 0; x < map_width; ++x) {
+            if (cancelled && cancelled()) return false;
+
+            for (int y = 0; y < map_height; ++y) {
+
+                float sample_x =
+                        (static_cast<float>(x) + x_perlin_offset) * scale;
+                float sample_y =
+                        (static_cast<float>(y) + y_perlin_offset) * scale;
+
+                // sample perlin
+                auto current_pixel_height = static_cast<float>(perlin.octave2D_01(sample_x, sample_y, layer_count));
+
+                height_map[x + y * map_height] = current_pixel_height;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Generate perlin noise map by octave function like the other get_height_map, keeping the sum of the octaves
+     * so that the next call with another layer count only adds or subtracts the octaves in between.
+     * Adding octaves gives the same heights as get_height_map, subtracting them may differ in the last bits
+     * @param height_map target height map
+     * @param cache octave sums of the chunk, rebuilt when it is empty or the scale changed
+     * @param perlin perlin instance
+     * @param map_width width of height map
+     * @param map_height height of height map
+     * @param scale used to scale sample point
+     * @param layer_count layer counts
+     * @param x_offset x sample offset
+     * @param y_offset y sample offset
+     * @param cancelled asked once per column, the cache is emptied when it returns true
+     * @return octaves computed per texel, -1 when cancelled
+     */
+    int
+    update_height_map(std::vector<float> &height_map, octave_cache &cache, const siv::PerlinNoise &perlin,
+                      const int &map_width, const int &map_height, float scale, int layer_count,
+                      float x_offset, float y_offset, const std::function<bool()> &cancelled) {
+        TRACE_SCOPE("update_height_map");
+
+        if (cache.sums.size() != static_cast<std::size_t>(map_width) * map_height || cache.scale != scale) {
+            cache.sums.assign(static_cast<std::size_t>(map_width) * map_height, 0.0);
+            cache.layer_count = 0;
+            cache.scale = scale;
+        }
+
+        // octaves from first to last are added, or subtracted when there are fewer now
+        int first = std::min(cache.layer_count, layer_count);
+        int last = std::max(cache.layer_count, layer_count);
+        double sign = layer_count > cache.layer_count ? 1.0 : -1.0;
+
+        float x_perlin_offset = x_offset * static_cast<float>(map_width - 2);
+        float y_perlin_offset = y_offset * static_cast<float>(map_height - 2);
+
+        for (int x = 0; x < map_width; ++x) {
+            // the sums of the columns done so far hold other octaves than the rest
+            if (cancelled && cancelled()) {
+                cache = octave_cache();
+                return -1;
+            }
+
+            for (int y = 0; y < map_height; ++y) {
+
+                float sample_x =
+                        (static_cast<float>(x) + x_perlin_offset) * scale;
+                float sample_y =
+                        (static_cast<float>(y) + y_perlin_offset) * scale;
+
+                // the frequency doubles and the amplitude halves per octave like in octave2D, both are exact
+                double &sum = cache.sums[x + y * map_height];
+                for (int i = first; i < last; ++i)
+                    sum += sign * perlin.noise2D(std::ldexp(static_cast<double>(sample_x), i),
+                                                 std::ldexp(static_cast<double>(sample_y), i)) * std::ldexp(1.0, -i);
+
+                // mapped to 0 to 1 like octave2D_01
+                double height = sum <= -1.0 ? 0.0 : sum >= 1.0 ? 1.0 : sum * 0.5 + 0.5;
+                height_map[x + y * map_height] = static_cast<float>(height);
+            }
+        }
+
+        cache.layer_count = layer_count;
+        return last - first;
+    }
+
+    /**
+     * Cheap preview of the octave height map: only every step-th texel is sampled, with the octaves that are still
+     * coarser than the sample spacing, the texels in between are interpolated bilinearly.
+     * The last row and column are always sampled so that the borders shared with the neighbours stay close
+     * @param height_map target height map
+     * @param perlin perlin instance
+     * @param map_width width of height map
+     * @param map_height height of height map
+     * @param scale used to scale sample point
+     * @param layer_count layer counts of the full height map
+     * @param step texels between two samples
+     * @param x_offset x sample offset
+     * @param y_offset y sample offset
+     * @return octaves sampled
+     */
+    int
+    get_coarse_height_map(std::vector<float> &height_map, const siv::PerlinNoise &perlin, const int &map_width,
+                          const int &map_height, float scale, int layer_count, int step, float x_offset,
+                          float y_offset) {
+        TRACE_SCOPE("get_coarse_height_map");
+
+        // an octave finer than two samples would only alias
+        int octaves = 1;
+        while (octaves < layer_count && std::ldexp(scale, octaves) * static_cast<float>(step) <= 0.5f)
+            ++octaves;
+
+        float x_perlin_offset = x_offset * static_cast<float>(map_width - 2);
+        float y_perlin_offset = y_offset * static_cast<float>(map_height - 2);
+
+        // every step-th texel and the last one
+        int samples = (map_width - 2) / step + 2;
+
+        std::vector<float> coarse(static_cast<std::size_t>(samples) * samples);
+        for (int i = 0; i < samples; ++i) {
+            for (int j = 0; j < samples; ++j) {
+                float sample_x = (static_cast<float>(std::min(i * step, map_width - 1)) + x_perlin_offset) * scale;
+                float sample_y = (static_cast<float>(std::min(j * step, map_height - 1)) + y_perlin_offset) * scale;
+                coarse[i + j * samples] = static_cast<float>(perlin.octave2D_01(sample_x, sample_y, octaves));
+            }
+        }
+
+        for (int x = 0; x < map_width; ++x) {
+            int x0 = x / step;
+            int x1 = std::min(x0 + 1, samples - 1);
+            int x_span = std::min(x1 * step, map_width - 1) - x0 * step;
+            float u = x_span > 0 ? static_cast<float>(x - x0 * step) / static_cast<float>(x_span) : 0.0f;
+
+            for (int y = 0; y < map_height; ++y) {
+                int y0 = y / step;
+                int y1 = std::min(y0 + 1, samples - 1);
+                int y_span = std::min(y1 * step, map_height - 1) - y0 * step;
+                float v = y_span > 0 ? static_cast<float>(y - y0 * step) / static_cast<float>(y_span) : 0.0f;
+
+                float top = std::lerp(coarse[x0 + y0 * samples], coarse[x1 + y0 * samples], u);
+                float bottom = std::lerp(coarse[x0 + y1 * samples], coarse[x1 + y1 * samples], u);
+                height_map[x + y * map_height] = std::lerp(top, bottom, v);
+            }
+        }
+        return octaves;
+    }
+
+    /**
+     * Slope of every texel of a height map, from the height differences to its neighbours.
+     * One texel is one unit of the world.
+     * @param slope_map target slope map, angle to the horizontal plane in degrees
+     * @param height_map height map with values from 0 to 1
+     * @param map_width width of height map
+     * @param map_height height of height map
+     * @param height_scale world height of a height value of 1
+     */
+    void
+    get_slope_map(std::vector<float> &slope_map, const std::vector<float> &height_map, const int &map_width,
+                  const int &map_height, float height_scale) {
+        TRACE_SCOPE("get_slope_map");
+        slope_map.resize(height_map.size());
+
+        for (int y = 0; y < map_height; ++y) {
+            int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, map_height - 1);
+
+            for (int x = 0; x < map_width; ++x) {
+                int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, map_width - 1);
+
+                // central differences, one sided at the borders
+                float dx = (height_map[x1 + y * map_width] - height_map[x0 + y * map_width]) * height_scale /
+                           static_cast<float>(x1 - x0);
+                float dy = (height_map[x + y1 * map_width] - height_map[x + y0 * map_width]) * height_scale /
+                           static_cast<float>(y1 - y0);
+
+                slope_map[x + y * map_width] = std::atan(std::sqrt(dx * dx + dy * dy)) * 57.29578f;
+            }
+        }
+    }
+
+    /**
+     * Choose the two material layers and their blend factor for every texel of a height map,
+     * the shaders fetch them with one lookup instead of searching the height bands.
+     * Only the heights and slopes are read, so the splat map can be rebuilt cheaply when the bands change.
+     * @param splat_map target splat map, rgba8 per texel: first layer, second layer, blend factor towards
+     * the second layer and the slope
+     * @param height_map height map with values from 0 to 1
+     * @param slope_map slopes in degrees from get_slope_map
+     * @param map_width width of height map
+     * @param map_height height of height map
+     * @param settings height bands and slope layer
+     */
+    void
+    get_splat_map(std::vector<unsigned char> &splat_map, const std::vector<float> &height_map,
+                  const std::vector<float> &slope_map, const int &map_width, const int &map_height,
+                  const splat_settings &settings) {
+        TRACE_SCOPE("get_splat_map");
+        const std::vector<float> &bands = settings.height_bands;
+        if (bands.size() < 2)
+            throw std::runtime_error("splat map needs at least one height band");
+
+        int layer_count = static_cast<int>(bands.size()) - 1;
+        bool use_slope = settings.slope_layer >= 0 && settings.slope_layer < layer_count;
+        float slope_range = std::max(settings.slope_end - settings.slope_start, 1e-3f);
+
+        splat_map.resize(static_cast<std::size_t>(map_width) * map_height * 4);
+
+        for (std::size_t i = 0; i < static_cast<std::size_t>(map_width) * map_height; ++i) {
+            float height = height_map[i];
+
+            // the first band above the height is the upper layer, the one below it the lower layer
+            auto band = std::upper_bound(bands.begin(), bands.end(), height);
+            int upper = band == bands.end() ? layer_count - 1 :
+                        std::clamp(static_cast<int>(band - bands.begin()), 0, layer_count - 1);
+            int lower = std::clamp(upper - 1, 0, layer_count - 1);
+
+            // smoothstep between the two bands
+            float blend = 1.0f;
+            if (bands[upper] > bands[lower]) {
+                blend = std::clamp((height - bands[lower]) / (bands[upper] - bands[lower]), 0.0f, 1.0f);
+                blend = blend * blend * (3.0f - 2.0f * blend);
+            }
+
+            int first = lower, second = upper;
+            if (use_slope) {
+                float slope = std::clamp((slope_map[i] - settings.slope_start) / slope_range, 0.0f, 1.0f);
+                slope = slope * slope * (3.0f - 2.0f * slope);
+
+                // weights of the three candidates, only the two heaviest layers are kept
+                float weights[3] = {(1.0f - blend) * (1.0f - slope), blend * (1.0f - slope), slope};
+                int layers[3] = {lower, upper, settings.slope_layer};
+
+                // the slope layer can be one of the height layers
+                for (int l = 0; l < 2; ++l) {
+                    if (layers[l] == layers[2]) {
+                        weights[2] += weights[l];
+                        weights[l] = 0.0f;
+                    }
+                }
+
+                int dropped = static_cast<int>(std::min_element(weights, weights + 3) - weights);
+                int kept[2], k = 0;
+                for (int l = 0; l < 3; ++l)
+                    if (l != dropped) kept[k++] = l;
+
+                first = layers[kept[0]];
+                second = layers[kept[1]];
+                float weight_sum = weights[kept[0]] + weights[kept[1]];
+                blend = weight_sum > 0.0f ? weights[kept[1]] / weight_sum : 0.0f;
+            }
+
+            splat_map[i * 4] = static_cast<unsigned char>(first);
+            splat_map[i * 4 + 1] = static_cast<unsigned char>(second);
+            splat_map[i * 4 + 2] = static_cast<unsigned char>(blend * 255.0f + 0.5f);
+            splat_map[i * 4 + 3] = static_cast<unsigned char>(std::clamp(slope_map[i] / 90.0f, 0.0f, 1.0f) * 255.0f);
+        }
+    }
+
+    /**
+     * Everything the chunk loader builds for a chunk on the cpu: heights, slopes, patch height bounds and splat map
+     * @param grid_x grid coordinate of the chunk
+     * @param grid_y grid coordinate of the chunk
+     * @param parameters noise parameters, only scale and layer_count shape the heights
+     * @param texture_width width of the height map, one texel more on every side than the chunk
+     * @param texture_height height of the height map
+     * @param terrain_height height of the terrain in world space, for the slopes
+     * @param patch_numbers patches per side of the chunk
+     * @param settings splat settings
+     * @param splat_version version of the splat settings
+     * @param sample_step 1 for the full heights, more for a quick preview, see get_coarse_height_map
+     * @return the chunk without any gl objects
+     */
+    map_chunk
+    generate_chunk(int grid_x, int grid_y, const generation_parameters &parameters, int texture_width,
+                   int texture_height, float terrain_height, int patch_numbers, const splat_settings &settings,
+                   unsigned int splat_version, int sample_step) {
+        TRACE_SCOPE("generate chunk");
+
+        std::vector<float> height_data(static_cast<std::size_t>(texture_width) * texture_height);
+        if (sample_step > 1)
+            get_coarse_height_map(height_data, parameters.perlin, texture_width, texture_height, parameters.scale,
+                                  parameters.layer_count, sample_step, static_cast<float>(grid_x),
+                                  static_cast<float>(grid_y));
+        else
+            get_height_map(height_data, parameters.perlin, texture_width, texture_height, parameters.scale,
+                           parameters.layer_count, static_cast<float>(grid_x), static_cast<float>(grid_y));
+
+        map_chunk chunk(grid_x, grid_y, std::move(height_data));
+        get_slope_map(chunk.slope_data, chunk.height_data, texture_width, texture_height, terrain_height);
+        get_patch_height_bounds(chunk.patch_min_heights, chunk.patch_max_heights,
+                                chunk.height_data, texture_width, texture_height, patch_numbers);
+        get_splat_map(chunk.splat_data, chunk.height_data, chunk.slope_data,
+                      texture_width, texture_height, settings);
+        chunk.splat_version = splat_version;
+        return chunk;
+    }
+
+    float
+    get_sign(float value) {
+        return static_cast<float>((value > 0.0f)) - static_cast<float>(value < 0.0f);
+    }
+
+    /**
+     * most vertices the tessellation of a chunk can produce, the plane is drawn as triangles
+     * @param patch_numbers patches per side of the chunk
+     * @param tess_level highest tessellation level of the chunk
+     * @return vertex count
+     */
+    std::size_t
+    get_capture_vertex_count(int patch_numbers, int tess_level) {
+        // fractional odd spacing rounds the level up to the next odd number of segments
+        std::size_t segments = tess_level % 2 == 0 ? tess_level + 1 : tess_level;
+        // a quad patch with all levels equal is a grid of two triangles per segment square,
+        // lower outer levels only remove triangles
+        return static_cast<std::size_t>(patch_numbers) * patch_numbers * segments * segments * 2 * 3;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef INC_3DPERLINMAP_TERRAIN_GENERATOR_H
+#define INC_3DPERLINMAP_TERRAIN_GENERATOR_H
+
+#include <PerlinNoise.hpp>
+
+#include "map_chunk.h"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// generation of the terrain on the cpu, part of the terrain_core library which has no gl dependency.
+// terrain_tool.h uploads the results
+namespace terrain {
+
+    // how the material layers are chosen for the splat map
+    struct splat_settings {
+        // height range of the layers from 0 to 1, one more entry than there are layers
+        std::vector<float> height_bands;
+        // layer blended in on steep ground, -1 for none
+        int slope_layer = -1;
+        // slope in degrees where the slope layer starts and where it covers the ground completely
+        float slope_start = 40.0f;
+        float slope_end = 55.0f;
+    };
+
+    // noise parameters of one generation of the map. never changed after it is handed to the chunk loader, new
+    // parameters are a new instance, so a job reads all of them from the same generation
+    struct generation_parameters {
+        siv::PerlinNoise::seed_type seed = 7961148u;
+        float scale = 0.004f;
+        int layer_count = 10;
+        // parameters of the layered get_height_map. the chunk loader generates with the octave function and does
+        // not apply them yet, see update_height_map
+        float lacunarity = 1.8f;
+        float layer_lacunarity = 0.6f;
+        float layer_amplitude = 0.5f;
+        // counts the parameters published so far, chunks are tagged with it
+        unsigned int epoch = 0;
+        // seeded with seed
+        siv::PerlinNoise perlin;
+    };
+
+    void
+    generate_terrain_vertices(int map_width, int map_height, int patch_numbers, std::vector<float> &vertices,
+                              float u_offset = 0, float v_offset = 0);
+
+    void
+    get_height_map(std::vector<float> &height_map, const siv::PerlinNoise &perlin, const int &map_width,
+                   const int &map_height, float scale, int layer_count, float lacunarity, float layer_lacunarity,
+                   float layer_amplitude,
+                   float x_offset, float y_offset);
+
+    bool
+    get_height_map(std::vector<float> &height_map, const siv::PerlinNoise &perlin, const int &map_width,
+                   const int &map_height, float scale, int layer_count, float x_offset, float y_offset,
+                   const std::function<bool()> &cancelled = nullptr);
+
+    int
+    update_height_map(std::vector<float> &height_map, octave_cache &cache, const siv::PerlinNoise &perlin,
+                      const int &map_width, const int &map_height, float scale, int layer_count,
+                      float x_offset, float y_offset, const std::function<bool()> &cancelled = nullptr);
+
+    int
+    get_coarse_height_map(std::vector<float> &height_map, const siv::PerlinNoise &perlin, const int &map_width,
+                          const int &map_height, float scale, int layer_count, int step, float x_offset,
+                          float y_offset);
+
+    void
+    get_slope_map(std::vector<float> &slope_map, const std::vector<float> &height_map, const int &map_width,
+                  const int &map_height, float height_scale);
+
+    void
+    get_splat_map(std::vector<unsigned char> &splat_map, const std::vector<float> &height_map,
+                  const std::vector<float> &slope_map, const int &map_width, const int &map_height,
+                  const splat_settings &settings);
+
+    map_chunk
+    generate_chunk(int grid_x, int grid_y, const generation_parameters &parameters, int texture_width,
+                   int texture_height, float terrain_height, int patch_numbers, const splat_settings &settings,
+                   unsigned int splat_version, int sample_step = 1);
+
+    std::size_t
+    get_capture_vertex_count(int patch_numbers, int tess_level);
+
+    float
+    get_sign(float value);
+}
+
+#endif //INC_3DPERLINMAP_TERRAIN_GENERATOR_H
@@ -3,81 +3,10 @@
 //
 
 #include "terrain_tool.h"
+#include "../utilities/cpu_trace.h"
 
 namespace terrain {
 
-    /**
-     * Generate the vertices of the panel tessellated by patch numbers
-     * @param map_width width of height map
-     * @param map_height height of height map
-     * @param patch_numbers patch numbers
-     * @param vertices target vector
-     */
-    void
-    generate_terrain_vertices(const int map_width, const int map_height,
-                              const int patch_numbers, std::vector<float> &vertices, float u_offset, float v_offset) {
-
-        auto map_width_f = static_cast<float>(map_width);
-        auto map_height_f = static_cast<float>(map_height);
-
-        // compute the coordinates of every corner of each panel
-
-        // compute the reciprocal once to minimize performance impact
-        const float patch_reciprocal = 1.0f / static_cast<float>(patch_numbers);
-
-        // divide the width and height
-        float width_offset_factor = static_cast<float>(map_width) * patch_reciprocal;
-        float height_offset_factor = static_cast<float>(map_height) * patch_reciprocal;
-
-        float u_offset_factor = static_cast<float>(map_width) / static_cast<float>((map_width + 2) * patch_numbers);
-        float v_offset_factor = static_cast<float>(map_height) / static_cast<float>((map_height + 2) * patch_numbers);
-
-        for (auto i = 0; i <= patch_numbers - 1; ++i) {
-            auto x = static_cast<float>(i);
-
-            for (auto j = 0; j <= patch_numbers - 1; ++j) {
-
-                auto z = static_cast<float>(j);
-
-                // coordinates of the left lower corner of the panel
-                vertices.push_back(-map_width_f * 0.5f + x * width_offset_factor);
-                vertices.push_back(0.0f);
-                vertices.push_back(-map_height_f * 0.5f + z * height_offset_factor);
-                vertices.push_back(x * u_offset_factor + u_offset);
-                vertices.push_back(z * v_offset_factor + v_offset);
-                vertices.push_back(x * patch_reciprocal);
-                vertices.push_back(z * patch_reciprocal);
-
-                // coordinates of the right lower corner of the panel
-                vertices.push_back(-map_width_f * 0.5f + (x + 1) * width_offset_factor);
-                vertices.push_back(0.0f);
-                vertices.push_back(-map_height_f * 0.5f + z * height_offset_factor);
-                vertices.push_back((x + 1) * u_offset_factor + u_offset);
-                vertices.push_back(z * v_offset_factor + v_offset);
-                vertices.push_back((x + 1) * patch_reciprocal);
-                vertices.push_back(z * patch_reciprocal);
-
-                // coordinates of the left upper corner of the panel
-                vertices.push_back(-map_width_f * 0.5f + x * width_offset_factor);
-                vertices.push_back(0.0f);
-                vertices.push_back(-map_height_f * 0.5f + (z + 1) * height_offset_factor);
-                vertices.push_back(x * u_offset_factor + u_offset);
-                vertices.push_back((z + 1) * v_offset_factor + v_offset);
-                vertices.push_back(x * patch_reciprocal);
-                vertices.push_back((z + 1) * patch_reciprocal);
-
-                // coordinates of the right upper corner of the panel
-                vertices.push_back(-map_width_f * 0.5f + (x + 1) * width_offset_factor);
-                vertices.push_back(0.0f);
-                vertices.push_back(-map_height_f * 0.5f + (z + 1) * height_offset_factor);
-                vertices.push_back((x + 1) * u_offset_factor + u_offset);
-                vertices.push_back((z + 1) * v_offset_factor + v_offset);
-                vertices.push_back((x + 1) * patch_reciprocal);
-                vertices.push_back((z + 1) * patch_reciprocal);
-            }
-        }
-    }
-
     /**
      * load height data from height map as a texture
      * @param map_width
@@ -87,6 +16,7 @@ namespace terrain {
      */
     unsigned int
     load_height_map(const int &map_width, const int &map_height, std::vector<float> &height_data) {
+        TRACE_SCOPE("load_height_map");
         unsigned int texture_id = 0;
         glGenTextures(1, &texture_id);
         glBindTexture(GL_TEXTURE_2D, texture_id);
@@ -110,106 +40,64 @@ namespace terrain {
         return texture_id;
     }
 
-
     /**
-     * Generate perlin noise map
-     * @param height_map target height map
-     * @param perlin perlin instance
-     * @param map_width width of height map
-     * @param map_height height of height map
-     * @param scale used to scale sample point
-     * @param layer_count layer counts
-     * @param lacunarity used to affect the whole sample point
-     * @param layer_lacunarity used to affect the lacunarity per layer
-     * @param layer_amplitude used to affect the amplitude per layer
-     * @param x_offset x sample offset
-     * @param y_offset y sample offset
+     * replace the heights of a texture from load_height_map, the old ones are drawn until the call
+     * @param texture_id texture from load_height_map
+     * @param map_width
+     * @param map_height
+     * @param height_data noise height map data of the same size
      */
     void
-    get_height_map(std::vector<float> &height_map, siv::PerlinNoise &perlin, const int &map_width,
-                   const int &map_height, float scale, int layer_count, float lacunarity, float layer_lacunarity,
-                   float layer_amplitude,
-                   float x_offset, float y_offset) {
-
-        float max_possible_height = 0.0f;
-        float amplitude = 1.0f;
-
-        for (int i = 0; i < layer_count; ++i) {
-            // accumulate height value layer by layer
-            max_possible_height += amplitude;
-            // decrease the height layer by layer
-            amplitude *= layer_amplitude;
-        }
-
-        float x_perlin_offset = x_offset * static_cast<float>(map_width - 2);
-        float y_perlin_offset = y_offset * static_cast<float>(map_height - 2);
-
-        for (int x = 0; x < map_width; ++x) {
-            for (int y = 0; y < map_height; ++y) {
-                float current_pixel_height = 0.0f;
+    reload_height_map(unsigned int texture_id, const int &map_width, const int &map_height,
+                      const std::vector<float> &height_data) {
+        TRACE_SCOPE("reload_height_map");
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, map_width, map_height, GL_RED, GL_FLOAT, height_data.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
 
-                float current_layer_lacunarity = 1.0f;
-                float current_layer_amplitude = 1.0f;
 
-                float sample_x =
-                        (static_cast<float>(x) + x_perlin_offset) * scale;
-                float sample_y =
-                        (static_cast<float>(y) + y_perlin_offset) * scale;
+    /**
+     * load the splat map of a chunk as a texture, layer indices must not be interpolated so it is never filtered
+     * @param map_width
+     * @param map_height
+     * @param splat_data splat map from get_splat_map
+     * @return texture id
+     */
+    unsigned int
+    load_splat_map(const int &map_width, const int &map_height, std::vector<unsigned char> &splat_data) {
+        unsigned int texture_id = 0;
+        glGenTextures(1, &texture_id);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
 
-                for (int i = 0; i < layer_count; ++i) {
-                    sample_x *= current_layer_lacunarity;
-                    sample_y *= current_layer_lacunarity;
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, map_width, map_height);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, map_width, map_height, GL_RGBA, GL_UNSIGNED_BYTE, splat_data.data());
 
-                    // sample perlin
-                    current_pixel_height += static_cast<float>(perlin.noise2D_01(sample_x, sample_y) *
-                                                               current_layer_amplitude);
-                    current_layer_lacunarity *= layer_lacunarity;
-                    current_layer_amplitude *= layer_amplitude;
-                }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-                current_pixel_height /= max_possible_height;
-                height_map[x + y * map_height] = current_pixel_height;
-            }
-        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture_id;
     }
 
     /**
-     * Generate perlin noise map by octave function
-     * @param height_map target height map
-     * @param perlin perlin instance
-     * @param map_width width of height map
-     * @param map_height height of height map
-     * @param scale used to scale sample point
-     * @param layer_count layer counts
-     * @param x_offset x sample offset
-     * @param y_offset y sample offset
+     * replace the texels of a splat map after a rebuild
+     * @param texture_id texture from load_splat_map
+     * @param map_width
+     * @param map_height
+     * @param splat_data splat map from get_splat_map
      */
     void
-    get_height_map(std::vector<float> &height_map, siv::PerlinNoise &perlin, const int &map_width,
-                   const int &map_height, float scale, int layer_count, float x_offset, float y_offset) {
-
-        float x_perlin_offset = x_offset * static_cast<float>(map_width - 2);
-        float y_perlin_offset = y_offset * static_cast<float>(map_height - 2);
-
-        for (int x = 0; x < map_width; ++x) {
-            for (int y = 0; y < map_height; ++y) {
-
-                float sample_x =
-                        (static_cast<float>(x) + x_perlin_offset) * scale;
-                float sample_y =
-                        (static_cast<float>(y) + y_perlin_offset) * scale;
-
-                // sample perlin
-                auto current_pixel_height = static_cast<float>(perlin.octave2D_01(sample_x, sample_y, layer_count));
-
-                height_map[x + y * map_height] = current_pixel_height;
-            }
-        }
-    }
-
-    float
-    get_sign(float value) {
-        return static_cast<float>((value > 0.0f)) - static_cast<float>(value < 0.0f);
+    update_splat_map(unsigned int texture_id, const int &map_width, const int &map_height,
+                     const std::vector<unsigned char> &splat_data) {
+        TRACE_SCOPE("update_splat_map");
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, map_width, map_height, GL_RGBA, GL_UNSIGNED_BYTE, splat_data.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
     }
 
     /**
@@ -247,4 +135,65 @@ namespace terrain {
 
         return {terrain_vao, terrain_vbo};
     }
+
+    /**
+     * create the buffers of a capture the first time, and resize the vertex buffer to hold vertex_count vertices.
+     * a vertex is the frag_pos, w_normal, height_coord and tex_coord of PerlinMap.tese, 10 floats
+     * @param capture capture of a chunk
+     * @param vertex_count vertices to hold, from get_capture_vertex_count
+     */
+    void
+    allocate_terrain_capture(terrain_capture &capture, std::size_t vertex_count) {
+        const GLsizei stride = 10 * sizeof(float);
+
+        if (capture.vao == 0) {
+            glGenVertexArrays(1, &capture.vao);
+            glGenBuffers(1, &capture.vbo);
+            glGenTransformFeedbacks(1, &capture.feedback_id);
+
+            glBindVertexArray(capture.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, capture.vbo);
+
+            // position attribute
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+            glEnableVertexAttribArray(0);
+            // normal attribute
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *) (sizeof(float) * 3));
+            glEnableVertexAttribArray(1);
+            // height texCoord attribute
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *) (sizeof(float) * 6));
+            glEnableVertexAttribArray(2);
+            // texture texCoord attribute
+            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void *) (sizeof(float) * 8));
+            glEnableVertexAttribArray(3);
+
+            glBindVertexArray(0);
+
+            glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, capture.feedback_id);
+            glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, capture.vbo);
+            glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+        }
+
+        if (capture.vertex_capacity != vertex_count) {
+            glBindBuffer(GL_ARRAY_BUFFER, capture.vbo);
+            // written and read by the gpu only
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertex_count * stride), nullptr, GL_STATIC_COPY);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            capture.vertex_capacity = vertex_count;
+        }
+    }
+
+    /**
+     * delete the buffers of a capture, the chunk is tessellated again when it is captured next time
+     * @param capture capture of a chunk
+     */
+    void
+    delete_terrain_capture(terrain_capture &capture) {
+        if (capture.vao == 0) return;
+
+        glDeleteVertexArrays(1, &capture.vao);
+        glDeleteBuffers(1, &capture.vbo);
+        glDeleteTransformFeedbacks(1, &capture.feedback_id);
+        capture = terrain_capture();
+    }
 }
\ No newline at end of file
@@ -17,29 +17,34 @@
 #include <tuple>
 #include <unordered_map>
 
+#include "map_chunk.h"
+#include "terrain_generator.h"
+
+// the gl side of the terrain, uploads what terrain_generator.h builds on the cpu
 namespace terrain {
-    void
-    generate_terrain_vertices(int map_width, int map_height, int patch_numbers, std::vector<float> &vertices,
-                              float u_offset = 0, float v_offset = 0);
 
     unsigned int
     load_height_map(const int &map_width, const int &map_height, std::vector<float> &height_data);
 
     void
-    get_height_map(std::vector<float> &height_map, siv::PerlinNoise &perlin, const int &map_width,
-                   const int &map_height, float scale, int layer_count, float lacunarity, float layer_lacunarity,
-                   float layer_amplitude,
-                   float x_offset, float y_offset);
+    reload_height_map(unsigned int texture_id, const int &map_width, const int &map_height,
+                      const std::vector<float> &height_data);
+
+    unsigned int
+    load_splat_map(const int &map_width, const int &map_height, std::vector<unsigned char> &splat_data);
 
     void
-    get_height_map(std::vector<float> &height_map, siv::PerlinNoise &perlin, const int &map_width,
-                   const int &map_height, float scale, int layer_count, float x_offset, float y_offset);
+    update_splat_map(unsigned int texture_id, const int &map_width, const int &map_height,
+                     const std::vector<unsigned char> &splat_data);
 
     std::tuple<unsigned int, unsigned int>
     create_terrain(std::vector<float> &vertices);
 
-    float
-    get_sign(float value);
+    void
+    allocate_terrain_capture(terrain_capture &capture, std::size_t vertex_count);
+
+    void
+    delete_terrain_capture(terrain_capture &capture);
 }
 
 #endif //INC_3DPERLINMAP_TERRAIN_TOOL_H
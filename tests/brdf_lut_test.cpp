@@ -0,0 +1,20 @@
+//
+// Builds utilities/brdf_lut.h over a 128x128 lut of 512 samples, away from the defaults of BRDF.frag. The header
+// checks the table at compile time, the test reports how far it is from the reference and fails when it is out
+// of the tolerance of its resolution and sample count.
+//
+
+#include "../utilities/brdf_lut.h"
+
+#include <iostream>
+
+int main() {
+    float difference = utilities::brdf::reference_difference();
+    float tolerance = utilities::brdf::reference_tolerance();
+
+    std::cout << utilities::brdf::lut_resolution << "x" << utilities::brdf::lut_resolution << " lut of "
+              << utilities::brdf::lut_sample_count << " samples: " << difference << " from BRDF.frag, "
+              << tolerance << " allowed" << std::endl;
+
+    return difference < tolerance ? 0 : 1;
+}
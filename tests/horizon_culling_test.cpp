@@ -0,0 +1,137 @@
+//
+// Checks that terrain::cull_below_horizon never culls a visible patch. Random cameras stand over a Perlin
+// height field; every point sampled on a culled patch is ray-marched back to the camera, and one that can be
+// seen past the terrain outside its own patch is a false cull.
+// Exits with 1 on a false cull.
+//
+
+#include "../terrain/horizon_culling.h"
+
+#include <PerlinNoise.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+    // a square world of patches over a grid of heights one unit apart
+    const int patch_numbers = 32;
+    const int patch_size = 16;
+    const int grid_size = patch_numbers * patch_size;
+    const float terrain_height = 160.0f;
+
+    const int camera_count = 20;
+    // points per side sampled on a culled patch, and the step of the ray march
+    const int patch_samples = 3;
+    const float march_step = 1.0f;
+
+    std::vector<float> heights;
+
+    float
+    grid_height(int x, int z) {
+        return heights[static_cast<std::size_t>(z) * (grid_size + 1) + x];
+    }
+
+    // bilinear between the grid points, like the height map is filtered
+    float
+    surface_height(float x, float z) {
+        x = std::clamp(x, 0.0f, static_cast<float>(grid_size));
+        z = std::clamp(z, 0.0f, static_cast<float>(grid_size));
+        int x0 = std::min(static_cast<int>(x), grid_size - 1);
+        int z0 = std::min(static_cast<int>(z), grid_size - 1);
+        float u = x - static_cast<float>(x0), v = z - static_cast<float>(z0);
+        float bottom = grid_height(x0, z0) + (grid_height(x0 + 1, z0) - grid_height(x0, z0)) * u;
+        float top = grid_height(x0, z0 + 1) + (grid_height(x0 + 1, z0 + 1) - grid_height(x0, z0 + 1)) * u;
+        return bottom + (top - bottom) * v;
+    }
+
+    /**
+     * March from the camera to a point on a patch
+     * @return true if no terrain outside the patch rises above the line of sight
+     */
+    bool
+    is_point_visible(const glm::vec3 &camera, const glm::vec3 &point, const terrain::horizon_patch &patch) {
+        glm::vec3 ray = point - camera;
+        float length = glm::length(glm::vec2(ray.x, ray.z));
+        int step_count = static_cast<int>(length / march_step);
+
+        for (int step = 1; step < step_count; ++step) {
+            glm::vec3 position = camera + ray * (static_cast<float>(step) * march_step / length);
+            if (position.x >= patch.min_corner.x && position.x <= patch.max_corner.x &&
+                position.z >= patch.min_corner.y && position.z <= patch.max_corner.y)
+                continue;
+            if (surface_height(position.x, position.z) > position.y)
+                return false;
+        }
+        return true;
+    }
+}
+
+int main() {
+    siv::PerlinNoise perlin(siv::PerlinNoise::seed_type(7961148u));
+    heights.resize(static_cast<std::size_t>(grid_size + 1) * (grid_size + 1));
+    for (int z = 0; z <= grid_size; ++z)
+        for (int x = 0; x <= grid_size; ++x)
+            heights[static_cast<std::size_t>(z) * (grid_size + 1) + x] =
+                    static_cast<float>(perlin.octave2D_01(x * 0.006, z * 0.006, 6)) * terrain_height;
+
+    // the bounds of a patch cover every grid point of its rectangle, the surface in between stays inside them
+    std::vector<terrain::horizon_patch> patches;
+    for (int i = 0; i < patch_numbers; ++i) {
+        for (int j = 0; j < patch_numbers; ++j) {
+            terrain::horizon_patch patch{glm::vec2(i, j) * static_cast<float>(patch_size),
+                                         glm::vec2(i + 1, j + 1) * static_cast<float>(patch_size),
+                                         terrain_height, 0.0f};
+            for (int x = i * patch_size; x <= (i + 1) * patch_size; ++x) {
+                for (int z = j * patch_size; z <= (j + 1) * patch_size; ++z) {
+                    patch.min_height = std::min(patch.min_height, grid_height(x, z));
+                    patch.max_height = std::max(patch.max_height, grid_height(x, z));
+                }
+            }
+            patches.push_back(patch);
+        }
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> ground(grid_size * 0.125f, grid_size * 0.875f);
+    std::uniform_real_distribution<float> above(2.0f, 40.0f);
+
+    std::vector<unsigned char> visible;
+    std::size_t culled_total = 0;
+    int false_culls = 0;
+
+    for (int c = 0; c < camera_count; ++c) {
+        glm::vec3 camera(ground(random), 0.0f, ground(random));
+        camera.y = surface_height(camera.x, camera.z) + above(random);
+
+        std::size_t culled = terrain::cull_below_horizon(patches, camera, visible);
+        culled_total += culled;
+
+        for (std::size_t p = 0; p < patches.size(); ++p) {
+            if (visible[p]) continue;
+
+            const terrain::horizon_patch &patch = patches[p];
+            for (int sx = 0; sx < patch_samples; ++sx) {
+                for (int sz = 0; sz < patch_samples; ++sz) {
+                    glm::vec2 corner = patch.min_corner + (patch.max_corner - patch.min_corner) *
+                                                          glm::vec2(sx, sz) / static_cast<float>(patch_samples - 1);
+                    glm::vec3 point(corner.x, surface_height(corner.x, corner.y), corner.y);
+                    if (!is_point_visible(camera, point, patch)) continue;
+
+                    std::cerr << "camera " << c << ": patch " << p << " is culled but (" << point.x << ", "
+                              << point.y << ", " << point.z << ") can be seen" << std::endl;
+                    ++false_culls;
+                }
+            }
+        }
+    }
+
+    std::cout << camera_count << " cameras, " << 100.0 * static_cast<double>(culled_total) /
+                                                 static_cast<double>(camera_count * patches.size())
+              << "% of the patches culled, " << false_culls << " false culls" << std::endl;
+
+    return false_culls == 0 ? 0 : 1;
+}
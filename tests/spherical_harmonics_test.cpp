@@ -0,0 +1,117 @@
+//
+// Projects environments with a known irradiance onto the L2 spherical harmonics and checks the 9 coefficients,
+// once through the projector scanline by scanline and once through the threaded project_irradiance_sh9.
+// Exits with 1 when a coefficient is off by more than the tolerance.
+//
+
+#include "../utilities/spherical_harmonics.h"
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    constexpr double PI = 3.14159265358979;
+    // the basis factors of spherical_harmonics.cpp are rounded to 6 digits, the grid adds a little more
+    constexpr float tolerance = 2e-3f;
+
+    const int width = 512;
+    const int height = 256;
+
+    /**
+     * Equirectangular environment with the same pixel directions as sh9_projector, row 0 at the bottom
+     * @param radiance rgb radiance of a direction
+     * @return rgb float pixels
+     */
+    std::vector<float>
+    make_environment(const std::function<glm::vec3(const glm::vec3 &)> &radiance) {
+        std::vector<float> data(static_cast<std::size_t>(width) * height * 3);
+        for (int y = 0; y < height; ++y) {
+            double lat = (y + 0.5) / height * PI - 0.5 * PI;
+            for (int x = 0; x < width; ++x) {
+                double phi = (x + 0.5) / width * 2.0 * PI - PI;
+                glm::vec3 direction(std::cos(lat) * std::cos(phi), std::sin(lat), std::cos(lat) * std::sin(phi));
+                glm::vec3 value = radiance(direction);
+                float *pixel = &data[(static_cast<std::size_t>(y) * width + x) * 3];
+                pixel[0] = value.r;
+                pixel[1] = value.g;
+                pixel[2] = value.b;
+            }
+        }
+        return data;
+    }
+
+    /**
+     * @param name name of the case
+     * @param coefficients projected coefficients
+     * @param expected coefficients of the exact irradiance / PI
+     * @return number of coefficients out of tolerance
+     */
+    int
+    check(const std::string &name, const utilities::sh9_coefficients &coefficients,
+          const utilities::sh9_coefficients &expected) {
+        int failures = 0;
+        for (std::size_t k = 0; k < coefficients.size(); ++k) {
+            for (int c = 0; c < 3; ++c) {
+                if (std::abs(coefficients[k][c] - expected[k][c]) <= tolerance) continue;
+                std::cerr << name << ": coefficient " << k << " channel " << c << " is " << coefficients[k][c]
+                          << ", expected " << expected[k][c] << std::endl;
+                ++failures;
+            }
+        }
+        std::cout << name << ": " << (failures == 0 ? "ok" : "failed") << std::endl;
+        return failures;
+    }
+
+    /**
+     * Run a case through both ways of projecting
+     * @return number of coefficients out of tolerance
+     */
+    int
+    run_case(const std::string &name, const std::function<glm::vec3(const glm::vec3 &)> &radiance,
+             const utilities::sh9_coefficients &expected) {
+        std::vector<float> data = make_environment(radiance);
+
+        utilities::sh9_projector projector(width, height);
+        for (int y = height - 1; y >= 0; --y)
+            projector.add_row(y, data.data() + static_cast<std::size_t>(y) * width * 3, 3);
+
+        return check(name + "/projector", projector.coefficients(), expected) +
+               check(name + "/threaded", utilities::project_irradiance_sh9(data.data(), width, height, 3, 4),
+                     expected);
+    }
+}
+
+int main() {
+    // evaluated at any normal the coefficients give irradiance / PI. a constant radiance L gives an irradiance of
+    // PI * L, only the constant band is left: L / Y00 = L * 2 * sqrt(PI)
+    utilities::sh9_coefficients constant{};
+    constant[0] = glm::vec3(1.0f, 0.5f, 0.25f) * static_cast<float>(2.0 * std::sqrt(PI));
+
+    // a radiance of dot(direction, axis) projects to Y1 * 4PI/3 on the band of the axis, convolved with the cosine
+    // lobe by 2/3. the basis orders the first band y, z, x
+    const auto linear = static_cast<float>(0.488603 * 4.0 * PI / 3.0 * 2.0 / 3.0);
+    utilities::sh9_coefficients linear_y{};
+    linear_y[1] = glm::vec3(linear);
+    utilities::sh9_coefficients linear_x{};
+    linear_x[3] = glm::vec3(linear, 0.0f, 0.0f);
+
+    // a constant term on top of the linear one only adds to the constant band
+    utilities::sh9_coefficients mixed = linear_y;
+    mixed[0] = glm::vec3(static_cast<float>(2.0 * std::sqrt(PI)));
+
+    int failures = 0;
+    failures += run_case("constant", [](const glm::vec3 &) { return glm::vec3(1.0f, 0.5f, 0.25f); }, constant);
+    failures += run_case("linear y", [](const glm::vec3 &direction) { return glm::vec3(direction.y); }, linear_y);
+    failures += run_case("linear x", [](const glm::vec3 &direction) {
+        return glm::vec3(direction.x, 0.0f, 0.0f);
+    }, linear_x);
+    failures += run_case("constant and linear y", [](const glm::vec3 &direction) {
+        return glm::vec3(1.0f + direction.y);
+    }, mixed);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+//
+// Bakes the split-sum BRDF lut at build time, the table is compiled into the application by utilities/brdf_lut.h.
+// The integral is the one of IntegrateBRDF in BRDF.frag with the same Hammersley points and tangent frame,
+// evaluated at the texel centers in double precision.
+//
+// usage: brdf_lut_baker resolution sample_count output
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    constexpr double PI = 3.14159265358979323846;
+
+    // low-discrepancy sequence
+    double
+    radical_inverse_vdc(std::uint32_t bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return static_cast<double>(bits) * 2.3283064365386963e-10; // / 0x100000000
+    }
+
+    double
+    pow5(double value) {
+        double squared = value * value;
+        return squared * squared * value;
+    }
+
+    // note that we use a different k for IBL
+    double
+    geometry_schlick_ggx(double n_dot_v, double roughness) {
+        double k = (roughness * roughness) / 2.0;
+        return n_dot_v / (n_dot_v * (1.0 - k) + k);
+    }
+
+    // GGX importance sampled halfway vectors of one roughness, with N = (0, 0, 1) the tangent frame of BRDF.frag
+    // maps (x, y, z) to (y, -x, z). V lies in the xz-plane so only the x and z components of H are needed
+    struct halfway_samples {
+        std::vector<double> x;
+        std::vector<double> z;
+    };
+
+    halfway_samples
+    importance_sample_ggx(double roughness, std::uint32_t sample_count) {
+        const double a = roughness * roughness;
+        halfway_samples samples{std::vector<double>(sample_count), std::vector<double>(sample_count)};
+
+        for (std::uint32_t i = 0; i < sample_count; ++i) {
+            // hammersley point
+            double phi = 2.0 * PI * static_cast<double>(i) / static_cast<double>(sample_count);
+            double xi = radical_inverse_vdc(i);
+            double cos_theta = std::sqrt((1.0 - xi) / (1.0 + (a * a - 1.0) * xi));
+            double sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+
+            samples.x[i] = std::sin(phi) * sin_theta;
+            samples.z[i] = cos_theta;
+        }
+        return samples;
+    }
+
+    /**
+     * IntegrateBRDF of BRDF.frag
+     * @param n_dot_v cosine between normal and view direction
+     * @param roughness
+     * @param samples halfway vectors sampled for this roughness
+     * @param scale scale of F0
+     * @param bias bias of F0
+     */
+    void
+    integrate(double n_dot_v, double roughness, const halfway_samples &samples, double &scale, double &bias) {
+        const double v_x = std::sqrt(1.0 - n_dot_v * n_dot_v);
+        const double v_z = n_dot_v;
+        const double g_v = geometry_schlick_ggx(n_dot_v, roughness);
+
+        scale = 0.0;
+        bias = 0.0;
+        for (std::size_t i = 0; i < samples.x.size(); ++i) {
+            double h_x = samples.x[i];
+            double h_z = samples.z[i];
+
+            // reflect V about H, H is normalized so L stays normalized
+            double v_dot_h = v_x * h_x + v_z * h_z;
+            double n_dot_l = 2.0 * v_dot_h * h_z - v_z;
+
+            if (n_dot_l > 0.0) {
+                v_dot_h = std::max(v_dot_h, 0.0);
+
+                double g = g_v * geometry_schlick_ggx(n_dot_l, roughness);
+                double g_vis = (g * v_dot_h) / (h_z * n_dot_v);
+                double fc = pow5(1.0 - v_dot_h);
+
+                scale += (1.0 - fc) * g_vis;
+                bias += fc * g_vis;
+            }
+        }
+
+        scale /= static_cast<double>(samples.x.size());
+        bias /= static_cast<double>(samples.x.size());
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        std::cerr << "usage: brdf_lut_baker resolution sample_count output" << std::endl;
+        return -1;
+    }
+
+    int resolution = std::atoi(argv[1]);
+    long sample_count = std::atol(argv[2]);
+    std::string path(argv[3]);
+    if (resolution <= 0 || sample_count <= 0) {
+        std::cerr << "resolution and sample count must be positive" << std::endl;
+        return -1;
+    }
+
+    // NdotV along x and roughness along y at the texel centers, like the quad BRDF.frag is rendered on.
+    // the rows are spread over the hardware threads
+    std::vector<double> lut(static_cast<std::size_t>(resolution) * resolution * 2);
+    std::atomic<int> next_row = 0;
+    auto bake_rows = [&]() {
+        for (int y = next_row++; y < resolution; y = next_row++) {
+            double roughness = (y + 0.5) / resolution;
+            halfway_samples samples = importance_sample_ggx(roughness, static_cast<std::uint32_t>(sample_count));
+            for (int x = 0; x < resolution; ++x) {
+                std::size_t texel = (static_cast<std::size_t>(y) * resolution + x) * 2;
+                integrate((x + 0.5) / resolution, roughness, samples, lut[texel], lut[texel + 1]);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers(std::max(1u, std::thread::hardware_concurrency()));
+    for (auto &worker: workers)
+        worker = std::thread(bake_rows);
+    for (auto &worker: workers)
+        worker.join();
+
+    // the initializer of utilities::brdf::lut, interleaved rg values row by row
+    std::ofstream file(path);
+    if (!file)
+        throw std::runtime_error("Failed to open file: " + path);
+
+    file << "// baked by brdf_lut_baker, " << resolution << "x" << resolution << ", " << sample_count
+         << " samples\n";
+    // 9 significant digits give back the same float
+    file << std::scientific;
+    file.precision(8);
+    for (std::size_t i = 0; i < lut.size(); ++i)
+        file << static_cast<float>(lut[i]) << "f," << (i % 8 == 7 ? "\n" : " ");
+    file << "\n";
+
+    if (!file)
+        throw std::runtime_error("Failed to write file: " + path);
+    return 0;
+}
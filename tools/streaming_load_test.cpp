@@ -0,0 +1,466 @@
+//
+// Streaming load test: drives a camera along a straight line or a spiral at increasing speeds through the
+// terrain::chunk_loader of main.cpp without a window. The frame loop makes one new chunk resident per frame through
+// chunk_loader::update like main.cpp, with a copy of its data standing in for the texture uploads. Every speed
+// step records how long the chunks in render distance take from entering it to being resident, the frames drawn
+// with a chunk missing, the depth of the upload queue and of the loader backlog. The first speed with too many of
+// those placeholder frames is where the pipeline saturates.
+//
+// usage: streaming_load_test [--trajectory straight|spiral|both] [--direction degrees] [--spiral-spacing units]
+//                            [--start-speed units/s] [--speed-factor f] [--max-speed units/s]
+//                            [--step-seconds s] [--frame-ms ms] [--upload-ms ms]
+//                            [--max-placeholder-fraction f] [--sample-step n] [--output file]
+//
+
+#include "../terrain/chunk_loader.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+    using clock = std::chrono::steady_clock;
+
+    // the same chunk layout and generation settings as main.cpp
+    const int map_width = 256;
+    const int map_height = 256;
+    const int texture_width = map_width + 2;
+    const int texture_height = map_height + 2;
+    const int patch_numbers = 16;
+    const float terrain_height = 600.0f;
+    const int render_distance = 3;
+    // the loader of main.cpp prefetches this many chunks beyond the render distance after its first pass
+    const int prefetch_range = 3;
+    // unlike main.cpp chunks this far beyond the loading range are dropped, the test travels much farther than a player
+    const int evict_range = 2;
+
+    const float pi = 3.14159265358979f;
+
+    struct load_test_settings {
+        std::vector<std::string> trajectories{"straight", "spiral"};
+        // direction of the straight line in the xz plane
+        float direction = 0.0f;
+        // distance between the turns of the spiral
+        float spiral_spacing = 2.0f * map_width;
+        // units per second
+        float start_speed = 128.0f;
+        float speed_factor = 1.5f;
+        float max_speed = 8192.0f;
+        double step_seconds = 4.0;
+        // frame period, 60 hz like the vertical sync of the window
+        double frame_time = 1000.0 / 60.0;
+        // extra time spent on every upload on top of the copy, for a slower driver
+        double upload_time = 0.0;
+        // more placeholder frames than this part of a step saturate the pipeline
+        float max_placeholder_fraction = 0.05f;
+        // more than 1 generates a coarse preview of every new chunk first, like the progressive generation of main.cpp
+        int sample_step = 1;
+        std::string output_path = "streaming_load_test.json";
+    };
+
+    struct step_result {
+        std::string trajectory;
+        float speed = 0.0f;
+        std::size_t frames = 0;
+        std::size_t placeholder_frames = 0;
+        // chunks that entered the render distance, those still missing at the end of the step are unresolved
+        std::size_t chunk_count = 0;
+        std::size_t unresolved_chunks = 0;
+        std::size_t generated_chunks = 0;
+        // milliseconds from entering the render distance to being resident, 0 for prefetched chunks
+        float mean_latency = 0.0f;
+        float p50_latency = 0.0f;
+        float p95_latency = 0.0f;
+        float max_latency = 0.0f;
+        float mean_upload_queue = 0.0f;
+        std::size_t max_upload_queue = 0;
+        // chunks in the loading range that are not generated yet
+        float mean_loader_backlog = 0.0f;
+        std::size_t max_loader_backlog = 0;
+    };
+
+    std::pair<int, int>
+    get_grid(float x, float z) {
+        return {static_cast<int>(std::trunc(x / map_width + 0.5f)), static_cast<int>(std::trunc(z / map_height + 0.5f))};
+    }
+
+    /**
+     * Copy the data of a chunk where main.cpp creates its textures
+     * @param chunk generated chunk
+     * @param staging buffer the data is copied to
+     * @param upload_time extra milliseconds to spend
+     */
+    void
+    upload_chunk(const terrain::map_chunk &chunk, std::vector<float> &staging, double upload_time) {
+        staging.assign(chunk.height_data.begin(), chunk.height_data.end());
+        staging.insert(staging.end(), chunk.splat_data.begin(), chunk.splat_data.end());
+
+        auto until = clock::now() + std::chrono::duration<double, std::milli>(upload_time);
+        while (clock::now() < until);
+    }
+
+    // the camera moved along the trajectory by a distance
+    struct trajectory {
+        bool spiral = false;
+        glm::vec2 direction{1.0f, 0.0f};
+        // archimedean spiral, the radius grows by spiral_step per radian
+        float spiral_step = 0.0f;
+        float angle = 0.0f;
+        glm::vec2 position{0.0f};
+
+        glm::vec2
+        advance(float distance) {
+            if (!spiral) {
+                position += direction * distance;
+                return position;
+            }
+
+            // arc length of the spiral per radian is sqrt(r^2 + b^2), steps are small enough to take it as constant
+            float radius = spiral_step * angle;
+            angle += distance / std::sqrt(radius * radius + spiral_step * spiral_step);
+            radius = spiral_step * angle;
+            position = glm::vec2(std::cos(angle), std::sin(angle)) * radius;
+            return position;
+        }
+    };
+
+    trajectory
+    make_trajectory(const std::string &name, const load_test_settings &settings) {
+        trajectory path;
+        if (name == "spiral") {
+            path.spiral = true;
+            path.spiral_step = settings.spiral_spacing / (2.0f * pi);
+            // one turn out, the center would turn on the spot
+            path.angle = 2.0f * pi;
+            path.position = glm::vec2(settings.spiral_spacing, 0.0f);
+        } else {
+            float radians = settings.direction * pi / 180.0f;
+            path.direction = glm::vec2(std::cos(radians), std::sin(radians));
+        }
+        return path;
+    }
+
+    float
+    get_percentile(std::vector<float> sorted_values, float percentile) {
+        if (sorted_values.empty()) return 0.0f;
+        auto index = static_cast<std::size_t>(percentile * static_cast<float>(sorted_values.size() - 1) + 0.5f);
+        return sorted_values[index];
+    }
+
+    /**
+     * Run the pipeline for one speed, from a cold start with the render distance loaded like at the startup of main.cpp
+     * @param name trajectory
+     * @param speed units per second
+     * @param settings settings of the test
+     * @param parameters noise parameters
+     * @param splat splat settings
+     * @return measurements of the step
+     */
+    step_result
+    run_step(const std::string &name, float speed, const load_test_settings &settings,
+             const terrain::generation_parameters &parameters, const terrain::splat_settings &splat) {
+        terrain::chunk_loader_settings loader_settings;
+        loader_settings.map_width = map_width;
+        loader_settings.map_height = map_height;
+        loader_settings.texture_width = texture_width;
+        loader_settings.texture_height = texture_height;
+        loader_settings.terrain_height = terrain_height;
+        loader_settings.patch_numbers = patch_numbers;
+        loader_settings.render_distance = render_distance;
+        loader_settings.prefetch_range = prefetch_range;
+        loader_settings.evict_range = evict_range;
+        loader_settings.coarse_sample_step = std::max(settings.sample_step, 1);
+
+        terrain::chunk_loader loader(loader_settings);
+        loader.progressive_generation = settings.sample_step > 1;
+        loader.set_generation_parameters(std::make_shared<terrain::generation_parameters>(parameters));
+        loader.set_splat_settings(splat);
+
+        trajectory path = make_trajectory(name, settings);
+        glm::vec2 position = path.position;
+        loader.start(glm::vec3(position.x, 0.0f, position.y));
+
+        // chunks with their data uploaded, the textures of main.cpp
+        std::unordered_set<std::pair<int, int>, terrain::pair_hash> resident_chunks;
+        std::vector<float> staging;
+        auto upload = [&](terrain::map_chunk &chunk, terrain::chunk_update update) {
+            std::pair<int, int> grid(chunk.grid_x, chunk.grid_y);
+            switch (update) {
+                case terrain::chunk_update::created:
+                    upload_chunk(chunk, staging, settings.upload_time);
+                    resident_chunks.insert(grid);
+                    break;
+                case terrain::chunk_update::regenerated:
+                case terrain::chunk_update::splat_rebuilt:
+                    if (resident_chunks.contains(grid))
+                        upload_chunk(chunk, staging, settings.upload_time);
+                    break;
+                case terrain::chunk_update::evicted:
+                    resident_chunks.erase(grid);
+                    break;
+            }
+        };
+
+        // the whole loading range around the start, like a camera that stood still for a while,
+        // uploaded as fast as the loader delivers
+        auto [start_x, start_y] = get_grid(position.x, position.y);
+        const int range = render_distance + prefetch_range;
+        while (true) {
+            loader.update(upload, std::numeric_limits<std::size_t>::max());
+
+            bool ready = true;
+            for (int x = start_x - range; x <= start_x + range && ready; ++x)
+                for (int y = start_y - range; y <= start_y + range && ready; ++y)
+                    ready = resident_chunks.contains({x, y});
+            if (ready) break;
+            std::this_thread::yield();
+        }
+
+        step_result result;
+        result.trajectory = name;
+        result.speed = speed;
+        std::size_t start_generated = loader.generated_chunk_count;
+
+        std::unordered_set<std::pair<int, int>, terrain::pair_hash> seen_chunks;
+        std::unordered_map<std::pair<int, int>, clock::time_point, terrain::pair_hash> pending_chunks;
+        std::vector<float> latencies;
+        double upload_queue_sum = 0.0;
+        double loader_backlog_sum = 0.0;
+
+        const auto frame_period = std::chrono::duration<double, std::milli>(settings.frame_time);
+        const auto step_start = clock::now();
+        auto last_frame = step_start;
+        auto next_frame = step_start;
+
+        while (clock::now() - step_start < std::chrono::duration<double>(settings.step_seconds)) {
+            auto now = clock::now();
+            position = path.advance(speed * std::chrono::duration<float>(now - last_frame).count());
+            last_frame = now;
+            loader.set_camera_position(glm::vec3(position.x, 0.0f, position.y));
+
+            // one new chunk per frame, like main.cpp
+            loader.update(upload);
+
+            auto [grid_x, grid_y] = get_grid(position.x, position.y);
+            bool placeholder = false;
+            now = clock::now();
+            for (int x = grid_x - render_distance; x <= grid_x + render_distance; ++x) {
+                for (int y = grid_y - render_distance; y <= grid_y + render_distance; ++y) {
+                    std::pair<int, int> grid(x, y);
+                    bool resident = resident_chunks.contains(grid);
+                    placeholder |= !resident;
+
+                    if (seen_chunks.insert(grid).second) {
+                        if (resident)
+                            latencies.push_back(0.0f);
+                        else
+                            pending_chunks.emplace(grid, now);
+                    } else if (auto pending = pending_chunks.find(grid);
+                            resident && pending != pending_chunks.end()) {
+                        latencies.push_back(std::chrono::duration<float, std::milli>(now - pending->second).count());
+                        pending_chunks.erase(pending);
+                    }
+                }
+            }
+
+            // chunks the loader has not handed over yet
+            std::size_t backlog = 0;
+            for (int x = grid_x - range; x <= grid_x + range; ++x)
+                for (int y = grid_y - range; y <= grid_y + range; ++y)
+                    backlog += !loader.get_chunks().contains({x, y});
+
+            std::size_t queue_depth = loader.get_upload_queue_size();
+            upload_queue_sum += static_cast<double>(queue_depth);
+            result.max_upload_queue = std::max(result.max_upload_queue, queue_depth);
+            loader_backlog_sum += static_cast<double>(backlog);
+            result.max_loader_backlog = std::max(result.max_loader_backlog, backlog);
+
+            ++result.frames;
+            result.placeholder_frames += placeholder;
+
+            next_frame += std::chrono::duration_cast<clock::duration>(frame_period);
+            // a frame that overran starts the next one at once instead of catching up
+            if (next_frame < clock::now())
+                next_frame = clock::now();
+            std::this_thread::sleep_until(next_frame);
+        }
+
+        loader.stop();
+
+        result.generated_chunks = loader.generated_chunk_count - start_generated;
+        result.chunk_count = seen_chunks.size();
+        result.unresolved_chunks = pending_chunks.size();
+        if (!latencies.empty()) {
+            std::sort(latencies.begin(), latencies.end());
+            double sum = 0.0;
+            for (float latency: latencies) sum += latency;
+            result.mean_latency = static_cast<float>(sum / static_cast<double>(latencies.size()));
+            result.p50_latency = get_percentile(latencies, 0.5f);
+            result.p95_latency = get_percentile(latencies, 0.95f);
+            result.max_latency = latencies.back();
+        }
+        if (result.frames > 0) {
+            result.mean_upload_queue = static_cast<float>(upload_queue_sum / static_cast<double>(result.frames));
+            result.mean_loader_backlog = static_cast<float>(loader_backlog_sum / static_cast<double>(result.frames));
+        }
+        return result;
+    }
+
+    bool
+    is_saturated(const step_result &step, const load_test_settings &settings) {
+        return static_cast<float>(step.placeholder_frames) >
+               settings.max_placeholder_fraction * static_cast<float>(step.frames);
+    }
+
+    void
+    write_results(const std::string &path, const load_test_settings &settings,
+                  const std::vector<std::vector<step_result>> &trajectories) {
+        std::ofstream file(path);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + path);
+
+        file << "{\n"
+             << "  \"frame_time_ms\": " << settings.frame_time << ",\n"
+             << "  \"upload_time_ms\": " << settings.upload_time << ",\n"
+             << "  \"step_seconds\": " << settings.step_seconds << ",\n"
+             << "  \"max_placeholder_fraction\": " << settings.max_placeholder_fraction << ",\n"
+             << "  \"sample_step\": " << settings.sample_step << ",\n"
+             << "  \"trajectories\": [";
+
+        for (std::size_t i = 0; i < trajectories.size(); ++i) {
+            const std::vector<step_result> &steps = trajectories[i];
+            file << (i == 0 ? "\n" : ",\n")
+                 << "    {\"trajectory\": \"" << steps.front().trajectory << "\", \"saturation_speed\": ";
+            if (!steps.empty() && is_saturated(steps.back(), settings))
+                file << steps.back().speed;
+            else
+                file << "null";
+            file << ", \"steps\": [";
+
+            for (std::size_t j = 0; j < steps.size(); ++j) {
+                const step_result &step = steps[j];
+                file << (j == 0 ? "\n" : ",\n")
+                     << "      {\"speed\": " << step.speed << ", \"frames\": " << step.frames
+                     << ", \"placeholder_frames\": " << step.placeholder_frames
+                     << ", \"chunk_count\": " << step.chunk_count
+                     << ", \"unresolved_chunks\": " << step.unresolved_chunks
+                     << ", \"generated_chunks\": " << step.generated_chunks
+                     << ", \"latency_ms\": {\"mean\": " << step.mean_latency << ", \"p50\": " << step.p50_latency
+                     << ", \"p95\": " << step.p95_latency << ", \"max\": " << step.max_latency << "}"
+                     << ", \"upload_queue\": {\"mean\": " << step.mean_upload_queue
+                     << ", \"max\": " << step.max_upload_queue << "}"
+                     << ", \"loader_backlog\": {\"mean\": " << step.mean_loader_backlog
+                     << ", \"max\": " << step.max_loader_backlog << "}}";
+            }
+            file << "\n    ]}";
+        }
+
+        file << "\n  ]\n}\n";
+
+        if (!file)
+            throw std::runtime_error("Failed to write file: " + path);
+    }
+}
+
+int main(int argc, char **argv) {
+    load_test_settings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        bool has_value = i + 1 < argc;
+        if (argument == "--trajectory" && has_value) {
+            std::string trajectory = argv[++i];
+            if (trajectory == "both")
+                settings.trajectories = {"straight", "spiral"};
+            else if (trajectory == "straight" || trajectory == "spiral")
+                settings.trajectories = {trajectory};
+            else
+                has_value = false;
+        } else if (argument == "--direction" && has_value) {
+            settings.direction = static_cast<float>(std::atof(argv[++i]));
+        } else if (argument == "--spiral-spacing" && has_value) {
+            settings.spiral_spacing = std::max(1.0f, static_cast<float>(std::atof(argv[++i])));
+        } else if (argument == "--start-speed" && has_value) {
+            settings.start_speed = std::max(1.0f, static_cast<float>(std::atof(argv[++i])));
+        } else if (argument == "--speed-factor" && has_value) {
+            settings.speed_factor = std::max(1.01f, static_cast<float>(std::atof(argv[++i])));
+        } else if (argument == "--max-speed" && has_value) {
+            settings.max_speed = static_cast<float>(std::atof(argv[++i]));
+        } else if (argument == "--step-seconds" && has_value) {
+            settings.step_seconds = std::max(0.1, std::atof(argv[++i]));
+        } else if (argument == "--frame-ms" && has_value) {
+            settings.frame_time = std::max(0.0, std::atof(argv[++i]));
+        } else if (argument == "--upload-ms" && has_value) {
+            settings.upload_time = std::max(0.0, std::atof(argv[++i]));
+        } else if (argument == "--max-placeholder-fraction" && has_value) {
+            settings.max_placeholder_fraction = static_cast<float>(std::atof(argv[++i]));
+        } else if (argument == "--sample-step" && has_value) {
+            settings.sample_step = std::max(1, std::atoi(argv[++i]));
+        } else if (argument == "--output" && has_value) {
+            settings.output_path = argv[++i];
+        } else {
+            has_value = false;
+        }
+
+        if (!has_value) {
+            std::cerr << "usage: streaming_load_test [--trajectory straight|spiral|both] [--direction degrees] "
+                         "[--spiral-spacing units] [--start-speed units/s] [--speed-factor f] [--max-speed units/s] "
+                         "[--step-seconds s] [--frame-ms ms] [--upload-ms ms] [--max-placeholder-fraction f] "
+                         "[--sample-step n] [--output file]" << std::endl;
+            return -1;
+        }
+    }
+
+    // the defaults are the startup parameters of main.cpp
+    terrain::generation_parameters parameters;
+    parameters.perlin.reseed(parameters.seed);
+
+    // the splat settings of main.cpp, rock on the steepest ground
+    terrain::splat_settings splat;
+    splat.height_bands = {0.0f, 0.25f, 0.6f, 0.8f, 0.9f, 1.0f};
+    splat.slope_layer = 3;
+    splat.slope_start = 75.0f;
+    splat.slope_end = 82.0f;
+
+    std::vector<std::vector<step_result>> trajectories;
+    for (const std::string &name: settings.trajectories) {
+        std::vector<step_result> &steps = trajectories.emplace_back();
+
+        // faster and faster until the pipeline saturates
+        for (float speed = settings.start_speed; speed <= settings.max_speed; speed *= settings.speed_factor) {
+            const step_result &step = steps.emplace_back(run_step(name, speed, settings, parameters, splat));
+            std::cout << name << " at " << speed << " units/s: " << step.placeholder_frames << " of " << step.frames
+                      << " placeholder frames, latency p95 " << step.p95_latency << " ms, max "
+                      << step.max_latency << ", " << step.unresolved_chunks << " unresolved, upload queue max "
+                      << step.max_upload_queue << ", loader backlog max " << step.max_loader_backlog << std::endl;
+
+            if (is_saturated(step, settings)) {
+                std::cout << name << " saturates at " << speed << " units/s" << std::endl;
+                break;
+            }
+        }
+
+        if (steps.empty())
+            trajectories.pop_back();
+    }
+
+    try {
+        write_results(settings.output_path, settings, trajectories);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
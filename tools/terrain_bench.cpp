@@ -0,0 +1,344 @@
+//
+// Microbenchmark of the terrain_core library: height map generation, the plane vertices, slope and splat maps,
+// chunk hashing and the patch queries, without a gl context. The results are written as json, every benchmark
+// with a checksum of its output so a change of the generated terrain shows up next to a change of its time.
+//
+// usage: terrain_bench [--output file] [--min-time ms] [--filter text]
+//
+
+#include "../terrain/terrain_generator.h"
+#include "../terrain/map_chunk.h"
+#include "../terrain/horizon_culling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    // the same chunk layout and generation settings as main.cpp
+    const int map_width = 256;
+    const int map_height = 256;
+    const int texture_width = map_width + 2;
+    const int texture_height = map_height + 2;
+    const int patch_numbers = 16;
+    const float terrain_height = 600.0f;
+    const int render_distance = 3;
+
+    const float scale = 0.004f;
+    const int layer_count = 10;
+    const float lacunarity = 1.8f;
+    const float layer_lacunarity = 0.6f;
+    const float layer_amplitude = 0.5f;
+
+    struct benchmark_result {
+        std::string name;
+        std::size_t iterations = 0;
+        // milliseconds per iteration
+        double mean_time = 0.0;
+        double median_time = 0.0;
+        double min_time = 0.0;
+        // texels, vertices, lookups or patches per second
+        double items_per_second = 0.0;
+        // fnv-1a of the output of the last iteration
+        std::uint64_t checksum = 0;
+    };
+
+    std::uint64_t
+    hash_bytes(const void *data, std::size_t size, std::uint64_t hash = 14695981039346656037ull) {
+        auto bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    template<typename value_type>
+    std::uint64_t
+    hash_vector(const std::vector<value_type> &values) {
+        return hash_bytes(values.data(), values.size() * sizeof(value_type));
+    }
+
+    /**
+     * Run a function until min_time has passed, at least three times
+     * @param name name of the benchmark in the results
+     * @param items items one iteration works on
+     * @param min_time milliseconds to run for
+     * @param function the work of one iteration
+     * @return times of the iterations, the checksum is left to the caller
+     */
+    template<typename function_type>
+    benchmark_result
+    run_benchmark(const std::string &name, std::size_t items, double min_time, function_type &&function) {
+        using clock = std::chrono::steady_clock;
+
+        // one untimed iteration for the caches and the allocations of the outputs
+        function();
+
+        std::vector<double> times;
+        double total_time = 0.0;
+        while (times.size() < 3 || total_time < min_time) {
+            auto start = clock::now();
+            function();
+            times.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+            total_time += times.back();
+        }
+
+        benchmark_result result;
+        result.name = name;
+        result.iterations = times.size();
+        result.mean_time = total_time / static_cast<double>(times.size());
+        std::sort(times.begin(), times.end());
+        result.median_time = times[times.size() / 2];
+        result.min_time = times.front();
+        result.items_per_second = static_cast<double>(items) / (result.mean_time / 1000.0);
+        return result;
+    }
+
+    void
+    write_results(std::ostream &stream, const std::vector<benchmark_result> &results, double min_time) {
+        stream << "{\n"
+               << "  \"min_time_ms\": " << min_time << ",\n"
+               << "  \"benchmarks\": [";
+
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const benchmark_result &result = results[i];
+            stream << (i == 0 ? "\n" : ",\n")
+                   << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+                   << ", \"mean_ms\": " << result.mean_time << ", \"median_ms\": " << result.median_time
+                   << ", \"min_ms\": " << result.min_time << ", \"items_per_second\": " << result.items_per_second
+                   << ", \"checksum\": \"" << std::hex << result.checksum << std::dec << "\"}";
+        }
+
+        stream << "\n  ]\n}\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string output_path;
+    double min_time = 200.0;
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        bool has_value = i + 1 < argc;
+        if (argument == "--output" && has_value) {
+            output_path = argv[++i];
+        } else if (argument == "--min-time" && has_value) {
+            min_time = std::max(0.0, std::atof(argv[++i]));
+        } else if (argument == "--filter" && has_value) {
+            filter = argv[++i];
+        } else {
+            std::cerr << "usage: terrain_bench [--output file] [--min-time ms] [--filter text]" << std::endl;
+            return -1;
+        }
+    }
+
+    siv::PerlinNoise perlin(siv::PerlinNoise::seed_type(7961148u));
+    std::vector<benchmark_result> results;
+
+    auto add = [&](benchmark_result &&result) {
+        std::cerr << result.name << ": " << result.mean_time << " ms" << std::endl;
+        results.push_back(std::move(result));
+    };
+    auto selected = [&](const std::string &name) {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    };
+
+    const std::size_t texel_count = static_cast<std::size_t>(texture_width) * texture_height;
+    std::vector<float> height_map(texel_count);
+
+#pragma region generation
+
+    // the octave variant with lacunarity and amplitude per layer, at a few layer counts
+    for (int layers: {1, 4, layer_count}) {
+        std::string name = "get_height_map/layered/" + std::to_string(layers);
+        if (!selected(name)) continue;
+        benchmark_result result = run_benchmark(name, texel_count, min_time, [&]() {
+            terrain::get_height_map(height_map, perlin, texture_width, texture_height, scale, layers, lacunarity,
+                                    layer_lacunarity, layer_amplitude, 1.0f, 2.0f);
+        });
+        result.checksum = hash_vector(height_map);
+        add(std::move(result));
+    }
+
+    // the variant the chunk loader uses
+    if (selected("get_height_map/octaves")) {
+        benchmark_result result = run_benchmark("get_height_map/octaves", texel_count, min_time, [&]() {
+            terrain::get_height_map(height_map, perlin, texture_width, texture_height, scale, layer_count,
+                                    1.0f, 2.0f);
+        });
+        result.checksum = hash_vector(height_map);
+        add(std::move(result));
+    }
+
+    // the preview of progressive generation, every 4th texel like main.cpp
+    if (selected("get_coarse_height_map/4")) {
+        benchmark_result result = run_benchmark("get_coarse_height_map/4", texel_count, min_time, [&]() {
+            terrain::get_coarse_height_map(height_map, perlin, texture_width, texture_height, scale, layer_count, 4,
+                                           1.0f, 2.0f);
+        });
+        result.checksum = hash_vector(height_map);
+        add(std::move(result));
+    }
+
+    for (int patches: {patch_numbers, patch_numbers * 4}) {
+        std::string name = "generate_terrain_vertices/" + std::to_string(patches);
+        if (!selected(name)) continue;
+        std::vector<float> vertices;
+        benchmark_result result = run_benchmark(name, static_cast<std::size_t>(patches) * patches * 4, min_time,
+                                                [&]() {
+                                                    vertices.clear();
+                                                    terrain::generate_terrain_vertices(
+                                                            map_width, map_height, patches, vertices,
+                                                            1.0f / texture_width, 1.0f / texture_height);
+                                                });
+        result.checksum = hash_vector(vertices);
+        add(std::move(result));
+    }
+
+    // slope and splat maps of the chunk at (1, 2), with the bands of main.cpp
+    terrain::get_height_map(height_map, perlin, texture_width, texture_height, scale, layer_count, 1.0f, 2.0f);
+    std::vector<float> slope_map;
+    terrain::get_slope_map(slope_map, height_map, texture_width, texture_height, terrain_height);
+
+    if (selected("get_slope_map")) {
+        benchmark_result result = run_benchmark("get_slope_map", texel_count, min_time, [&]() {
+            terrain::get_slope_map(slope_map, height_map, texture_width, texture_height, terrain_height);
+        });
+        result.checksum = hash_vector(slope_map);
+        add(std::move(result));
+    }
+
+    if (selected("get_splat_map")) {
+        terrain::splat_settings settings;
+        settings.height_bands = {0.0f, 0.25f, 0.6f, 0.8f, 0.9f, 1.0f};
+        settings.slope_layer = 3;
+        settings.slope_start = 75.0f;
+        settings.slope_end = 82.0f;
+
+        std::vector<unsigned char> splat_map;
+        benchmark_result result = run_benchmark("get_splat_map", texel_count, min_time, [&]() {
+            terrain::get_splat_map(splat_map, height_map, slope_map, texture_width, texture_height, settings);
+        });
+        result.checksum = hash_vector(splat_map);
+        add(std::move(result));
+    }
+
+#pragma endregion
+
+#pragma region chunk hashing
+
+    // a square of chunks around the origin, inserted and looked up like the chunk loader and the render loop do
+    const int grid_radius = 32;
+    const std::size_t grid_count = static_cast<std::size_t>(grid_radius * 2 + 1) * (grid_radius * 2 + 1);
+
+    if (selected("chunk_map/insert")) {
+        std::unordered_map<std::pair<int, int>, int, terrain::pair_hash> chunks;
+        benchmark_result result = run_benchmark("chunk_map/insert", grid_count, min_time, [&]() {
+            chunks.clear();
+            for (int x = -grid_radius; x <= grid_radius; ++x)
+                for (int y = -grid_radius; y <= grid_radius; ++y)
+                    chunks.emplace(std::pair<int, int>(x, y), (x + grid_radius) * 1000 + y + grid_radius);
+        });
+        result.checksum = chunks.size();
+        add(std::move(result));
+    }
+
+    if (selected("chunk_map/find")) {
+        std::unordered_map<std::pair<int, int>, int, terrain::pair_hash> chunks;
+        for (int x = -grid_radius; x <= grid_radius; ++x)
+            for (int y = -grid_radius; y <= grid_radius; ++y)
+                chunks.emplace(std::pair<int, int>(x, y), (x + grid_radius) * 1000 + y + grid_radius);
+
+        long long sum = 0;
+        benchmark_result result = run_benchmark("chunk_map/find", grid_count, min_time, [&]() {
+            sum = 0;
+            for (int x = -grid_radius; x <= grid_radius; ++x)
+                for (int y = -grid_radius; y <= grid_radius; ++y)
+                    sum += chunks.find({x, y})->second;
+        });
+        result.checksum = static_cast<std::uint64_t>(sum);
+        add(std::move(result));
+    }
+
+#pragma endregion
+
+#pragma region queries
+
+    if (selected("get_patch_height_bounds")) {
+        std::vector<float> min_heights, max_heights;
+        benchmark_result result = run_benchmark("get_patch_height_bounds", texel_count, min_time, [&]() {
+            terrain::get_patch_height_bounds(min_heights, max_heights, height_map, texture_width, texture_height,
+                                             patch_numbers);
+        });
+        result.checksum = hash_bytes(max_heights.data(), max_heights.size() * sizeof(float),
+                                     hash_vector(min_heights));
+        add(std::move(result));
+    }
+
+    // the patches of the chunks in render distance, built the way main.cpp feeds them to the culling
+    if (selected("cull_below_horizon")) {
+        std::vector<terrain::horizon_patch> patches;
+        const glm::vec2 patch_size(static_cast<float>(map_width) / patch_numbers,
+                                   static_cast<float>(map_height) / patch_numbers);
+        std::vector<float> chunk_heights(texel_count), min_heights, max_heights;
+        float ground = 0.0f;
+
+        for (int x = -render_distance; x <= render_distance; ++x) {
+            for (int y = -render_distance; y <= render_distance; ++y) {
+                terrain::get_height_map(chunk_heights, perlin, texture_width, texture_height, scale, layer_count,
+                                        static_cast<float>(x), static_cast<float>(y));
+                terrain::get_patch_height_bounds(min_heights, max_heights, chunk_heights, texture_width,
+                                                 texture_height, patch_numbers);
+                if (x == 0 && y == 0)
+                    ground = chunk_heights[texel_count / 2] * terrain_height - terrain_height / 3.0f;
+
+                glm::vec2 chunk_corner(static_cast<float>(x * map_width) - map_width * 0.5f,
+                                       static_cast<float>(y * map_height) - map_height * 0.5f);
+                for (int i = 0; i < patch_numbers; ++i) {
+                    for (int j = 0; j < patch_numbers; ++j) {
+                        int patch = i * patch_numbers + j;
+                        glm::vec2 min_corner = chunk_corner + glm::vec2(i, j) * patch_size;
+                        patches.push_back({
+                                min_corner, min_corner + patch_size,
+                                min_heights[patch] * terrain_height - terrain_height / 3.0f,
+                                max_heights[patch] * terrain_height - terrain_height / 3.0f
+                        });
+                    }
+                }
+            }
+        }
+
+        // just above the ground at the center of the chunk at the origin
+        glm::vec3 camera(0.0f, ground + 20.0f, 0.0f);
+        std::vector<unsigned char> visible;
+        std::size_t culled = 0;
+        benchmark_result result = run_benchmark("cull_below_horizon", patches.size(), min_time, [&]() {
+            culled = terrain::cull_below_horizon(patches, camera, visible);
+        });
+        result.checksum = hash_vector(visible) ^ culled;
+        add(std::move(result));
+    }
+
+#pragma endregion
+
+    if (output_path.empty()) {
+        write_results(std::cout, results, min_time);
+        return 0;
+    }
+
+    std::ofstream file(output_path);
+    if (!file) {
+        std::cerr << "Failed to open file: " << output_path << std::endl;
+        return -1;
+    }
+    write_results(file, results, min_time);
+    return 0;
+}
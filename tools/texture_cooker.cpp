@@ -0,0 +1,242 @@
+//
+// Offline cooker: converts the images under assets/images into .ctex files next to them,
+// with the whole mip chain block compressed. PNG normal maps (*_nor.png) become BC5,
+// other PNGs BC7 and HDR images BC6H plus the irradiance spherical harmonics as metadata.
+//
+// usage: texture_cooker [images directory] [--force]
+//
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include "../utilities/bc_encoder.h"
+#include "../utilities/cooked_texture.h"
+#include "../utilities/hdr_decoder.h"
+#include "../utilities/spherical_harmonics.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    std::mutex output_mutex;
+
+    /**
+     * Half the size of an image with a 2x2 box filter, odd edges repeat the last pixel
+     * @tparam value_type channel type
+     * @param source pixels of the larger level
+     * @param width width of the larger level
+     * @param height height of the larger level
+     * @param channels channels per pixel
+     * @return pixels of the next level
+     */
+    template<typename value_type>
+    std::vector<value_type>
+    downsample(const std::vector<value_type> &source, int width, int height, int channels) {
+        int next_width = std::max(1, width / 2);
+        int next_height = std::max(1, height / 2);
+        std::vector<value_type> target(static_cast<std::size_t>(next_width) * next_height * channels);
+
+        for (int y = 0; y < next_height; ++y) {
+            int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < next_width; ++x) {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < channels; ++c) {
+                    float sum = static_cast<float>(source[(static_cast<std::size_t>(y0) * width + x0) * channels + c]) +
+                                static_cast<float>(source[(static_cast<std::size_t>(y0) * width + x1) * channels + c]) +
+                                static_cast<float>(source[(static_cast<std::size_t>(y1) * width + x0) * channels + c]) +
+                                static_cast<float>(source[(static_cast<std::size_t>(y1) * width + x1) * channels + c]);
+                    if constexpr (std::is_integral_v<value_type>)
+                        target[(static_cast<std::size_t>(y) * next_width + x) * channels + c] =
+                                static_cast<value_type>(sum / 4.0f + 0.5f);
+                    else
+                        target[(static_cast<std::size_t>(y) * next_width + x) * channels + c] = sum / 4.0f;
+                }
+            }
+        }
+        return target;
+    }
+
+    // unit length again after filtering, then only x and y are kept for BC5
+    std::vector<unsigned char>
+    normals_to_rg(const std::vector<float> &normals) {
+        std::vector<unsigned char> rg(normals.size() / 3 * 2);
+        for (std::size_t i = 0; i < normals.size() / 3; ++i) {
+            float x = normals[i * 3], y = normals[i * 3 + 1], z = normals[i * 3 + 2];
+            float length = std::sqrt(x * x + y * y + z * z);
+            if (length < 1e-6f) {
+                x = y = 0.0f;
+                length = 1.0f;
+            }
+            rg[i * 2] = static_cast<unsigned char>(std::clamp((x / length * 0.5f + 0.5f) * 255.0f + 0.5f, 0.0f, 255.0f));
+            rg[i * 2 + 1] = static_cast<unsigned char>(
+                    std::clamp((y / length * 0.5f + 0.5f) * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+        return rg;
+    }
+
+    utilities::cooked_texture
+    cook_color(const std::string &path) {
+        int width, height, channels;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (data == nullptr)
+            throw std::runtime_error("Texture failed to load at path: " + path);
+        std::vector<unsigned char> pixels(data, data + static_cast<std::size_t>(width) * height * 4);
+        stbi_image_free(data);
+
+        utilities::cooked_texture texture;
+        texture.format = utilities::cooked_format::bc7;
+        while (true) {
+            texture.levels.push_back({width, height, utilities::encode_bc7(pixels.data(), width, height)});
+            if (width == 1 && height == 1) break;
+            pixels = downsample(pixels, width, height, 4);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return texture;
+    }
+
+    utilities::cooked_texture
+    cook_normal(const std::string &path) {
+        int width, height, channels;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 3);
+        if (data == nullptr)
+            throw std::runtime_error("Texture failed to load at path: " + path);
+
+        // filter the mips on the decoded vectors instead of the stored bytes
+        std::vector<float> normals(static_cast<std::size_t>(width) * height * 3);
+        for (std::size_t i = 0; i < normals.size(); ++i)
+            normals[i] = static_cast<float>(data[i]) / 255.0f * 2.0f - 1.0f;
+        stbi_image_free(data);
+
+        utilities::cooked_texture texture;
+        texture.format = utilities::cooked_format::bc5;
+        while (true) {
+            auto rg = normals_to_rg(normals);
+            texture.levels.push_back({width, height, utilities::encode_bc5(rg.data(), width, height)});
+            if (width == 1 && height == 1) break;
+            normals = downsample(normals, width, height, 3);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return texture;
+    }
+
+    // the sky is only sampled at its base level, so no mips, but the spherical harmonics come along
+    utilities::cooked_texture
+    cook_hdr(const std::string &path) {
+        utilities::hdr_decoder decoder(path);
+        int width = decoder.get_width();
+        int height = decoder.get_height();
+
+        std::vector<float> pixels(static_cast<std::size_t>(width) * height * 3);
+        std::vector<std::uint16_t> half(decoder.half_size() / sizeof(std::uint16_t));
+        utilities::sh9_projector projector(width, height);
+
+        decoder.decode(half.data(), [&](int row, const float *rgb, int row_width, int) {
+            std::copy(rgb, rgb + row_width * 3, pixels.begin() + static_cast<std::ptrdiff_t>(row) * row_width * 3);
+            projector.add_row(row, rgb, 3);
+        });
+
+        utilities::cooked_texture texture;
+        texture.format = utilities::cooked_format::bc6h;
+        texture.levels.push_back({width, height, utilities::encode_bc6h(pixels.data(), width, height)});
+        for (auto &coefficient: projector.coefficients())
+            texture.metadata.insert(texture.metadata.end(), {coefficient.x, coefficient.y, coefficient.z});
+        return texture;
+    }
+
+    void
+    cook(const std::filesystem::path &source) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::string extension = source.extension().string();
+        std::string stem = source.stem().string();
+
+        utilities::cooked_texture texture;
+        if (extension == ".hdr")
+            texture = cook_hdr(source.string());
+        else if (stem.ends_with("_nor"))
+            texture = cook_normal(source.string());
+        else
+            texture = cook_color(source.string());
+
+        std::string target = utilities::cooked_texture_path(source.string());
+        utilities::write_cooked_texture(target, texture);
+
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cout << "cooked " << target << " (" << texture.levels.size() << " levels) in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::filesystem::path images_directory = "../assets/images";
+    bool force = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--force")
+            force = true;
+        else
+            images_directory = argument;
+    }
+
+    // the viewer loads its textures flipped, the cooked ones have to match
+    stbi_set_flip_vertically_on_load(true);
+
+    std::vector<std::filesystem::path> sources;
+    try {
+        for (auto &entry: std::filesystem::recursive_directory_iterator(images_directory)) {
+            if (!entry.is_regular_file())
+                continue;
+            auto extension = entry.path().extension();
+            if (extension != ".png" && extension != ".hdr")
+                continue;
+
+            // skip images whose cooked file is up to date
+            std::filesystem::path target = utilities::cooked_texture_path(entry.path().string());
+            if (!force && std::filesystem::exists(target) &&
+                std::filesystem::last_write_time(target) >= entry.last_write_time())
+                continue;
+
+            sources.push_back(entry.path());
+        }
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    std::cout << sources.size() << " images to cook in " << images_directory << std::endl;
+
+    // one image per thread
+    std::atomic<std::size_t> next_source = 0;
+    std::atomic<bool> failed = false;
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < std::max(1u, std::thread::hardware_concurrency()); ++t) {
+        workers.emplace_back([&]() {
+            for (std::size_t i = next_source++; i < sources.size(); i = next_source++) {
+                try {
+                    cook(sources[i]);
+                } catch (std::exception &e) {
+                    std::lock_guard<std::mutex> lock(output_mutex);
+                    std::cerr << e.what() << std::endl;
+                    failed = true;
+                }
+            }
+        });
+    }
+
+    for (auto &worker: workers)
+        worker.join();
+
+    return failed ? -1 : 0;
+}
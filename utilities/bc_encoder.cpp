@@ -0,0 +1,476 @@
+#include "bc_encoder.h"
+#include "hdr_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace utilities {
+
+    namespace {
+        // interpolation weights of 4 bit indices, shared by BC7 and BC6H
+        constexpr int WEIGHTS_4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        // the largest finite half float
+        constexpr int HALF_MAX = 0x7bff;
+
+        // bits are written from the least significant bit of the first byte on
+        struct block_writer {
+            unsigned char *bytes;
+            int position = 0;
+
+            void
+            write(std::uint32_t value, int bit_count) {
+                for (int i = 0; i < bit_count; ++i, ++position) {
+                    if ((value >> i) & 1u)
+                        bytes[position >> 3] |= static_cast<unsigned char>(1u << (position & 7));
+                }
+            }
+        };
+
+        /**
+         * Endpoints of the line that fits the pixels best, found along the principal axis of their covariance
+         * @tparam channels components per pixel
+         * @param pixels 16 pixels
+         * @param low output endpoint
+         * @param high output endpoint
+         */
+        template<int channels>
+        void
+        principal_endpoints(const std::array<std::array<float, channels>, 16> &pixels,
+                            std::array<float, channels> &low, std::array<float, channels> &high) {
+            std::array<float, channels> mean{};
+            std::array<float, channels> min_value, max_value;
+            min_value.fill(std::numeric_limits<float>::max());
+            max_value.fill(std::numeric_limits<float>::lowest());
+
+            for (auto &pixel: pixels) {
+                for (int c = 0; c < channels; ++c) {
+                    mean[c] += pixel[c] / 16.0f;
+                    min_value[c] = std::min(min_value[c], pixel[c]);
+                    max_value[c] = std::max(max_value[c], pixel[c]);
+                }
+            }
+
+            float covariance[channels][channels] = {};
+            for (auto &pixel: pixels) {
+                for (int i = 0; i < channels; ++i) {
+                    for (int j = 0; j < channels; ++j)
+                        covariance[i][j] += (pixel[i] - mean[i]) * (pixel[j] - mean[j]);
+                }
+            }
+
+            // power iteration, starting along the diagonal of the bounding box
+            std::array<float, channels> axis;
+            for (int c = 0; c < channels; ++c)
+                axis[c] = max_value[c] - min_value[c];
+
+            for (int iteration = 0; iteration < 8; ++iteration) {
+                std::array<float, channels> next{};
+                float length = 0.0f;
+                for (int i = 0; i < channels; ++i) {
+                    for (int j = 0; j < channels; ++j)
+                        next[i] += covariance[i][j] * axis[j];
+                    length += next[i] * next[i];
+                }
+                if (length < 1e-12f)
+                    break;
+                length = std::sqrt(length);
+                for (int c = 0; c < channels; ++c)
+                    axis[c] = next[c] / length;
+            }
+
+            float length = 0.0f;
+            for (int c = 0; c < channels; ++c)
+                length += axis[c] * axis[c];
+            if (length < 1e-12f) {
+                // a flat block
+                low = mean;
+                high = mean;
+                return;
+            }
+            length = std::sqrt(length);
+            for (int c = 0; c < channels; ++c)
+                axis[c] /= length;
+
+            float t_min = std::numeric_limits<float>::max();
+            float t_max = std::numeric_limits<float>::lowest();
+            for (auto &pixel: pixels) {
+                float t = 0.0f;
+                for (int c = 0; c < channels; ++c)
+                    t += (pixel[c] - mean[c]) * axis[c];
+                t_min = std::min(t_min, t);
+                t_max = std::max(t_max, t);
+            }
+
+            for (int c = 0; c < channels; ++c) {
+                low[c] = mean[c] + axis[c] * t_min;
+                high[c] = mean[c] + axis[c] * t_max;
+            }
+        }
+
+        /**
+         * Least squares endpoints for fixed indices
+         * @return false if the indices do not span a line
+         */
+        template<int channels>
+        bool
+        refit_endpoints(const std::array<std::array<float, channels>, 16> &pixels, const int *indices,
+                        std::array<float, channels> &low, std::array<float, channels> &high) {
+            float a = 0.0f, b = 0.0f, c = 0.0f;
+            std::array<float, channels> x0{}, x1{};
+
+            for (int i = 0; i < 16; ++i) {
+                float w = static_cast<float>(WEIGHTS_4[indices[i]]) / 64.0f;
+                a += (1.0f - w) * (1.0f - w);
+                b += w * (1.0f - w);
+                c += w * w;
+                for (int k = 0; k < channels; ++k) {
+                    x0[k] += (1.0f - w) * pixels[i][k];
+                    x1[k] += w * pixels[i][k];
+                }
+            }
+
+            float determinant = a * c - b * b;
+            if (std::abs(determinant) < 1e-6f)
+                return false;
+
+            for (int k = 0; k < channels; ++k) {
+                low[k] = (c * x0[k] - b * x1[k]) / determinant;
+                high[k] = (a * x1[k] - b * x0[k]) / determinant;
+            }
+            return true;
+        }
+
+#pragma region bc7
+
+        struct bc7_endpoints {
+            // 7 bit values and the p-bit of both endpoints
+            int color[2][4];
+            int p_bit[2];
+        };
+
+        // quantize one endpoint to 7 bits per channel plus the shared p-bit, trying both p-bits
+        void
+        quantize_bc7_endpoint(const std::array<float, 4> &value, int *color, int &p_bit) {
+            float best_error = std::numeric_limits<float>::max();
+            for (int p = 0; p < 2; ++p) {
+                int candidate[4];
+                float error = 0.0f;
+                for (int c = 0; c < 4; ++c) {
+                    float v = std::clamp(value[c], 0.0f, 255.0f);
+                    candidate[c] = std::clamp(static_cast<int>(std::lround((v - static_cast<float>(p)) / 2.0f)),
+                                              0, 127);
+                    float difference = static_cast<float>(candidate[c] * 2 + p) - v;
+                    error += difference * difference;
+                }
+                if (error < best_error) {
+                    best_error = error;
+                    std::copy(candidate, candidate + 4, color);
+                    p_bit = p;
+                }
+            }
+        }
+
+        // choose the nearest palette entry for every pixel
+        float
+        index_bc7_block(const std::array<std::array<float, 4>, 16> &pixels, const bc7_endpoints &endpoints,
+                        int *indices) {
+            int palette[16][4];
+            for (int c = 0; c < 4; ++c) {
+                int e0 = (endpoints.color[0][c] << 1) | endpoints.p_bit[0];
+                int e1 = (endpoints.color[1][c] << 1) | endpoints.p_bit[1];
+                for (int i = 0; i < 16; ++i)
+                    palette[i][c] = ((64 - WEIGHTS_4[i]) * e0 + WEIGHTS_4[i] * e1 + 32) >> 6;
+            }
+
+            float total_error = 0.0f;
+            for (int p = 0; p < 16; ++p) {
+                float best_error = std::numeric_limits<float>::max();
+                for (int i = 0; i < 16; ++i) {
+                    float error = 0.0f;
+                    for (int c = 0; c < 4; ++c) {
+                        float difference = static_cast<float>(palette[i][c]) - pixels[p][c];
+                        error += difference * difference;
+                    }
+                    if (error < best_error) {
+                        best_error = error;
+                        indices[p] = i;
+                    }
+                }
+                total_error += best_error;
+            }
+            return total_error;
+        }
+
+        void
+        encode_bc7_block(const std::array<std::array<float, 4>, 16> &pixels, unsigned char *block) {
+            std::array<float, 4> low, high;
+            principal_endpoints<4>(pixels, low, high);
+
+            bc7_endpoints endpoints{};
+            quantize_bc7_endpoint(low, endpoints.color[0], endpoints.p_bit[0]);
+            quantize_bc7_endpoint(high, endpoints.color[1], endpoints.p_bit[1]);
+
+            int indices[16];
+            float error = index_bc7_block(pixels, endpoints, indices);
+
+            // one least squares pass over the chosen indices
+            if (error > 0.0f && refit_endpoints<4>(pixels, indices, low, high)) {
+                bc7_endpoints refit{};
+                quantize_bc7_endpoint(low, refit.color[0], refit.p_bit[0]);
+                quantize_bc7_endpoint(high, refit.color[1], refit.p_bit[1]);
+
+                int refit_indices[16];
+                if (index_bc7_block(pixels, refit, refit_indices) < error) {
+                    endpoints = refit;
+                    std::copy(refit_indices, refit_indices + 16, indices);
+                }
+            }
+
+            // the most significant bit of the first index is implicitly 0
+            if (indices[0] & 8) {
+                std::swap(endpoints.color[0], endpoints.color[1]);
+                std::swap(endpoints.p_bit[0], endpoints.p_bit[1]);
+                for (int &index: indices)
+                    index = 15 - index;
+            }
+
+            std::memset(block, 0, BC_BLOCK_BYTES);
+            block_writer writer{block};
+            // mode 6
+            writer.write(1u << 6, 7);
+            for (int c = 0; c < 4; ++c) {
+                writer.write(endpoints.color[0][c], 7);
+                writer.write(endpoints.color[1][c], 7);
+            }
+            writer.write(endpoints.p_bit[0], 1);
+            writer.write(endpoints.p_bit[1], 1);
+            writer.write(indices[0], 3);
+            for (int i = 1; i < 16; ++i)
+                writer.write(indices[i], 4);
+        }
+
+#pragma endregion
+
+#pragma region bc5
+
+        // one BC4 channel in 8 bytes, always in the 8 value mode
+        void
+        encode_bc4_block(const unsigned char *values, unsigned char *block) {
+            int max_value = *std::max_element(values, values + 16);
+            int min_value = *std::min_element(values, values + 16);
+
+            float palette[8];
+            palette[0] = static_cast<float>(max_value);
+            palette[1] = static_cast<float>(min_value);
+            for (int i = 2; i < 8; ++i)
+                palette[i] = static_cast<float>((8 - i) * max_value + (i - 1) * min_value) / 7.0f;
+
+            std::memset(block, 0, 8);
+            block[0] = static_cast<unsigned char>(max_value);
+            block[1] = static_cast<unsigned char>(min_value);
+
+            block_writer writer{block, 16};
+            for (int p = 0; p < 16; ++p) {
+                int best_index = 0;
+                float best_error = std::numeric_limits<float>::max();
+                for (int i = 0; i < 8; ++i) {
+                    float error = std::abs(palette[i] - static_cast<float>(values[p]));
+                    if (error < best_error) {
+                        best_error = error;
+                        best_index = i;
+                    }
+                }
+                writer.write(best_index, 3);
+            }
+        }
+
+#pragma endregion
+
+#pragma region bc6h
+
+        // 10 bit endpoint to the 16 bit range the decoder interpolates in
+        inline int
+        unquantize_bc6h(int value) {
+            if (value == 0) return 0;
+            if (value == 1023) return 0xffff;
+            return ((value << 16) + 0x8000) >> 10;
+        }
+
+        // inverse of unquantize_bc6h followed by the final scale to half float bits
+        inline int
+        quantize_bc6h(float half_bits) {
+            float unquantized = std::clamp(half_bits, 0.0f, static_cast<float>(HALF_MAX)) * 64.0f / 31.0f;
+            return std::clamp(static_cast<int>(std::lround((unquantized - 32.0f) / 64.0f)), 0, 1023);
+        }
+
+        // the error is measured on the half float bits, which is close to a logarithmic scale
+        float
+        index_bc6h_block(const std::array<std::array<float, 3>, 16> &pixels, const int endpoints[2][3],
+                         int *indices) {
+            int palette[16][3];
+            for (int c = 0; c < 3; ++c) {
+                int e0 = unquantize_bc6h(endpoints[0][c]);
+                int e1 = unquantize_bc6h(endpoints[1][c]);
+                for (int i = 0; i < 16; ++i) {
+                    int interpolated = ((64 - WEIGHTS_4[i]) * e0 + WEIGHTS_4[i] * e1 + 32) >> 6;
+                    palette[i][c] = (interpolated * 31) >> 6;
+                }
+            }
+
+            float total_error = 0.0f;
+            for (int p = 0; p < 16; ++p) {
+                float best_error = std::numeric_limits<float>::max();
+                for (int i = 0; i < 16; ++i) {
+                    float error = 0.0f;
+                    for (int c = 0; c < 3; ++c) {
+                        float difference = static_cast<float>(palette[i][c]) - pixels[p][c];
+                        error += difference * difference;
+                    }
+                    if (error < best_error) {
+                        best_error = error;
+                        indices[p] = i;
+                    }
+                }
+                total_error += best_error;
+            }
+            return total_error;
+        }
+
+        void
+        encode_bc6h_block(const std::array<std::array<float, 3>, 16> &pixels, unsigned char *block) {
+            std::array<float, 3> low, high;
+            principal_endpoints<3>(pixels, low, high);
+
+            int endpoints[2][3];
+            for (int c = 0; c < 3; ++c) {
+                endpoints[0][c] = quantize_bc6h(low[c]);
+                endpoints[1][c] = quantize_bc6h(high[c]);
+            }
+
+            int indices[16];
+            float error = index_bc6h_block(pixels, endpoints, indices);
+
+            if (error > 0.0f && refit_endpoints<3>(pixels, indices, low, high)) {
+                int refit[2][3];
+                for (int c = 0; c < 3; ++c) {
+                    refit[0][c] = quantize_bc6h(low[c]);
+                    refit[1][c] = quantize_bc6h(high[c]);
+                }
+
+                int refit_indices[16];
+                if (index_bc6h_block(pixels, refit, refit_indices) < error) {
+                    std::memcpy(endpoints, refit, sizeof(endpoints));
+                    std::copy(refit_indices, refit_indices + 16, indices);
+                }
+            }
+
+            // the most significant bit of the first index is implicitly 0
+            if (indices[0] & 8) {
+                std::swap(endpoints[0], endpoints[1]);
+                for (int &index: indices)
+                    index = 15 - index;
+            }
+
+            std::memset(block, 0, BC_BLOCK_BYTES);
+            block_writer writer{block};
+            // mode 11
+            writer.write(0x03, 5);
+            for (auto &endpoint: endpoints) {
+                for (int c = 0; c < 3; ++c)
+                    writer.write(endpoint[c], 10);
+            }
+            writer.write(indices[0], 3);
+            for (int i = 1; i < 16; ++i)
+                writer.write(indices[i], 4);
+        }
+
+#pragma endregion
+
+        /**
+         * Run a block encoder over an image, pixels outside of the image repeat the edge
+         * @param block_bytes compressed bytes per block
+         * @param load_block fills the pixels of a block from its top left pixel coordinates
+         * @param encode_block compresses the loaded block
+         */
+        template<typename block_type, typename load_function, typename encode_function>
+        std::vector<unsigned char>
+        encode_blocks(int width, int height, int block_bytes, load_function load_block, encode_function encode_block) {
+            int blocks_x = (width + 3) / 4;
+            int blocks_y = (height + 3) / 4;
+            std::vector<unsigned char> result(static_cast<std::size_t>(blocks_x) * blocks_y * block_bytes);
+
+            block_type pixels{};
+            for (int by = 0; by < blocks_y; ++by) {
+                for (int bx = 0; bx < blocks_x; ++bx) {
+                    load_block(bx * 4, by * 4, pixels);
+                    encode_block(pixels, result.data() + (static_cast<std::size_t>(by) * blocks_x + bx) * block_bytes);
+                }
+            }
+            return result;
+        }
+    }
+
+    std::vector<unsigned char>
+    encode_bc7(const unsigned char *rgba, int width, int height) {
+        using block_type = std::array<std::array<float, 4>, 16>;
+        return encode_blocks<block_type>(
+                width, height, BC_BLOCK_BYTES,
+                [&](int x0, int y0, block_type &pixels) {
+                    for (int i = 0; i < 16; ++i) {
+                        int x = std::min(x0 + i % 4, width - 1);
+                        int y = std::min(y0 + i / 4, height - 1);
+                        const unsigned char *pixel = rgba + (static_cast<std::size_t>(y) * width + x) * 4;
+                        for (int c = 0; c < 4; ++c)
+                            pixels[i][c] = static_cast<float>(pixel[c]);
+                    }
+                },
+                encode_bc7_block);
+    }
+
+    std::vector<unsigned char>
+    encode_bc5(const unsigned char *rg, int width, int height) {
+        using block_type = std::array<std::array<unsigned char, 16>, 2>;
+        return encode_blocks<block_type>(
+                width, height, BC_BLOCK_BYTES,
+                [&](int x0, int y0, block_type &channels) {
+                    for (int i = 0; i < 16; ++i) {
+                        int x = std::min(x0 + i % 4, width - 1);
+                        int y = std::min(y0 + i / 4, height - 1);
+                        const unsigned char *pixel = rg + (static_cast<std::size_t>(y) * width + x) * 2;
+                        channels[0][i] = pixel[0];
+                        channels[1][i] = pixel[1];
+                    }
+                },
+                [](const block_type &channels, unsigned char *block) {
+                    encode_bc4_block(channels[0].data(), block);
+                    encode_bc4_block(channels[1].data(), block + 8);
+                });
+    }
+
+    std::vector<unsigned char>
+    encode_bc6h(const float *rgb, int width, int height) {
+        using block_type = std::array<std::array<float, 3>, 16>;
+        return encode_blocks<block_type>(
+                width, height, BC_BLOCK_BYTES,
+                [&](int x0, int y0, block_type &pixels) {
+                    for (int i = 0; i < 16; ++i) {
+                        int x = std::min(x0 + i % 4, width - 1);
+                        int y = std::min(y0 + i / 4, height - 1);
+                        const float *pixel = rgb + (static_cast<std::size_t>(y) * width + x) * 3;
+                        // the unsigned format has no negative values
+                        float clamped[3];
+                        for (int c = 0; c < 3; ++c)
+                            clamped[c] = std::max(pixel[c], 0.0f);
+                        std::uint16_t half[3];
+                        float_to_half(clamped, half, 3);
+                        for (int c = 0; c < 3; ++c)
+                            pixels[i][c] = static_cast<float>(std::min<int>(half[c], HALF_MAX));
+                    }
+                },
+                encode_bc6h_block);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef INC_3DPERLINMAP_BC_ENCODER_H
+#define INC_3DPERLINMAP_BC_ENCODER_H
+
+#include <cstdint>
+#include <vector>
+
+namespace utilities {
+
+    // every format stores a 4x4 block of pixels in 16 bytes
+    constexpr int BC_BLOCK_BYTES = 16;
+
+    /**
+     * BC7 with mode 6 only: one subset, rgba endpoints with 7 bits and a p-bit, 4 bit indices.
+     * Good enough for the colour and arm maps, which have smooth gradients inside a block.
+     */
+    std::vector<unsigned char>
+    encode_bc7(const unsigned char *rgba, int width, int height);
+
+    /**
+     * BC5: two independent BC4 channels, for tangent space normals stored as x and y
+     */
+    std::vector<unsigned char>
+    encode_bc5(const unsigned char *rg, int width, int height);
+
+    /**
+     * BC6H unsigned with mode 11 only: one region, 10 bit endpoints, 4 bit indices
+     */
+    std::vector<unsigned char>
+    encode_bc6h(const float *rgb, int width, int height);
+
+    // bytes of a compressed image, partial blocks at the edges count as whole blocks
+    inline std::size_t
+    bc_image_size(int width, int height) {
+        return static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4) * BC_BLOCK_BYTES;
+    }
+}
+
+#endif //INC_3DPERLINMAP_BC_ENCODER_H
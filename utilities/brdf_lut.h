@@ -0,0 +1,100 @@
+#ifndef INC_3DPERLINMAP_BRDF_LUT_H
+#define INC_3DPERLINMAP_BRDF_LUT_H
+
+#include <array>
+
+// resolution and importance samples per texel of the split-sum lut baked by tools/brdf_lut_baker, set by the build
+#ifndef BRDF_LUT_RESOLUTION
+#define BRDF_LUT_RESOLUTION 512
+#endif
+#ifndef BRDF_LUT_SAMPLE_COUNT
+#define BRDF_LUT_SAMPLE_COUNT 1024
+#endif
+
+namespace utilities::brdf {
+
+    constexpr int lut_resolution = BRDF_LUT_RESOLUTION;
+    constexpr int lut_sample_count = BRDF_LUT_SAMPLE_COUNT;
+
+    // interleaved rg values row by row, NdotV along x and roughness along y. baked at build time
+    // and compiled into the read-only data of the executable
+    inline constexpr std::array<float, lut_resolution * lut_resolution * 2> lut{
+#include "brdf_lut_data.inc"
+    };
+
+    /**
+     * Read the lut like the linear filtered texture with GL_CLAMP_TO_EDGE
+     * @param n_dot_v texture coordinate x
+     * @param roughness texture coordinate y
+     * @param channel 0 for the scale, 1 for the bias of F0
+     * @return filtered value
+     */
+    constexpr float
+    sample_lut(float n_dot_v, float roughness, int channel) {
+        auto clamp = [](float value, float high) { return value < 0.0f ? 0.0f : value > high ? high : value; };
+        float x = clamp(n_dot_v * lut_resolution - 0.5f, static_cast<float>(lut_resolution - 1));
+        float y = clamp(roughness * lut_resolution - 0.5f, static_cast<float>(lut_resolution - 1));
+        int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+        int x1 = x0 + 1 < lut_resolution ? x0 + 1 : x0;
+        int y1 = y0 + 1 < lut_resolution ? y0 + 1 : y0;
+        float u = x - static_cast<float>(x0), v = y - static_cast<float>(y0);
+
+        auto texel = [&](int tx, int ty) { return lut[(ty * lut_resolution + tx) * 2 + channel]; };
+        float bottom = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * u;
+        float top = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * u;
+        return bottom + (top - bottom) * v;
+    }
+
+    // texels of the 512x512 lut BRDF.frag renders with 1024 samples, evaluated with its float arithmetic:
+    // x, y, scale, bias
+    constexpr float reference_resolution = 512.0f;
+    constexpr int reference_sample_count = 1024;
+    constexpr float reference_texels[][4] = {
+            {64,  64,  0.448612f, 0.444790f},
+            {256, 256, 0.726845f, 0.018360f},
+            {448, 64,  0.997621f, 0.000035f},
+            {128, 384, 0.593093f, 0.020500f},
+            {480, 480, 0.376228f, 0.000120f},
+            {32,  256, 0.601204f, 0.109792f},
+            {256, 32,  0.965089f, 0.030857f},
+            {400, 200, 0.917142f, 0.001411f},
+    };
+
+    /**
+     * @return largest difference of the baked lut to the reference texels of BRDF.frag
+     */
+    constexpr float
+    reference_difference() {
+        float largest = 0.0f;
+        for (const auto &reference: reference_texels) {
+            float n_dot_v = (reference[0] + 0.5f) / reference_resolution;
+            float roughness = (reference[1] + 0.5f) / reference_resolution;
+            for (int channel = 0; channel < 2; ++channel) {
+                float difference = sample_lut(n_dot_v, roughness, channel) - reference[2 + channel];
+                difference = difference < 0.0f ? -difference : difference;
+                largest = difference > largest ? difference : largest;
+            }
+        }
+        return largest;
+    }
+
+    /**
+     * The filtering of a coarser lut and the sampling noise of another sample count move the texels away from
+     * the reference. Both terms were measured over luts of 64 to 512 texels and 128 to 4096 samples, at the
+     * defaults the bound is well below a step of the GL_RG16F texture
+     * @return largest difference to the reference texels a correct lut of this resolution and sample count has
+     */
+    constexpr float
+    reference_tolerance() {
+        float filtering = 0.025f / static_cast<float>(lut_resolution);
+        // the noise of the samples is about 8 / sample count, and the reference carries its own
+        float sampling = lut_sample_count == reference_sample_count
+                         ? 0.0f : 10.0f / static_cast<float>(lut_sample_count) + 0.01f;
+        return filtering + sampling;
+    }
+
+    static_assert(reference_difference() < reference_tolerance(),
+                  "the baked brdf lut differs from BRDF.frag, check BRDF_LUT_RESOLUTION and BRDF_LUT_SAMPLE_COUNT");
+}
+
+#endif //INC_3DPERLINMAP_BRDF_LUT_H
@@ -75,6 +75,23 @@ namespace utilities {
         update_camera_vectors();
     }
 
+    /**
+     * Place the camera directly, used to replay a recorded camera path
+     * @param new_position
+     * @param new_yaw
+     * @param new_pitch
+     * @param new_zoom
+     */
+    void
+    camera::set_pose(const glm::vec3 &new_position, float new_yaw, float new_pitch, float new_zoom) {
+        position = new_position;
+        yaw = new_yaw;
+        pitch = new_pitch;
+        zoom = new_zoom;
+
+        update_camera_vectors();
+    }
+
     /**
      * Calculates the front vector from the Camera's (updated) Euler Angles
      */
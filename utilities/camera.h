@@ -73,6 +73,8 @@ namespace utilities {
 
         void process_mouse_scroll(float y_offset);
 
+        void set_pose(const glm::vec3 &new_position, float new_yaw, float new_pitch, float new_zoom);
+
     private:
         void update_camera_vectors();
     };
@@ -0,0 +1,167 @@
+#include "camera_path.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+namespace utilities {
+
+    namespace {
+        constexpr char PATH_MAGIC[4] = {'C', 'P', 'T', 'H'};
+        constexpr std::uint32_t PATH_VERSION = 1;
+        // magic, version and frame count, then position, yaw, pitch and zoom per frame
+        constexpr std::size_t PATH_HEADER_SIZE = sizeof(PATH_MAGIC) + 2 * sizeof(std::uint32_t);
+        constexpr std::size_t PATH_FRAME_SIZE = 6 * sizeof(float);
+
+        // nearest rank percentile of sorted values
+        float
+        percentile(const std::vector<float> &sorted_values, float fraction) {
+            auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<float>(sorted_values.size())));
+            return sorted_values[std::clamp<std::size_t>(rank, 1, sorted_values.size()) - 1];
+        }
+    }
+
+    /**
+     * Write a recorded camera path, six floats per frame
+     * @param path target file
+     * @param poses one per frame
+     */
+    void
+    write_camera_path(const std::string &path, const std::vector<camera_pose> &poses) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + path);
+
+        auto frame_count = static_cast<std::uint32_t>(poses.size());
+        file.write(PATH_MAGIC, sizeof(PATH_MAGIC));
+        file.write(reinterpret_cast<const char *>(&PATH_VERSION), sizeof(PATH_VERSION));
+        file.write(reinterpret_cast<const char *>(&frame_count), sizeof(frame_count));
+
+        for (auto &pose: poses) {
+            const float values[6] = {pose.position.x, pose.position.y, pose.position.z, pose.yaw, pose.pitch,
+                                     pose.zoom};
+            file.write(reinterpret_cast<const char *>(values), sizeof(values));
+        }
+
+        if (!file)
+            throw std::runtime_error("Failed to write file: " + path);
+    }
+
+    /**
+     * Read a camera path written by write_camera_path
+     * @param path recorded file
+     * @return one pose per frame
+     */
+    std::vector<camera_pose>
+    read_camera_path(const std::string &path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + path);
+        auto file_size = static_cast<std::size_t>(file.tellg());
+        file.seekg(0);
+
+        char magic[4];
+        std::uint32_t version = 0;
+        std::uint32_t frame_count = 0;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char *>(&version), sizeof(version));
+        if (!file || !std::equal(magic, magic + 4, PATH_MAGIC) || version != PATH_VERSION)
+            throw std::runtime_error("not a camera path of this version: " + path);
+        file.read(reinterpret_cast<char *>(&frame_count), sizeof(frame_count));
+        // a damaged count would allocate far more than the file holds
+        if (!file || frame_count > (file_size - PATH_HEADER_SIZE) / PATH_FRAME_SIZE)
+            throw std::runtime_error("truncated camera path: " + path);
+
+        std::vector<camera_pose> poses(frame_count);
+        for (auto &pose: poses) {
+            float values[6];
+            file.read(reinterpret_cast<char *>(values), sizeof(values));
+            pose = {glm::vec3(values[0], values[1], values[2]), values[3], values[4], values[5]};
+        }
+
+        if (!file)
+            throw std::runtime_error("truncated camera path: " + path);
+
+        return poses;
+    }
+
+    /**
+     * Summarize a replay
+     * @param frame_times time of every frame
+     * @param chunk_latencies time every chunk took from entering the render distance to being drawable
+     * @param hitch_factor a frame is a hitch when it takes longer than this times the median
+     * @param latency_bucket_count buckets of the chunk latency histogram
+     * @return report
+     */
+    replay_report
+    make_replay_report(std::vector<float> frame_times, const std::vector<float> &chunk_latencies,
+                       float hitch_factor, std::size_t latency_bucket_count) {
+        replay_report report;
+        report.frame_count = frame_times.size();
+        report.chunk_count = chunk_latencies.size();
+        report.chunk_latency_histogram.assign(latency_bucket_count, 0);
+
+        for (float latency: chunk_latencies) {
+            std::size_t bucket = latency < 1.0f ? 0 : static_cast<std::size_t>(std::floor(std::log2(latency))) + 1;
+            ++report.chunk_latency_histogram[std::min(bucket, latency_bucket_count - 1)];
+            report.max_chunk_latency = std::max(report.max_chunk_latency, latency);
+        }
+
+        if (frame_times.empty()) return report;
+
+        std::sort(frame_times.begin(), frame_times.end());
+        report.mean_time = std::accumulate(frame_times.begin(), frame_times.end(), 0.0f) /
+                           static_cast<float>(frame_times.size());
+        report.p50_time = percentile(frame_times, 0.5f);
+        report.p95_time = percentile(frame_times, 0.95f);
+        report.p99_time = percentile(frame_times, 0.99f);
+        report.max_time = frame_times.back();
+        report.hitch_count = static_cast<std::size_t>(
+                frame_times.end() - std::upper_bound(frame_times.begin(), frame_times.end(),
+                                                     report.p50_time * hitch_factor));
+
+        return report;
+    }
+
+    /**
+     * Write a report as json, so runs of two builds can be compared by a script
+     * @param path target file
+     * @param report
+     * @param wait_policy how the replay waited for chunks
+     */
+    void
+    write_replay_report(const std::string &path, const replay_report &report, const std::string &wait_policy) {
+        std::ofstream file(path);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + path);
+
+        file << "{\n"
+             << "  \"wait_policy\": \"" << wait_policy << "\",\n"
+             << "  \"frame_count\": " << report.frame_count << ",\n"
+             << "  \"frame_time_ms\": {\"mean\": " << report.mean_time << ", \"p50\": " << report.p50_time
+             << ", \"p95\": " << report.p95_time << ", \"p99\": " << report.p99_time << ", \"max\": "
+             << report.max_time << "},\n"
+             << "  \"hitch_count\": " << report.hitch_count << ",\n"
+             << "  \"chunk_count\": " << report.chunk_count << ",\n"
+             << "  \"max_chunk_latency_ms\": " << report.max_chunk_latency << ",\n"
+             << "  \"chunk_latency_histogram_ms\": [";
+
+        for (std::size_t bucket = 0; bucket < report.chunk_latency_histogram.size(); ++bucket) {
+            float upper = std::ldexp(1.0f, static_cast<int>(bucket));
+            file << (bucket == 0 ? "" : ", ") << "{\"below\": ";
+            if (bucket + 1 == report.chunk_latency_histogram.size())
+                file << "null";
+            else
+                file << upper;
+            file << ", \"count\": " << report.chunk_latency_histogram[bucket] << '}';
+        }
+
+        file << "]\n}\n";
+
+        if (!file)
+            throw std::runtime_error("Failed to write file: " + path);
+    }
+}
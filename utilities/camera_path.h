@@ -0,0 +1,51 @@
+#ifndef INC_3DPERLINMAP_CAMERA_PATH_H
+#define INC_3DPERLINMAP_CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace utilities {
+
+    // state of utilities::camera in one frame, everything needed to drive it again
+    struct camera_pose {
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+        float zoom;
+    };
+
+    void
+    write_camera_path(const std::string &path, const std::vector<camera_pose> &poses);
+
+    std::vector<camera_pose>
+    read_camera_path(const std::string &path);
+
+    // frame times and chunk latencies of a replay, times in milliseconds
+    struct replay_report {
+        std::size_t frame_count = 0;
+        float mean_time = 0.0f;
+        float p50_time = 0.0f;
+        float p95_time = 0.0f;
+        float p99_time = 0.0f;
+        float max_time = 0.0f;
+        // frames taking longer than hitch_factor times the median
+        std::size_t hitch_count = 0;
+
+        // chunks by the time from entering the render distance to being drawable,
+        // bucket 0 counts those under 1 ms and bucket i those from 2^(i-1) to 2^i ms, the last one everything above
+        std::vector<std::size_t> chunk_latency_histogram;
+        std::size_t chunk_count = 0;
+        float max_chunk_latency = 0.0f;
+    };
+
+    replay_report
+    make_replay_report(std::vector<float> frame_times, const std::vector<float> &chunk_latencies,
+                       float hitch_factor = 2.0f, std::size_t latency_bucket_count = 12);
+
+    void
+    write_replay_report(const std::string &path, const replay_report &report, const std::string &wait_policy);
+}
+
+#endif //INC_3DPERLINMAP_CAMERA_PATH_H
@@ -0,0 +1,129 @@
+#include "cooked_texture.h"
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace utilities {
+
+    namespace {
+        constexpr char COOKED_MAGIC[4] = {'C', 'T', 'E', 'X'};
+        constexpr std::uint32_t COOKED_VERSION = 1;
+
+        template<typename value_type>
+        void
+        write_value(std::ofstream &file, value_type value) {
+            file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        template<typename value_type>
+        value_type
+        read_value(std::ifstream &file) {
+            value_type value{};
+            file.read(reinterpret_cast<char *>(&value), sizeof(value));
+            return value;
+        }
+    }
+
+    /**
+     * Write a cooked texture
+     * @param path target file
+     * @param texture levels from the largest to the smallest
+     */
+    void
+    write_cooked_texture(const std::string &path, const cooked_texture &texture) {
+        if (texture.levels.empty())
+            throw std::runtime_error("cooked texture without levels: " + path);
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + path);
+
+        file.write(COOKED_MAGIC, sizeof(COOKED_MAGIC));
+        write_value<std::uint32_t>(file, COOKED_VERSION);
+        write_value<std::uint32_t>(file, static_cast<std::uint32_t>(texture.format));
+        write_value<std::uint32_t>(file, texture.levels.front().width);
+        write_value<std::uint32_t>(file, texture.levels.front().height);
+        write_value<std::uint32_t>(file, static_cast<std::uint32_t>(texture.levels.size()));
+        write_value<std::uint32_t>(file, static_cast<std::uint32_t>(texture.metadata.size()));
+        file.write(reinterpret_cast<const char *>(texture.metadata.data()),
+                   static_cast<std::streamsize>(texture.metadata.size() * sizeof(float)));
+
+        for (auto &level: texture.levels) {
+            write_value<std::uint32_t>(file, static_cast<std::uint32_t>(level.data.size()));
+            file.write(reinterpret_cast<const char *>(level.data.data()),
+                       static_cast<std::streamsize>(level.data.size()));
+        }
+
+        if (!file)
+            throw std::runtime_error("Failed to write file: " + path);
+    }
+
+    /**
+     * Read a cooked texture, the size of every level follows from the size of the first one.
+     * Throws when the header or a level size does not fit, e.g. for a file of an old cooker
+     * @param path cooked file
+     * @return texture with at least one level
+     */
+    cooked_texture
+    read_cooked_texture(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + path);
+
+        char magic[4];
+        file.read(magic, sizeof(magic));
+        if (!file || !std::equal(magic, magic + 4, COOKED_MAGIC) || read_value<std::uint32_t>(file) != COOKED_VERSION)
+            throw std::runtime_error("not a cooked texture of this version: " + path);
+
+        cooked_texture texture;
+        texture.format = static_cast<cooked_format>(read_value<std::uint32_t>(file));
+        int width = static_cast<int>(read_value<std::uint32_t>(file));
+        int height = static_cast<int>(read_value<std::uint32_t>(file));
+        std::uint32_t level_count = read_value<std::uint32_t>(file);
+
+        if (!file || texture.format > cooked_format::bc6h)
+            throw std::runtime_error("unknown cooked texture format: " + path);
+        // a chain longer than down to 1x1 cannot come from the cooker
+        int max_level_count = 1;
+        while ((std::max(width, height) >> max_level_count) > 0)
+            ++max_level_count;
+        if (width <= 0 || height <= 0 || level_count == 0 || level_count > static_cast<std::uint32_t>(max_level_count))
+            throw std::runtime_error("invalid cooked texture size: " + path);
+
+        texture.metadata.resize(read_value<std::uint32_t>(file));
+        file.read(reinterpret_cast<char *>(texture.metadata.data()),
+                  static_cast<std::streamsize>(texture.metadata.size() * sizeof(float)));
+
+        for (std::uint32_t i = 0; i < level_count; ++i) {
+            cooked_level &level = texture.levels.emplace_back();
+            level.width = std::max(1, width >> i);
+            level.height = std::max(1, height >> i);
+            // checked before the resize, so a broken size never allocates
+            std::uint32_t size = read_value<std::uint32_t>(file);
+            if (!file || size != bc_image_size(level.width, level.height))
+                throw std::runtime_error("invalid size of cooked level " + std::to_string(i) + ": " + path);
+            level.data.resize(size);
+            file.read(reinterpret_cast<char *>(level.data.data()), static_cast<std::streamsize>(level.data.size()));
+        }
+
+        if (!file)
+            throw std::runtime_error("truncated cooked texture: " + path);
+
+        return texture;
+    }
+
+    /**
+     * @param source_path path of the source image
+     * @return path of its cooked texture, the extension replaced by .ctex
+     */
+    std::string
+    cooked_texture_path(const std::string &source_path) {
+        std::size_t extension = source_path.find_last_of('.');
+        std::size_t directory = source_path.find_last_of("/\\");
+        if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+            return source_path + COOKED_TEXTURE_EXTENSION;
+        return source_path.substr(0, extension) + COOKED_TEXTURE_EXTENSION;
+    }
+}
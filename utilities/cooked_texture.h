@@ -0,0 +1,47 @@
+#ifndef INC_3DPERLINMAP_COOKED_TEXTURE_H
+#define INC_3DPERLINMAP_COOKED_TEXTURE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace utilities {
+
+    // block compression of a cooked texture
+    enum class cooked_format : std::uint32_t {
+        bc7 = 0,  // colour and arm maps
+        bc5 = 1,  // normal maps, x and y only
+        bc6h = 2  // unsigned hdr
+    };
+
+    struct cooked_level {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> data;
+    };
+
+    /**
+     * Texture written by the texture cooker: the whole mip chain, already block compressed,
+     * plus optional float metadata (e.g. the irradiance spherical harmonics of a sky).
+     * The file starts with "CTEX", a version and the header fields, all little endian.
+     */
+    struct cooked_texture {
+        cooked_format format = cooked_format::bc7;
+        std::vector<cooked_level> levels;
+        std::vector<float> metadata;
+    };
+
+    // extension of cooked files, they are written next to their source image
+    inline const std::string COOKED_TEXTURE_EXTENSION = ".ctex";
+
+    void
+    write_cooked_texture(const std::string &path, const cooked_texture &texture);
+
+    cooked_texture
+    read_cooked_texture(const std::string &path);
+
+    std::string
+    cooked_texture_path(const std::string &source_path);
+}
+
+#endif //INC_3DPERLINMAP_COOKED_TEXTURE_H
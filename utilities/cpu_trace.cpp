@@ -0,0 +1,161 @@
+#include "cpu_trace.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace utilities {
+
+    namespace {
+        // events kept per thread, older ones are overwritten
+        constexpr std::size_t trace_capacity = 1 << 16;
+
+        // one slot of the ring, guarded by its sequence like a seqlock: odd while it is written,
+        // 2 * (event index + 1) once the event is complete
+        struct trace_slot {
+            std::atomic<std::uint64_t> sequence{0};
+            std::atomic<const char *> name{nullptr};
+            std::atomic<std::int64_t> begin{0};
+            std::atomic<std::int64_t> end{0};
+        };
+
+        // written only by its thread, read by write_chrome_trace from any thread
+        struct trace_buffer {
+            std::atomic<const char *> thread_name{nullptr};
+            std::uint32_t thread_index = 0;
+            std::atomic<std::uint64_t> event_count{0};
+            std::unique_ptr<trace_slot[]> slots{new trace_slot[trace_capacity]};
+        };
+
+        // the buffers outlive their threads, so the events of finished threads still reach the trace
+        std::mutex registry_mutex;
+        std::vector<std::unique_ptr<trace_buffer>> registry;
+
+        const trace_clock::time_point trace_epoch = trace_clock::now();
+
+        // registers the buffer of the calling thread on its first event, the only time a lock is taken
+        trace_buffer &
+        thread_buffer() {
+            thread_local trace_buffer *buffer = nullptr;
+            if (buffer == nullptr) {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                registry.push_back(std::make_unique<trace_buffer>());
+                buffer = registry.back().get();
+                buffer->thread_index = static_cast<std::uint32_t>(registry.size());
+            }
+            return *buffer;
+        }
+
+        std::int64_t
+        since_epoch(trace_clock::time_point time) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(time - trace_epoch).count();
+        }
+
+        // names are string literals from the markers, only quotes and backslashes need escaping
+        void
+        write_json_string(std::ofstream &file, const char *text) {
+            file << '"';
+            for (const char *c = text; *c != '\0'; ++c) {
+                if (*c == '"' || *c == '\\') file << '\\';
+                file << *c;
+            }
+            file << '"';
+        }
+    }
+
+    /**
+     * Append an event to the ring of the calling thread, without locks
+     * @param name static name of the event
+     * @param begin
+     * @param end
+     */
+    void
+    record_trace_event(const char *name, trace_clock::time_point begin, trace_clock::time_point end) {
+        trace_buffer &buffer = thread_buffer();
+
+        std::uint64_t index = buffer.event_count.load(std::memory_order_relaxed);
+        trace_slot &slot = buffer.slots[index % trace_capacity];
+
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.begin.store(since_epoch(begin), std::memory_order_relaxed);
+        slot.end.store(since_epoch(end), std::memory_order_relaxed);
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+        buffer.event_count.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * Name the calling thread in the trace
+     * @param name static name
+     */
+    void
+    set_trace_thread_name(const char *name) {
+        thread_buffer().thread_name.store(name, std::memory_order_release);
+    }
+
+    /**
+     * Write the events of every thread in the Chrome trace event format, which chrome://tracing and Perfetto open.
+     * Threads keep recording meanwhile, events overwritten while they are copied are left out
+     * @param path file to write, replaced if it exists
+     * @return whether the file could be written
+     */
+    bool
+    write_chrome_trace(const std::filesystem::path &path) {
+        std::ofstream file(path, std::ios::out | std::ios::trunc);
+        if (!file.is_open()) return false;
+
+        // microseconds with nanosecond digits
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first_event = true;
+        auto separate = [&]() {
+            if (!first_event) file << ',';
+            file << '\n';
+            first_event = false;
+        };
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+
+        for (const auto &buffer: registry) {
+            if (const char *thread_name = buffer->thread_name.load(std::memory_order_acquire)) {
+                separate();
+                file << R"({"ph":"M","name":"thread_name","pid":1,"tid":)" << buffer->thread_index
+                     << R"(,"args":{"name":)";
+                write_json_string(file, thread_name);
+                file << "}}";
+            }
+
+            std::uint64_t count = buffer->event_count.load(std::memory_order_acquire);
+            std::uint64_t first = count > trace_capacity ? count - trace_capacity : 0;
+
+            for (std::uint64_t index = first; index < count; ++index) {
+                const trace_slot &slot = buffer->slots[index % trace_capacity];
+
+                std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                const char *name = slot.name.load(std::memory_order_relaxed);
+                std::int64_t begin = slot.begin.load(std::memory_order_relaxed);
+                std::int64_t end = slot.end.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                // the slot has moved on to a newer event, or is being written
+                if (sequence != 2 * index + 2 || slot.sequence.load(std::memory_order_relaxed) != sequence)
+                    continue;
+
+                separate();
+                file << R"({"ph":"X","pid":1,"tid":)" << buffer->thread_index << R"(,"name":)";
+                write_json_string(file, name);
+                file << ",\"ts\":" << static_cast<double>(begin) / 1e3
+                     << ",\"dur\":" << static_cast<double>(end - begin) / 1e3 << '}';
+            }
+        }
+
+        file << "\n]}\n";
+        return file.good();
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef INC_3DPERLINMAP_CPU_TRACE_H
+#define INC_3DPERLINMAP_CPU_TRACE_H
+
+#include <chrono>
+#include <filesystem>
+
+// set by cmake, see the CPU_TRACE option, 0 compiles every marker to nothing
+#ifndef CPU_TRACE
+#define CPU_TRACE 1
+#endif
+
+namespace utilities {
+
+    using trace_clock = std::chrono::steady_clock;
+
+    void
+    record_trace_event(const char *name, trace_clock::time_point begin, trace_clock::time_point end);
+
+    void
+    set_trace_thread_name(const char *name);
+
+    bool
+    write_chrome_trace(const std::filesystem::path &path);
+
+    // records the time between its construction and its destruction as one event of the calling thread
+    class trace_scope {
+    public:
+        explicit trace_scope(const char *name) : name(name), begin(trace_clock::now()) {}
+
+        trace_scope(const trace_scope &) = delete;
+
+        trace_scope &operator=(const trace_scope &) = delete;
+
+        ~trace_scope() { record_trace_event(name, begin, trace_clock::now()); }
+
+    private:
+        const char *name;
+        trace_clock::time_point begin;
+    };
+}
+
+#if CPU_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// the names are stored as pointers, the "" only lets string literals through
+#define TRACE_SCOPE(name) ::utilities::trace_scope TRACE_CONCAT(trace_scope_, __LINE__)("" name)
+#define TRACE_THREAD_NAME(name) ::utilities::set_trace_thread_name("" name)
+#else
+#define TRACE_SCOPE(name) static_cast<void>(0)
+#define TRACE_THREAD_NAME(name) static_cast<void>(0)
+#endif
+
+#endif //INC_3DPERLINMAP_CPU_TRACE_H
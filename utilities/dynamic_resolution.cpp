@@ -0,0 +1,88 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace utilities {
+
+    /**
+     * Create the offscreen target of the scene
+     * @param width native width
+     * @param height native height
+     * @return the target, leaves the default framebuffer bound
+     */
+    scene_target
+    create_scene_target(int width, int height) {
+        scene_target target;
+        target.width = width;
+        target.height = height;
+
+        glGenTextures(1, &target.color_id);
+        glBindTexture(GL_TEXTURE_2D, target.color_id);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenRenderbuffers(1, &target.depth_id);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth_id);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glGenFramebuffers(1, &target.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color_id, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depth_id);
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            delete_scene_target(target);
+            throw std::runtime_error("scene target is not complete: " + std::to_string(status));
+        }
+
+        return target;
+    }
+
+    void
+    delete_scene_target(scene_target &target) {
+        glDeleteFramebuffers(1, &target.fbo);
+        glDeleteTextures(1, &target.color_id);
+        glDeleteRenderbuffers(1, &target.depth_id);
+        target = scene_target{};
+    }
+
+    /**
+     * Smooth the gpu time of the last frame and move the scale towards the one that meets the budget.
+     * The time is taken as proportional to the pixel count, so the scale follows the square root of the ratio
+     * of budget and time. Within a band around the budget the scale is left alone, it would hunt otherwise
+     * @param resolution
+     * @param frame_time gpu time of the last frame in milliseconds, rendered at the current scale
+     */
+    void
+    update_dynamic_resolution(dynamic_resolution &resolution, float frame_time) {
+        resolution.frame_time = resolution.frame_time == 0.0f
+                                ? frame_time : std::lerp(resolution.frame_time, frame_time, 0.1f);
+
+        float ratio = resolution.target_time / std::max(resolution.frame_time, 1e-3f);
+        if (ratio > 0.9f && ratio < 1.1f) return;
+
+        // a part of the step per frame, the smoothed time lags behind the scale
+        float ideal_scale = resolution.scale * std::sqrt(ratio);
+        resolution.scale = std::clamp(std::lerp(resolution.scale, ideal_scale, 0.1f),
+                                      resolution.min_scale, resolution.max_scale);
+    }
+
+    /**
+     * @param size native width or height
+     * @param scale
+     * @return the scaled size, at least one pixel
+     */
+    int
+    get_scaled_size(int size, float scale) {
+        return std::max(static_cast<int>(std::lround(static_cast<float>(size) * scale)), 1);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef INC_3DPERLINMAP_DYNAMIC_RESOLUTION_H
+#define INC_3DPERLINMAP_DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+namespace utilities {
+
+    // offscreen target of the scene, allocated at the native resolution and drawn into a scaled corner of it
+    struct scene_target {
+        unsigned int fbo = 0;
+        // rgba8, filtered linearly by the upscale pass
+        unsigned int color_id = 0;
+        // depth24 stencil8 render buffer
+        unsigned int depth_id = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    scene_target
+    create_scene_target(int width, int height);
+
+    void
+    delete_scene_target(scene_target &target);
+
+    // scale of the render resolution, steered by the gpu time of the frame towards a budget
+    struct dynamic_resolution {
+        // budget of the gpu time of a frame in milliseconds
+        float target_time = 14.0f;
+        float min_scale = 0.5f;
+        float max_scale = 1.0f;
+
+        // scale of width and height in use
+        float scale = 1.0f;
+        // smoothed gpu time of a frame in milliseconds, 0 before the first measurement
+        float frame_time = 0.0f;
+    };
+
+    void
+    update_dynamic_resolution(dynamic_resolution &resolution, float frame_time);
+
+    int
+    get_scaled_size(int size, float scale);
+}
+
+#endif //INC_3DPERLINMAP_DYNAMIC_RESOLUTION_H
@@ -0,0 +1,69 @@
+#include "g_buffer.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace utilities {
+
+    namespace {
+        unsigned int
+        create_target(GLenum internal_format, int width, int height) {
+            unsigned int texture_id;
+            glGenTextures(1, &texture_id);
+            glBindTexture(GL_TEXTURE_2D, texture_id);
+            glTexStorage2D(GL_TEXTURE_2D, 1, internal_format, width, height);
+            // read back one texel per pixel by the lighting pass
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            return texture_id;
+        }
+    }
+
+    /**
+     * Create the framebuffer of the deferred path with its render targets
+     * @param width
+     * @param height
+     * @return the framebuffer, leaves the default framebuffer bound
+     */
+    g_buffer
+    create_g_buffer(int width, int height) {
+        g_buffer buffer;
+        buffer.width = width;
+        buffer.height = height;
+
+        buffer.albedo_id = create_target(GL_RGBA8, width, height);
+        buffer.normal_id = create_target(GL_RGBA16F, width, height);
+        buffer.arm_id = create_target(GL_RGBA8, width, height);
+        buffer.depth_id = create_target(GL_DEPTH_COMPONENT32F, width, height);
+
+        glGenFramebuffers(1, &buffer.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, buffer.fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, buffer.albedo_id, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, buffer.normal_id, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, buffer.arm_id, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, buffer.depth_id, 0);
+
+        const GLenum attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, attachments);
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            delete_g_buffer(buffer);
+            throw std::runtime_error("g-buffer is not complete: " + std::to_string(status));
+        }
+
+        return buffer;
+    }
+
+    void
+    delete_g_buffer(g_buffer &buffer) {
+        glDeleteFramebuffers(1, &buffer.fbo);
+        const unsigned int textures[] = {buffer.albedo_id, buffer.normal_id, buffer.arm_id, buffer.depth_id};
+        glDeleteTextures(4, textures);
+        buffer = g_buffer{};
+    }
+}
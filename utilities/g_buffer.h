@@ -0,0 +1,30 @@
+#ifndef INC_3DPERLINMAP_G_BUFFER_H
+#define INC_3DPERLINMAP_G_BUFFER_H
+
+#include <glad/glad.h>
+
+namespace utilities {
+
+    // render targets of the deferred terrain path, written by PerlinMap.frag compiled with DEFERRED
+    struct g_buffer {
+        unsigned int fbo = 0;
+        // rgba8: albedo and the share of the far shading tier
+        unsigned int albedo_id = 0;
+        // rgba16f: world space normal
+        unsigned int normal_id = 0;
+        // rgba8: ambient occlusion, roughness, metallic
+        unsigned int arm_id = 0;
+        // depth32f, the world position is rebuilt from it
+        unsigned int depth_id = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    g_buffer
+    create_g_buffer(int width, int height);
+
+    void
+    delete_g_buffer(g_buffer &buffer);
+}
+
+#endif //INC_3DPERLINMAP_G_BUFFER_H
@@ -3,6 +3,7 @@
 //
 
 #include "glfw_tool.h"
+#include "cpu_trace.h"
 
 namespace utilities {
 
@@ -228,80 +229,318 @@ namespace utilities {
     unsigned int
     load_texture(std::string &&absolute_path, std::string &&texture_name, int &width, int &height,
                  const char32_t &texture_wrap) {
-        unsigned int texture_id;
-        glGenTextures(1, &texture_id);
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-
         int nrComponents;
         unsigned char *data = stbi_load(std::string(absolute_path + texture_name).c_str(), &width, &height,
                                         &nrComponents, 0);
-        if (data) {
-            GLenum format = 0;
-            switch (nrComponents) {
-                case 1:
-                    format = GL_RED;
-                    break;
-                case 3:
-                    format = GL_RGB;
-                    break;
-                case 4:
-                    format = GL_RGBA;
-                    break;
-                default:
-                    format = GL_RGB;
-            }
-            glTexImage2D(GL_TEXTURE_2D, 0, static_cast<int>(format), width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            // generate mipmap for texture
-            glGenerateMipmap(GL_TEXTURE_2D);
+        if (!data) {
+            stbi_image_free(data);
+            throw std::runtime_error("Texture failed to load at path: " + absolute_path + texture_name);
+        }
 
-            // set texture wrapping
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLint>(texture_wrap));
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLint>(texture_wrap));
-            // set texture filtering
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        unsigned int texture_id = create_texture(data, width, height, nrComponents, texture_wrap);
+        stbi_image_free(data);
 
-            stbi_image_free(data);
+        return texture_id;
+    }
 
-        } else {
-            stbi_image_free(data);
-            throw std::runtime_error("Texture failed to load at path: " + absolute_path + texture_name);
+    /**
+     * Upload decoded 8-bit pixels as a mipmapped texture
+     * @param data pixels, rows tightly packed
+     * @param width
+     * @param height
+     * @param channels channels per pixel
+     * @param texture_wrap wrap mode
+     * @return texture id
+     */
+    unsigned int
+    create_texture(const unsigned char *data, int width, int height, int channels, const char32_t &texture_wrap) {
+        unsigned int texture_id;
+        glGenTextures(1, &texture_id);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+
+        GLenum format = 0;
+        switch (channels) {
+            case 1:
+                format = GL_RED;
+                break;
+            case 3:
+                format = GL_RGB;
+                break;
+            case 4:
+                format = GL_RGBA;
+                break;
+            default:
+                format = GL_RGB;
         }
 
+        // rows of rgb images are not 4 bytes aligned for every width
+        GLint unpack_alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<int>(format), width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+        // generate mipmap for texture
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        // set texture wrapping
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLint>(texture_wrap));
+        // set texture filtering
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
         glBindTexture(GL_TEXTURE_2D, 0);
         return texture_id;
     }
 
+    /**
+     * Allocate the immutable storage of a mipmapped texture array, the layers are uploaded afterwards
+     * @param width width of every layer
+     * @param height height of every layer
+     * @param layers number of layers
+     * @param channels channels per pixel
+     * @param texture_wrap wrap mode
+     * @return texture id
+     */
+    unsigned int
+    create_texture_array(int width, int height, int layers, int channels, const char32_t &texture_wrap) {
+        GLenum internal_format;
+        switch (channels) {
+            case 1:
+                internal_format = GL_R8;
+                break;
+            case 4:
+                internal_format = GL_RGBA8;
+                break;
+            default:
+                internal_format = GL_RGB8;
+        }
+
+        // a full mip chain down to 1x1
+        int levels = 1;
+        while ((std::max(width, height) >> levels) > 0) ++levels;
+
+        unsigned int texture_id;
+        glGenTextures(1, &texture_id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internal_format, width, height, layers);
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture_id;
+    }
+
+    /**
+     * Upload the base level of one layer of a texture array created by create_texture_array
+     * @param texture_id texture array
+     * @param layer layer index
+     * @param data pixels, rows tightly packed
+     * @param width
+     * @param height
+     * @param channels channels per pixel
+     */
+    void
+    upload_texture_layer(unsigned int texture_id, int layer, const unsigned char *data, int width, int height,
+                         int channels) {
+        GLenum format;
+        switch (channels) {
+            case 1:
+                format = GL_RED;
+                break;
+            case 4:
+                format = GL_RGBA;
+                break;
+            default:
+                format = GL_RGB;
+        }
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+        // rows of rgb images are not 4 bytes aligned for every width
+        GLint unpack_alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, format, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
     unsigned int
     load_texture_hdr(std::string &&absolute_path, std::string &&texture_name, int &width, int &height,
                      const char32_t &texture_wrap) {
-        int nr_components;
-        float *data = stbi_loadf(std::string(absolute_path + texture_name).c_str(),
-                                 &width, &height, &nr_components, 0);
+        return load_texture_hdr(std::forward<std::string>(absolute_path), std::forward<std::string>(texture_name),
+                                width, height, hdr_row_callback(), texture_wrap);
+    }
+
+    /**
+     * Load a hdr texture as half floats. The scanlines are decoded by several threads straight into
+     * a mapped pixel buffer object, so no full float copy of the image is ever allocated.
+     * @param absolute_path path prefix
+     * @param texture_name texture full name
+     * @param width output width
+     * @param height output height
+     * @param row_callback called from the decoding threads with every row as floats, may be empty
+     * @param texture_wrap wrap mode
+     * @return texture id
+     */
+    unsigned int
+    load_texture_hdr(std::string &&absolute_path, std::string &&texture_name, int &width, int &height,
+                     const hdr_row_callback &row_callback, const char32_t &texture_wrap) {
+        hdr_decoder decoder(absolute_path + texture_name);
+        width = decoder.get_width();
+        height = decoder.get_height();
+
+        unsigned int pixel_buffer;
+        glGenBuffers(1, &pixel_buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(decoder.half_size()), nullptr, GL_STREAM_DRAW);
+
+        auto *target = static_cast<std::uint16_t *>(
+                glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(decoder.half_size()),
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        if (target == nullptr) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &pixel_buffer);
+            throw std::runtime_error("Failed to map pixel buffer for: " + absolute_path + texture_name);
+        }
+
+        decoder.decode(target, row_callback);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
         unsigned int hdr_texture;
-        if (data) {
-            glGenTextures(1, &hdr_texture);
-            glBindTexture(GL_TEXTURE_2D, hdr_texture);
+        glGenTextures(1, &hdr_texture);
+        glBindTexture(GL_TEXTURE_2D, hdr_texture);
 
-            // note how specify the texture's data value to be float
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT,
-                         data);
+        // rows of 3 half floats are only 2 bytes aligned
+        GLint unpack_alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // the data pointer is an offset into the bound pixel buffer
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_HALF_FLOAT, nullptr);
 
-            stbi_image_free(data);
-        } else {
-            stbi_image_free(data);
-            throw std::runtime_error("Texture failed to load at path: " + absolute_path + texture_name);
-        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pixel_buffer);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
         glBindTexture(GL_TEXTURE_2D, 0);
         return hdr_texture;
     }
 
+    /**
+     * @param format block compression of a cooked texture
+     * @return matching compressed internal format
+     */
+    GLenum
+    cooked_internal_format(cooked_format format) {
+        switch (format) {
+            case cooked_format::bc7:
+                return GL_COMPRESSED_RGBA_BPTC_UNORM;
+            case cooked_format::bc5:
+                return GL_COMPRESSED_RG_RGTC2;
+            case cooked_format::bc6h:
+                return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+            default:
+                throw std::runtime_error("unknown cooked texture format");
+        }
+    }
+
+    /**
+     * Load a texture written by the texture cooker, every level is uploaded as it is stored
+     * @param absolute_path path prefix
+     * @param texture_name cooked file name
+     * @param width output width
+     * @param height output height
+     * @param metadata output metadata stored with the texture
+     * @param texture_wrap wrap mode
+     * @return texture id
+     */
+    unsigned int
+    load_compressed_texture(std::string &&absolute_path, std::string &&texture_name, int &width, int &height,
+                            std::vector<float> &metadata, const char32_t &texture_wrap) {
+        cooked_texture texture = read_cooked_texture(absolute_path + texture_name);
+        GLenum internal_format = cooked_internal_format(texture.format);
+        width = texture.levels.front().width;
+        height = texture.levels.front().height;
+        metadata = std::move(texture.metadata);
+
+        unsigned int texture_id;
+        glGenTextures(1, &texture_id);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+
+        for (std::size_t level = 0; level < texture.levels.size(); ++level) {
+            const cooked_level &data = texture.levels[level];
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internal_format, data.width, data.height, 0,
+                                   static_cast<GLsizei>(data.data.size()), data.data.data());
+        }
+
+        // the mip chain is complete or only the base level exists, nothing is generated here
+        auto level_count = static_cast<GLint>(texture.levels.size());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, level_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture_id;
+    }
+
+    /**
+     * Allocate the immutable storage of a block compressed texture array
+     * @param format block compression of every layer
+     * @param width width of every layer
+     * @param height height of every layer
+     * @param layers number of layers
+     * @param levels mip levels of every layer
+     * @param texture_wrap wrap mode
+     * @return texture id
+     */
+    unsigned int
+    create_compressed_texture_array(cooked_format format, int width, int height, int layers, int levels,
+                                    const char32_t &texture_wrap) {
+        unsigned int texture_id;
+        glGenTextures(1, &texture_id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, cooked_internal_format(format), width, height, layers);
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, static_cast<GLint>(texture_wrap));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                        levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture_id;
+    }
+
+    /**
+     * Upload every level of a cooked texture into one layer of a compressed texture array
+     * @param texture_id texture array created by create_compressed_texture_array
+     * @param layer layer index
+     * @param texture cooked texture
+     */
+    void
+    upload_compressed_texture_layer(unsigned int texture_id, int layer, const cooked_texture &texture) {
+        GLenum internal_format = cooked_internal_format(texture.format);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+        for (std::size_t level = 0; level < texture.levels.size(); ++level) {
+            const cooked_level &data = texture.levels[level];
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0, layer, data.width, data.height, 1,
+                                      internal_format, static_cast<GLsizei>(data.data.size()), data.data.data());
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
     unsigned int
     load_cube_map(std::vector<std::string> &map_path) {
         unsigned int textureID;
@@ -381,6 +620,7 @@ namespace utilities {
 
     void
     config_im_gui_loop(const char *gui_name, void_callback &callback) {
+        TRACE_SCOPE("build imgui");
         {
             // Start the Dear ImGui frame
             ImGui_ImplOpenGL3_NewFrame();
@@ -394,6 +634,7 @@ namespace utilities {
 
     void
     render_im_gui() {
+        TRACE_SCOPE("render imgui");
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
     }
@@ -16,6 +16,8 @@
 #include "imgui/imgui_impl_opengl3.h"
 
 #include "camera.h"
+#include "hdr_decoder.h"
+#include "cooked_texture.h"
 
 namespace utilities {
 
@@ -50,10 +52,39 @@ namespace utilities {
     load_texture(std::string &&absolute_path, std::string &&texture_name, int &width, int &height,
                  const char32_t &texture_wrap = GL_REPEAT);
 
+    unsigned int
+    create_texture(const unsigned char *data, int width, int height, int channels,
+                   const char32_t &texture_wrap = GL_REPEAT);
+
+    unsigned int
+    create_texture_array(int width, int height, int layers, int channels, const char32_t &texture_wrap = GL_REPEAT);
+
+    void
+    upload_texture_layer(unsigned int texture_id, int layer, const unsigned char *data, int width, int height,
+                         int channels);
+
     unsigned int
     load_texture_hdr(std::string &&absolute_path, std::string &&texture_name, int &width, int &height,
                      const char32_t &texture_wrap = GL_CLAMP_TO_EDGE);
 
+    GLenum
+    cooked_internal_format(cooked_format format);
+
+    unsigned int
+    load_compressed_texture(std::string &&absolute_path, std::string &&texture_name, int &width, int &height,
+                            std::vector<float> &metadata, const char32_t &texture_wrap = GL_REPEAT);
+
+    unsigned int
+    create_compressed_texture_array(cooked_format format, int width, int height, int layers, int levels,
+                                    const char32_t &texture_wrap = GL_REPEAT);
+
+    void
+    upload_compressed_texture_layer(unsigned int texture_id, int layer, const cooked_texture &texture);
+
+    unsigned int
+    load_texture_hdr(std::string &&absolute_path, std::string &&texture_name, int &width, int &height,
+                     const hdr_row_callback &row_callback, const char32_t &texture_wrap = GL_CLAMP_TO_EDGE);
+
     unsigned int
     load_cube_map(std::vector<std::string> &map_path);
 
@@ -0,0 +1,192 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace utilities {
+
+    namespace {
+        // nearest rank percentile of sorted values
+        float
+        percentile(const std::vector<float> &sorted_values, float fraction) {
+            auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<float>(sorted_values.size())));
+            return sorted_values[std::clamp<std::size_t>(rank, 1, sorted_values.size()) - 1];
+        }
+    }
+
+    /**
+     * Create the queries of both sets
+     * @param pass_names name of every pass, shown in the overlay and the header of the csv
+     * @param history_size frames the statistics are taken over
+     */
+    gpu_profiler::gpu_profiler(std::vector<std::string> &&pass_names, std::size_t history_size)
+            : pass_names(std::move(pass_names)), history_size(history_size) {
+        std::size_t count = this->pass_names.size();
+
+        for (auto &frame_queries: queries) {
+            frame_queries.resize(count);
+            for (auto &pass: frame_queries) {
+                glGenQueries(1, &pass.time_query);
+                glGenQueries(1, &pass.primitive_query);
+            }
+        }
+
+        histories.resize(count, {std::vector<float>(history_size, -1.0f),
+                                 std::vector<GLuint64>(history_size, 0)});
+        statistics.resize(count);
+    }
+
+    /**
+     * Start measuring a pass of the current frame, every pass is measured at most once per frame
+     * @param pass index into the pass names
+     */
+    void
+    gpu_profiler::begin_pass(std::size_t pass) {
+        pass_queries &queries_of_pass = queries[frame_count % 2][pass];
+
+        if (pass_active)
+            throw std::runtime_error("gpu pass " + pass_names[pass] + " begins inside " + pass_names[active_pass]);
+        if (queries_of_pass.issued)
+            throw std::runtime_error("gpu pass " + pass_names[pass] + " is measured twice in one frame");
+
+        glBeginQuery(GL_TIME_ELAPSED, queries_of_pass.time_query);
+        glBeginQuery(GL_PRIMITIVES_GENERATED, queries_of_pass.primitive_query);
+
+        queries_of_pass.issued = true;
+        active_pass = pass;
+        pass_active = true;
+    }
+
+    void
+    gpu_profiler::end_pass() {
+        if (!pass_active) throw std::runtime_error("no gpu pass to end");
+
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        glEndQuery(GL_TIME_ELAPSED);
+        pass_active = false;
+    }
+
+    /**
+     * Read the results of the last frame, which the gpu has finished by now in most cases,
+     * and hand its set of queries to the next frame
+     */
+    void
+    gpu_profiler::end_frame() {
+        if (pass_active) throw std::runtime_error("gpu pass " + pass_names[active_pass] + " is not ended");
+
+        std::vector<pass_queries> &last_queries = queries[(frame_count + 1) % 2];
+        if (frame_count > 0) {
+            read_frame(last_queries);
+            update_statistics();
+        }
+
+        for (auto &pass: last_queries)
+            pass.issued = false;
+
+        ++frame_count;
+    }
+
+    void
+    gpu_profiler::delete_queries() {
+        for (auto &frame_queries: queries) {
+            for (auto &pass: frame_queries) {
+                glDeleteQueries(1, &pass.time_query);
+                glDeleteQueries(1, &pass.primitive_query);
+            }
+            frame_queries.clear();
+        }
+    }
+
+    /**
+     * Write one line per frame with the time and the primitives of every pass from now on,
+     * the fields of a pass stay empty in frames it did not run in
+     * @param path file to write, replaced if it exists
+     * @return whether the file could be opened
+     */
+    bool
+    gpu_profiler::open_csv(const std::filesystem::path &path) {
+        close_csv();
+
+        csv.open(path, std::ios::out | std::ios::trunc);
+        if (!csv.is_open()) return false;
+
+        csv << "frame";
+        for (auto name: pass_names) {
+            std::replace(name.begin(), name.end(), ' ', '_');
+            csv << ',' << name << "_ms," << name << "_primitives";
+        }
+        csv << '\n';
+
+        return true;
+    }
+
+    void
+    gpu_profiler::close_csv() {
+        if (csv.is_open()) csv.close();
+    }
+
+    void
+    gpu_profiler::read_frame(std::vector<pass_queries> &frame_queries) {
+        std::size_t frame = frame_count - 1;
+        std::size_t slot = frame % history_size;
+
+        if (csv.is_open()) csv << frame;
+
+        for (std::size_t pass = 0; pass < frame_queries.size(); ++pass) {
+            pass_history &history = histories[pass];
+
+            if (!frame_queries[pass].issued) {
+                history.times[slot] = -1.0f;
+                history.primitives[slot] = 0;
+                if (csv.is_open()) csv << ",,";
+                continue;
+            }
+
+            GLuint64 elapsed_time, primitives;
+            glGetQueryObjectui64v(frame_queries[pass].time_query, GL_QUERY_RESULT, &elapsed_time);
+            glGetQueryObjectui64v(frame_queries[pass].primitive_query, GL_QUERY_RESULT, &primitives);
+
+            history.times[slot] = static_cast<float>(elapsed_time) / 1e6f;
+            history.primitives[slot] = primitives;
+            statistics[pass].primitives = primitives;
+
+            if (csv.is_open()) csv << ',' << history.times[slot] << ',' << primitives;
+        }
+
+        if (csv.is_open()) csv << '\n';
+    }
+
+    void
+    gpu_profiler::update_statistics() {
+        std::vector<float> times;
+
+        for (std::size_t pass = 0; pass < histories.size(); ++pass) {
+            const pass_history &history = histories[pass];
+            gpu_pass_statistics &pass_statistics = statistics[pass];
+
+            times.clear();
+            double time_sum = 0.0;
+            double primitive_sum = 0.0;
+            for (std::size_t slot = 0; slot < history_size; ++slot) {
+                if (history.times[slot] < 0.0f) continue;
+                times.push_back(history.times[slot]);
+                time_sum += history.times[slot];
+                primitive_sum += static_cast<double>(history.primitives[slot]);
+            }
+
+            pass_statistics.sample_count = times.size();
+            if (times.empty()) {
+                pass_statistics = gpu_pass_statistics{};
+                continue;
+            }
+
+            std::sort(times.begin(), times.end());
+            auto count = static_cast<double>(times.size());
+            pass_statistics.mean_time = static_cast<float>(time_sum / count);
+            pass_statistics.p95_time = percentile(times, 0.95f);
+            pass_statistics.p99_time = percentile(times, 0.99f);
+            pass_statistics.mean_primitives = static_cast<float>(primitive_sum / count);
+        }
+    }
+}
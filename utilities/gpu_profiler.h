@@ -0,0 +1,98 @@
+#ifndef INC_3DPERLINMAP_GPU_PROFILER_H
+#define INC_3DPERLINMAP_GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace utilities {
+
+    // rolling statistics of one pass over the frames in the history, times in milliseconds
+    struct gpu_pass_statistics {
+        float mean_time = 0.0f;
+        float p95_time = 0.0f;
+        float p99_time = 0.0f;
+        // primitives of the last measured frame and their mean
+        GLuint64 primitives = 0;
+        float mean_primitives = 0.0f;
+        // frames in the history the pass ran in
+        std::size_t sample_count = 0;
+    };
+
+    /**
+     * Measures the gpu time and the generated primitives of the passes of a frame with
+     * GL_TIME_ELAPSED and GL_PRIMITIVES_GENERATED queries. The queries of one frame are read while the next frame
+     * records into a second set, so reading them does not wait for the gpu.
+     * Neither query type nests, so passes must not overlap, and no other query of these types may be active.
+     * Everything is meant to be called from the thread owning the GL context.
+     */
+    class gpu_profiler {
+    public:
+        explicit gpu_profiler(std::vector<std::string> &&pass_names, std::size_t history_size = 240);
+
+        gpu_profiler(const gpu_profiler &) = delete;
+
+        gpu_profiler &operator=(const gpu_profiler &) = delete;
+
+        ~gpu_profiler() = default;
+
+        void begin_pass(std::size_t pass);
+
+        void end_pass();
+
+        void end_frame();
+
+        void delete_queries();
+
+        bool open_csv(const std::filesystem::path &path);
+
+        void close_csv();
+
+        [[nodiscard]] inline bool is_writing_csv() const { return csv.is_open(); }
+
+        [[nodiscard]] inline std::size_t pass_count() const { return pass_names.size(); }
+
+        [[nodiscard]] inline const std::string &get_pass_name(std::size_t pass) const { return pass_names[pass]; }
+
+        [[nodiscard]] inline const gpu_pass_statistics &get_statistics(std::size_t pass) const {
+            return statistics[pass];
+        }
+
+    private:
+        // the two queries of a pass in one of the two sets
+        struct pass_queries {
+            unsigned int time_query = 0;
+            unsigned int primitive_query = 0;
+            // whether the pass ran in the frame of the set
+            bool issued = false;
+        };
+
+        // results of a pass over the last frames, a ring of history_size entries, negative where it did not run
+        struct pass_history {
+            std::vector<float> times;
+            std::vector<GLuint64> primitives;
+        };
+
+        std::vector<std::string> pass_names;
+        std::size_t history_size;
+
+        // pass_count queries per set, the set of the current frame is the one of frame_count % 2
+        std::vector<pass_queries> queries[2];
+        std::vector<pass_history> histories;
+        std::vector<gpu_pass_statistics> statistics;
+        std::size_t frame_count = 0;
+        std::size_t active_pass = 0;
+        bool pass_active = false;
+
+        std::ofstream csv;
+
+        void read_frame(std::vector<pass_queries> &frame_queries);
+
+        void update_statistics();
+    };
+}
+
+#endif //INC_3DPERLINMAP_GPU_PROFILER_H
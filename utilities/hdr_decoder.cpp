@@ -0,0 +1,353 @@
+#include "hdr_decoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+#include <emmintrin.h>
+
+#define HDR_USE_SSE
+#endif
+
+#ifdef __F16C__
+
+#include <immintrin.h>
+
+#endif
+
+namespace utilities {
+
+    namespace {
+
+        /**
+         * Round a float to the nearest half float, ties to even
+         * @param value
+         * @return bits of the half float
+         */
+        std::uint16_t
+        float_to_half_scalar(float value) {
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            const std::uint32_t f32_infinity = 255u << 23;
+            const std::uint32_t f16_max = (127u + 16u) << 23;
+            const std::uint32_t denormal_magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+            std::uint32_t sign = bits & 0x80000000u;
+            bits ^= sign;
+
+            std::uint16_t half;
+            if (bits >= f16_max) {
+                // overflow to infinity, keep nan as nan
+                half = bits > f32_infinity ? 0x7e00 : 0x7c00;
+            } else if (bits < (113u << 23)) {
+                // the result is a subnormal half, let the float adder do the rounding
+                float denormal_magic, magnitude;
+                std::memcpy(&denormal_magic, &denormal_magic_bits, sizeof(float));
+                std::memcpy(&magnitude, &bits, sizeof(float));
+                magnitude += denormal_magic;
+                std::memcpy(&bits, &magnitude, sizeof(float));
+                half = static_cast<std::uint16_t>(bits - denormal_magic_bits);
+            } else {
+                std::uint32_t mantissa_odd = (bits >> 13) & 1u;
+                // rebias the exponent and round
+                bits += (static_cast<std::uint32_t>(15 - 127) << 23) + 0xfffu;
+                bits += mantissa_odd;
+                half = static_cast<std::uint16_t>(bits >> 13);
+            }
+
+            return static_cast<std::uint16_t>(half | (sign >> 16));
+        }
+
+#ifdef HDR_USE_SSE
+
+        // four lanes of float_to_half_scalar, the halves end up in the low 16 bits of every lane
+        inline __m128i
+        float_to_half_sse(__m128 value) {
+            const __m128i f16_max = _mm_set1_epi32((127 + 16) << 23);
+            const __m128i min_normal = _mm_set1_epi32((127 - 14) << 23);
+            const __m128i denormal_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+            const __m128i normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+            __m128 sign = _mm_and_ps(_mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u))), value);
+            __m128 magnitude = _mm_xor_ps(value, sign);
+            __m128i bits = _mm_castps_si128(magnitude);
+
+            __m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(magnitude, magnitude));
+            __m128i is_regular = _mm_cmpgt_epi32(f16_max, bits);
+            __m128i special = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+            // subnormal results
+            __m128i is_subnormal = _mm_cmpgt_epi32(min_normal, bits);
+            __m128i subnormal = _mm_sub_epi32(
+                    _mm_castps_si128(_mm_add_ps(magnitude, _mm_castsi128_ps(denormal_magic))), denormal_magic);
+
+            // normal results, round to nearest even
+            __m128i mantissa_odd = _mm_srai_epi32(_mm_slli_epi32(bits, 31 - 13), 31);
+            __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(bits, normal_bias), mantissa_odd), 13);
+
+            __m128i finite = _mm_or_si128(_mm_and_si128(is_subnormal, subnormal),
+                                          _mm_andnot_si128(is_subnormal, normal));
+            __m128i joined = _mm_or_si128(_mm_and_si128(is_regular, finite), _mm_andnot_si128(is_regular, special));
+
+            return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+        }
+
+        // four RGBE pixels in the lanes of one register to floats, the exponent lane is left over
+        inline void
+        rgbe_to_float_sse(const unsigned char *rgbe, float *rgb) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgbe));
+            __m128i low = _mm_unpacklo_epi8(packed, zero);
+            __m128i high = _mm_unpackhi_epi8(packed, zero);
+
+            __m128i pixels[4] = {
+                    _mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+                    _mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)
+            };
+
+            for (int i = 0; i < 4; ++i) {
+                // 2^(e - 136) built directly from the exponent bits, tiny exponents flush to zero
+                __m128i exponent = _mm_shuffle_epi32(pixels[i], _MM_SHUFFLE(3, 3, 3, 3));
+                __m128i scale = _mm_and_si128(_mm_cmpgt_epi32(exponent, _mm_set1_epi32(9)),
+                                              _mm_slli_epi32(_mm_sub_epi32(exponent, _mm_set1_epi32(9)), 23));
+                // overlapping stores, the fourth lane is overwritten by the next pixel
+                _mm_storeu_ps(rgb + i * 3, _mm_mul_ps(_mm_cvtepi32_ps(pixels[i]), _mm_castsi128_ps(scale)));
+            }
+        }
+
+#endif
+
+        void
+        rgbe_to_float(const unsigned char *rgbe, float *rgb, int width) {
+            int x = 0;
+#ifdef HDR_USE_SSE
+            // the last group writes one float past the row, stop early so it never leaves the buffer
+            for (; x + 4 < width; x += 4)
+                rgbe_to_float_sse(rgbe + x * 4, rgb + x * 3);
+#endif
+            for (; x < width; ++x) {
+                const unsigned char *pixel = rgbe + x * 4;
+                if (pixel[3] < 10) {
+                    rgb[x * 3] = rgb[x * 3 + 1] = rgb[x * 3 + 2] = 0.0f;
+                    continue;
+                }
+                // same scale as stbi: mantissa * 2^(exponent - (128 + 8))
+                float scale = std::ldexp(1.0f, pixel[3] - 136);
+                rgb[x * 3] = static_cast<float>(pixel[0]) * scale;
+                rgb[x * 3 + 1] = static_cast<float>(pixel[1]) * scale;
+                rgb[x * 3 + 2] = static_cast<float>(pixel[2]) * scale;
+            }
+        }
+
+        // RLE scanlines start with 2, 2 and the big endian width
+        inline bool
+        is_rle_scanline(const unsigned char *bytes, std::size_t remaining, int width) {
+            return width >= 8 && width < 0x8000 && remaining >= 4 &&
+                   bytes[0] == 2 && bytes[1] == 2 && !(bytes[2] & 0x80) &&
+                   ((bytes[2] << 8) | bytes[3]) == width;
+        }
+    }
+
+    /**
+     * Convert floats to half floats, eight at a time with F16C or SSE2
+     * @param source
+     * @param target
+     * @param count
+     */
+    void
+    float_to_half(const float *source, std::uint16_t *target, std::size_t count) {
+        std::size_t i = 0;
+#if defined(__F16C__)
+        // hardware conversion, rounds to nearest even like the fallbacks below
+        for (; i + 8 <= count; i += 8) {
+            __m128i low = _mm_cvtps_ph(_mm_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+            __m128i high = _mm_cvtps_ph(_mm_loadu_ps(source + i + 4), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i), _mm_unpacklo_epi64(low, high));
+        }
+#elif defined(HDR_USE_SSE)
+        for (; i + 8 <= count; i += 8) {
+            __m128i low = float_to_half_sse(_mm_loadu_ps(source + i));
+            __m128i high = float_to_half_sse(_mm_loadu_ps(source + i + 4));
+            // signed saturation keeps the bits, the sign was shifted in arithmetically
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i), _mm_packs_epi32(low, high));
+        }
+#endif
+        for (; i < count; ++i)
+            target[i] = float_to_half_scalar(source[i]);
+    }
+
+    /**
+     * Map the file, parse the header and find every scanline
+     * @param path path of the .hdr file
+     */
+    hdr_decoder::hdr_decoder(const std::string &path) : file(path) {
+        index_scanlines(parse_header());
+    }
+
+    /**
+     * Parse the text header and the resolution string
+     * @return offset of the first scanline
+     */
+    std::size_t
+    hdr_decoder::parse_header() {
+        const auto *bytes = file.data();
+        const std::size_t size = file.size();
+
+        auto read_line = [&](std::size_t &offset) {
+            std::size_t end = offset;
+            while (end < size && bytes[end] != '\n') ++end;
+            std::string line(reinterpret_cast<const char *>(bytes) + offset, end - offset);
+            offset = std::min(end + 1, size);
+            return line;
+        };
+
+        std::size_t offset = 0;
+        std::string line = read_line(offset);
+        if (line != "#?RADIANCE" && line != "#?RGBE")
+            throw std::runtime_error("not a radiance hdr file");
+
+        // header variables end with an empty line
+        for (line = read_line(offset); !line.empty(); line = read_line(offset)) {
+            if (line.rfind("FORMAT=", 0) == 0 && line != "FORMAT=32-bit_rle_rgbe")
+                throw std::runtime_error("unsupported hdr format: " + line);
+            if (offset >= size)
+                throw std::runtime_error("truncated hdr header");
+        }
+
+        // only the standard orientation: scanlines top to bottom, pixels left to right
+        line = read_line(offset);
+        if (std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0)
+            throw std::runtime_error("unsupported hdr resolution string: " + line);
+
+        return offset;
+    }
+
+    /**
+     * Walk over the run lengths once to find where every scanline starts,
+     * so the scanlines can be decoded in any order
+     * @param offset offset of the first scanline
+     */
+    void
+    hdr_decoder::index_scanlines(std::size_t offset) {
+        const auto *bytes = file.data();
+        const std::size_t size = file.size();
+
+        scanline_offsets.resize(height);
+
+        // like stbi, the first scanline decides whether the image is run length encoded
+        run_length_encoded = is_rle_scanline(bytes + offset, size - offset, width);
+        if (!run_length_encoded) {
+            if (offset + static_cast<std::size_t>(width) * height * 4 > size)
+                throw std::runtime_error("truncated hdr data");
+            for (int y = 0; y < height; ++y)
+                scanline_offsets[y] = offset + static_cast<std::size_t>(y) * width * 4;
+            return;
+        }
+
+        for (int y = 0; y < height; ++y) {
+            if (!is_rle_scanline(bytes + offset, size - offset, width))
+                throw std::runtime_error("invalid hdr scanline " + std::to_string(y));
+
+            scanline_offsets[y] = offset;
+            offset += 4;
+
+            // the four channels are stored one after another
+            for (int channel = 0; channel < 4; ++channel) {
+                for (int x = 0; x < width;) {
+                    if (offset >= size)
+                        throw std::runtime_error("truncated hdr data");
+                    int count = bytes[offset++];
+                    // a run repeats the next byte, otherwise count literal bytes follow
+                    std::size_t skip = count > 128 ? 1 : count;
+                    count = count > 128 ? count - 128 : count;
+                    if (count == 0 || x + count > width)
+                        throw std::runtime_error("invalid hdr run length in scanline " + std::to_string(y));
+                    x += count;
+                    offset += skip;
+                }
+            }
+        }
+
+        if (offset > size)
+            throw std::runtime_error("truncated hdr data");
+    }
+
+    /**
+     * Expand one scanline to interleaved RGBE
+     * @param scanline index from the top
+     * @param rgbe target, 4 bytes per pixel
+     */
+    void
+    hdr_decoder::decode_scanline(int scanline, unsigned char *rgbe) const {
+        const unsigned char *bytes = file.data() + scanline_offsets[scanline];
+
+        if (!run_length_encoded) {
+            std::memcpy(rgbe, bytes, static_cast<std::size_t>(width) * 4);
+            return;
+        }
+
+        bytes += 4;
+        for (int channel = 0; channel < 4; ++channel) {
+            for (int x = 0; x < width;) {
+                int count = *bytes++;
+                if (count > 128) {
+                    count -= 128;
+                    unsigned char value = *bytes++;
+                    for (int i = 0; i < count; ++i)
+                        rgbe[(x + i) * 4 + channel] = value;
+                } else {
+                    for (int i = 0; i < count; ++i)
+                        rgbe[(x + i) * 4 + channel] = *bytes++;
+                }
+                x += count;
+            }
+        }
+    }
+
+    /**
+     * Decode the whole image as rgb half floats, bottom row first as OpenGL expects
+     * (the same as stbi_set_flip_vertically_on_load(true))
+     * @param target half_size() bytes
+     * @param row_callback optional, receives every row as floats from the decoding threads
+     * @param thread_count decoding threads, 0 to use every hardware thread
+     */
+    void
+    hdr_decoder::decode(std::uint16_t *target, const hdr_row_callback &row_callback,
+                        unsigned int thread_count) const {
+        if (thread_count == 0)
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        thread_count = std::min(thread_count, static_cast<unsigned int>(height));
+
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < thread_count; ++t) {
+            int scanline_begin = static_cast<int>(static_cast<long long>(height) * t / thread_count);
+            int scanline_end = static_cast<int>(static_cast<long long>(height) * (t + 1) / thread_count);
+
+            workers.emplace_back([&, scanline_begin, scanline_end]() {
+                // only one scanline per thread is ever held in full precision
+                std::vector<unsigned char> rgbe(static_cast<std::size_t>(width) * 4);
+                std::vector<float> rgb(static_cast<std::size_t>(width) * 3);
+
+                for (int scanline = scanline_begin; scanline < scanline_end; ++scanline) {
+                    int row = height - 1 - scanline;
+
+                    decode_scanline(scanline, rgbe.data());
+                    rgbe_to_float(rgbe.data(), rgb.data(), width);
+
+                    if (row_callback)
+                        row_callback(row, rgb.data(), width, height);
+
+                    float_to_half(rgb.data(), target + static_cast<std::size_t>(row) * width * 3, rgb.size());
+                }
+            });
+        }
+
+        std::for_each(workers.begin(), workers.end(), [](auto &worker) { worker.join(); });
+    }
+}
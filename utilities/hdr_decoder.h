@@ -0,0 +1,57 @@
+#ifndef INC_3DPERLINMAP_HDR_DECODER_H
+#define INC_3DPERLINMAP_HDR_DECODER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace utilities {
+
+    // called from the decoding threads with every scanline as rgb floats, row 0 is the bottom of the image
+    using hdr_row_callback = std::function<void(int row, const float *rgb, int width, int height)>;
+
+    /**
+     * Decoder of Radiance RGBE (.hdr) images that converts straight to half floats.
+     * The file is memory mapped and only indexed up front, scanlines are then decoded
+     * by several threads directly into the target buffer, e.g. a mapped pixel buffer object.
+     */
+    class hdr_decoder {
+    public:
+        explicit hdr_decoder(const std::string &path);
+
+        [[nodiscard]] inline int get_width() const { return width; }
+
+        [[nodiscard]] inline int get_height() const { return height; }
+
+        // bytes needed by decode, 3 half floats per pixel
+        [[nodiscard]] inline std::size_t half_size() const {
+            return static_cast<std::size_t>(width) * height * 3 * sizeof(std::uint16_t);
+        }
+
+        void
+        decode(std::uint16_t *target, const hdr_row_callback &row_callback = hdr_row_callback(),
+               unsigned int thread_count = 0) const;
+
+    private:
+        mapped_file file;
+        int width = 0;
+        int height = 0;
+        bool run_length_encoded = true;
+        // offset of every scanline in the file, top to bottom
+        std::vector<std::size_t> scanline_offsets;
+
+        std::size_t parse_header();
+
+        void index_scanlines(std::size_t offset);
+
+        void decode_scanline(int scanline, unsigned char *rgbe) const;
+    };
+
+    void
+    float_to_half(const float *source, std::uint16_t *target, std::size_t count);
+}
+
+#endif //INC_3DPERLINMAP_HDR_DECODER_H
@@ -0,0 +1,140 @@
+#include "headless.h"
+
+#include <glad/glad.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#if HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace utilities {
+
+    /**
+     * Create a core profile context through EGL and load the GL functions. The surfaceless platform of mesa is
+     * preferred, it runs on llvmpipe without a gpu or display server. Other drivers get a pbuffer of the default
+     * display. The frames are drawn into framebuffer objects in both cases
+     * @param major_version
+     * @param minor_version
+     * @return the context, current on the calling thread
+     */
+    headless_context
+    create_headless_context(int major_version, int minor_version) {
+#if HEADLESS_EGL
+        headless_context result;
+        EGLDisplay display = EGL_NO_DISPLAY;
+
+        // client extensions are queried without a display
+        const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display != nullptr && client_extensions != nullptr &&
+            std::strstr(client_extensions, "EGL_MESA_platform_surfaceless") != nullptr) {
+            display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            result.surfaceless = display != EGL_NO_DISPLAY;
+        }
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint egl_major, egl_minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &egl_major, &egl_minor))
+            throw std::runtime_error("Failed to initialize an EGL display");
+        result.display = display;
+
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            eglTerminate(display);
+            throw std::runtime_error("EGL display does not support OpenGL");
+        }
+
+        const EGLint config_attributes[] = {
+                EGL_SURFACE_TYPE, result.surfaceless ? 0 : EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+                EGL_DEPTH_SIZE, 24,
+                EGL_NONE
+        };
+        EGLConfig config;
+        EGLint config_count = 0;
+        if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0) {
+            eglTerminate(display);
+            throw std::runtime_error("No EGL config for an OpenGL context");
+        }
+
+        const EGLint context_attributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, major_version,
+                EGL_CONTEXT_MINOR_VERSION, minor_version,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+        };
+        EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+        if (context == EGL_NO_CONTEXT) {
+            eglTerminate(display);
+            throw std::runtime_error("Failed to create an OpenGL " + std::to_string(major_version) + "." +
+                                     std::to_string(minor_version) + " core context through EGL");
+        }
+        result.context = context;
+
+        EGLSurface surface = EGL_NO_SURFACE;
+        if (!result.surfaceless) {
+            const EGLint surface_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, surface_attributes);
+            result.surface = surface;
+        }
+
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            delete_headless_context(result);
+            throw std::runtime_error("Failed to make the EGL context current");
+        }
+
+        if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+            delete_headless_context(result);
+            throw std::runtime_error("Failed to initialize GLAD");
+        }
+
+        return result;
+#else
+        static_cast<void>(major_version);
+        static_cast<void>(minor_version);
+        throw std::runtime_error("built without EGL, configure with -DHEADLESS_EGL=ON for the headless mode");
+#endif
+    }
+
+    void
+    delete_headless_context(headless_context &context) {
+#if HEADLESS_EGL
+        if (context.display == nullptr) return;
+
+        eglMakeCurrent(context.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context.surface != nullptr) eglDestroySurface(context.display, context.surface);
+        if (context.context != nullptr) eglDestroyContext(context.display, context.context);
+        eglTerminate(context.display);
+#endif
+        context = headless_context{};
+    }
+
+    /**
+     * Read the colour of the bound framebuffer and write it as a png, top row first
+     * @param path target file
+     * @param width
+     * @param height
+     */
+    void
+    write_framebuffer_png(const std::string &path, int width, int height) {
+        std::vector<unsigned char> pixels(static_cast<std::size_t>(width) * height * 3);
+
+        // without alpha, the sky box does not write a meaningful one
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+        // gl rows start at the bottom
+        stbi_flip_vertically_on_write(1);
+        if (!stbi_write_png(path.c_str(), width, height, 3, pixels.data(), width * 3))
+            throw std::runtime_error("Failed to write file: " + path);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef INC_3DPERLINMAP_HEADLESS_H
+#define INC_3DPERLINMAP_HEADLESS_H
+
+#include <string>
+
+// set by cmake, see the HEADLESS_EGL option, 0 builds without EGL and without the headless mode
+#ifndef HEADLESS_EGL
+#define HEADLESS_EGL 0
+#endif
+
+namespace utilities {
+
+    // GL context without a window, drawn into framebuffer objects only. The handles are EGL ones
+    struct headless_context {
+        void *display = nullptr;
+        void *context = nullptr;
+        // 1x1 pbuffer where the display cannot make a context current without a surface
+        void *surface = nullptr;
+        // whether the display is the surfaceless platform of mesa, which needs no gpu and no display server
+        bool surfaceless = false;
+    };
+
+    headless_context
+    create_headless_context(int major_version = 4, int minor_version = 6);
+
+    void
+    delete_headless_context(headless_context &context);
+
+    void
+    write_framebuffer_png(const std::string &path, int width, int height);
+}
+
+#endif //INC_3DPERLINMAP_HEADLESS_H
@@ -0,0 +1,56 @@
+#include "image_compare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace utilities {
+
+    /**
+     * Compare the colour channels of two images of the same size, pixel by pixel
+     * @param reference image to compare against
+     * @param image compared image
+     * @param channels channels per pixel, the fourth one is alpha and never compared
+     * @param skip_transparent leave out pixels with zero alpha in the reference, e.g. where nothing was drawn
+     * @return errors over all compared pixels
+     */
+    image_difference
+    compare_images(const std::vector<unsigned char> &reference, const std::vector<unsigned char> &image,
+                   int channels, bool skip_transparent) {
+        if (reference.size() != image.size() || channels <= 0 || reference.size() % channels != 0)
+            throw std::runtime_error("images to compare differ in size");
+
+        int colour_channels = std::min(channels, 3);
+        skip_transparent = skip_transparent && channels == 4;
+
+        image_difference difference;
+        double absolute_sum = 0.0;
+        double square_sum = 0.0;
+        int max_error = 0;
+
+        for (std::size_t pixel = 0; pixel < reference.size(); pixel += channels) {
+            if (skip_transparent && reference[pixel + 3] == 0)
+                continue;
+
+            for (int c = 0; c < colour_channels; ++c) {
+                int error = std::abs(static_cast<int>(reference[pixel + c]) - static_cast<int>(image[pixel + c]));
+                absolute_sum += error;
+                square_sum += static_cast<double>(error) * error;
+                max_error = std::max(max_error, error);
+            }
+            ++difference.pixel_count;
+        }
+
+        if (difference.pixel_count == 0)
+            return difference;
+
+        auto sample_count = static_cast<double>(difference.pixel_count * colour_channels);
+        difference.mean_absolute_error = absolute_sum / sample_count / 255.0;
+        difference.root_mean_square_error = std::sqrt(square_sum / sample_count) / 255.0;
+        difference.max_error = max_error / 255.0;
+        difference.psnr = square_sum == 0.0 ? std::numeric_limits<double>::infinity() :
+                          20.0 * std::log10(1.0 / difference.root_mean_square_error);
+        return difference;
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef INC_3DPERLINMAP_IMAGE_COMPARE_H
+#define INC_3DPERLINMAP_IMAGE_COMPARE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace utilities {
+
+    // difference of two 8 bit images, the errors are in colour units from 0 to 1
+    struct image_difference {
+        // pixels that took part in the comparison
+        std::size_t pixel_count = 0;
+        double mean_absolute_error = 0.0;
+        double root_mean_square_error = 0.0;
+        double max_error = 0.0;
+        // peak signal to noise ratio in dB, infinity for identical images
+        double psnr = 0.0;
+    };
+
+    image_difference
+    compare_images(const std::vector<unsigned char> &reference, const std::vector<unsigned char> &image,
+                   int channels, bool skip_transparent = false);
+}
+
+#endif //INC_3DPERLINMAP_IMAGE_COMPARE_H
@@ -0,0 +1,97 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+namespace utilities {
+
+    /**
+     * Map a file into memory, an empty file is an error
+     * @param path file path
+     */
+    mapped_file::mapped_file(const std::string &path) {
+#ifdef _WIN32
+        // no sequential scan hint, the scanlines are decoded on several threads at once
+        file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            file_handle = nullptr;
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_handle, &file_size)) {
+            CloseHandle(file_handle);
+            throw std::runtime_error("Failed to get the size of file: " + path);
+        }
+        if (file_size.QuadPart == 0) {
+            CloseHandle(file_handle);
+            throw std::runtime_error("Empty file: " + path);
+        }
+        length = static_cast<std::size_t>(file_size.QuadPart);
+
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_handle == nullptr) {
+            CloseHandle(file_handle);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+
+        bytes = static_cast<const unsigned char *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+        if (bytes == nullptr) {
+            CloseHandle(mapping_handle);
+            CloseHandle(file_handle);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+#else
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            throw std::runtime_error("Failed to open file: " + path);
+
+        struct stat file_stat{};
+        if (fstat(descriptor, &file_stat) != 0) {
+            close(descriptor);
+            throw std::runtime_error("Failed to get the size of file: " + path);
+        }
+        if (file_stat.st_size <= 0) {
+            close(descriptor);
+            throw std::runtime_error("Empty file: " + path);
+        }
+        length = static_cast<std::size_t>(file_stat.st_size);
+
+        void *view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        // the mapping keeps its own reference to the file
+        close(descriptor);
+
+        if (view == MAP_FAILED)
+            throw std::runtime_error("Failed to map file: " + path);
+
+        // the scanlines are decoded on several threads at once, not front to back, so only ask for the whole file
+        madvise(view, length, MADV_WILLNEED);
+        bytes = static_cast<const unsigned char *>(view);
+#endif
+    }
+
+    mapped_file::~mapped_file() {
+#ifdef _WIN32
+        UnmapViewOfFile(bytes);
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+#else
+        munmap(const_cast<unsigned char *>(bytes), length);
+#endif
+    }
+}
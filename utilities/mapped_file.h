@@ -0,0 +1,37 @@
+#ifndef INC_3DPERLINMAP_MAPPED_FILE_H
+#define INC_3DPERLINMAP_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace utilities {
+
+    /**
+     * Read-only memory mapping of a whole file, the pages are loaded by the OS on first access
+     */
+    class mapped_file {
+    public:
+        explicit mapped_file(const std::string &path);
+
+        mapped_file(const mapped_file &) = delete;
+
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        ~mapped_file();
+
+        [[nodiscard]] inline const unsigned char *data() const { return bytes; }
+
+        [[nodiscard]] inline std::size_t size() const { return length; }
+
+    private:
+        const unsigned char *bytes = nullptr;
+        std::size_t length = 0;
+
+#ifdef _WIN32
+        void *file_handle = nullptr;
+        void *mapping_handle = nullptr;
+#endif
+    };
+}
+
+#endif //INC_3DPERLINMAP_MAPPED_FILE_H
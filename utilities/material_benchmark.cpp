@@ -0,0 +1,171 @@
+#include "material_benchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+
+namespace utilities {
+
+    namespace {
+
+        /**
+         * Views on single layers of a texture array, the 2D textures the terrain sampled before the arrays
+         * @param array immutable texture array
+         * @param layer_count number of layers to view
+         * @return one GL_TEXTURE_2D per layer, with the filtering and wrapping of the array
+         */
+        std::array<unsigned int, separate_sampler_count>
+        create_layer_views(unsigned int array, int layer_count) {
+            GLint internal_format, levels, min_filter, mag_filter, wrap_s, wrap_t;
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+            glGetTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+            glGetTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, &min_filter);
+            glGetTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, &mag_filter);
+            glGetTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, &wrap_s);
+            glGetTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, &wrap_t);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+            std::array<unsigned int, separate_sampler_count> views{};
+            glGenTextures(layer_count, views.data());
+            for (int layer = 0; layer < layer_count; ++layer) {
+                glTextureView(views[layer], GL_TEXTURE_2D, array, internal_format, 0, levels, layer, 1);
+                glBindTexture(GL_TEXTURE_2D, views[layer]);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_s);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_t);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            return views;
+        }
+    }
+
+    /**
+     * Shade an offscreen target with the triplanar material fetches of the terrain, once through the texture
+     * arrays and once through separate samplers indexed per fragment like before the arrays. The layers of the
+     * separate samplers are views on the layers of the arrays, both ways read the same texels.
+     * @param fetch_shader shader of MaterialFetch.vert and MaterialFetch.frag
+     * @param diff_array diffuse texture array
+     * @param norm_array normal texture array
+     * @param arm_array ao, roughness and metallic texture array
+     * @param layer_count layers of the arrays, at most separate_sampler_count are used
+     * @param width width of the target
+     * @param height height of the target
+     * @param repeat_count passes timed for each way
+     * @return averaged gpu time of a pass for each way
+     */
+    material_fetch_result
+    benchmark_material_fetch(shader &fetch_shader, unsigned int diff_array, unsigned int norm_array,
+                             unsigned int arm_array, int layer_count, int width, int height, int repeat_count) {
+        if (layer_count <= 0 || width <= 0 || height <= 0 || repeat_count <= 0)
+            throw std::runtime_error("invalid material fetch benchmark size");
+
+        material_fetch_result result;
+        result.layer_count = std::min(layer_count, separate_sampler_count);
+
+        GLint previous_framebuffer, previous_program, viewport[4];
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+        GLboolean blend = glIsEnabled(GL_BLEND);
+
+        // the units hold the textures of the frame, the ones the benchmark binds over are put back at the end
+        const int unit_count = 3 * separate_sampler_count;
+        GLint active_texture, texture_bindings[unit_count], array_bindings[unit_count];
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active_texture);
+        for (int unit = 0; unit < unit_count; ++unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture_bindings[unit]);
+            glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &array_bindings[unit]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        unsigned int framebuffer, colour_texture;
+        glGenTextures(1, &colour_texture);
+        glBindTexture(GL_TEXTURE_2D, colour_texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour_texture, 0);
+
+        const unsigned int arrays[3] = {diff_array, norm_array, arm_array};
+        const char *map_names[3] = {"diff", "norm", "arm"};
+        std::array<unsigned int, separate_sampler_count> views[3];
+        for (int map = 0; map < 3; ++map)
+            views[map] = create_layer_views(arrays[map], result.layer_count);
+
+        // the triangle is made up in the vertex shader, the vertex array stays empty
+        unsigned int vertex_array, query;
+        glGenVertexArrays(1, &vertex_array);
+        glGenQueries(1, &query);
+
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glBindVertexArray(vertex_array);
+
+        auto measure = [&](bool separate_samplers) {
+            fetch_shader.use_variant({{"SEPARATE_SAMPLERS", separate_samplers ? "1" : "0"}});
+            fetch_shader.set_int("layer_count", result.layer_count);
+            for (int map = 0; map < 3; ++map) {
+                if (separate_samplers) {
+                    for (int layer = 0; layer < result.layer_count; ++layer) {
+                        int unit = map * separate_sampler_count + layer;
+                        glActiveTexture(GL_TEXTURE0 + unit);
+                        glBindTexture(GL_TEXTURE_2D, views[map][layer]);
+                        fetch_shader.set_int(std::string(map_names[map]) + "[" + std::to_string(layer) + "]", unit);
+                    }
+                } else {
+                    glActiveTexture(GL_TEXTURE0 + map);
+                    glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[map]);
+                    fetch_shader.set_int(map_names[map], map);
+                }
+            }
+
+            // the first pass is not timed, it pays for the variant and the residency of the textures
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (int repeat = 0; repeat < repeat_count; ++repeat)
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+            material_fetch_timing timing;
+            timing.time = static_cast<float>(static_cast<double>(elapsed) / 1e6 / repeat_count);
+            if (timing.time > 0.0f)
+                timing.pixel_rate = static_cast<double>(width) * height / (timing.time * 1e3);
+            return timing;
+        };
+
+        result.texture_arrays = measure(false);
+        result.separate_samplers = measure(true);
+
+        for (int unit = 0; unit < unit_count; ++unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, texture_bindings[unit]);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array_bindings[unit]);
+        }
+        glActiveTexture(active_texture);
+        glBindVertexArray(0);
+
+        glDeleteQueries(1, &query);
+        glDeleteVertexArrays(1, &vertex_array);
+        for (auto &map_views: views)
+            glDeleteTextures(result.layer_count, map_views.data());
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &colour_texture);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+        glUseProgram(previous_program);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (depth_test) glEnable(GL_DEPTH_TEST);
+        if (blend) glEnable(GL_BLEND);
+        return result;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef INC_3DPERLINMAP_MATERIAL_BENCHMARK_H
+#define INC_3DPERLINMAP_MATERIAL_BENCHMARK_H
+
+#include "shader.h"
+
+namespace utilities {
+
+    // number of separate samplers per material map, the MAX_TEXTURES the terrain used before the texture arrays
+    constexpr int separate_sampler_count = 5;
+
+    // gpu time of one fullscreen pass of the material fetches
+    struct material_fetch_timing {
+        // milliseconds per pass, averaged over the repeats
+        float time = 0.0f;
+        // shaded pixels per second in millions
+        double pixel_rate = 0.0;
+    };
+
+    // the triplanar material fetches of the terrain through the texture arrays and through separate samplers
+    struct material_fetch_result {
+        material_fetch_timing texture_arrays;
+        material_fetch_timing separate_samplers;
+        // layers both ways fetched from
+        int layer_count = 0;
+    };
+
+    material_fetch_result
+    benchmark_material_fetch(shader &fetch_shader, unsigned int diff_array, unsigned int norm_array,
+                             unsigned int arm_array, int layer_count, int width, int height, int repeat_count = 16);
+}
+
+#endif //INC_3DPERLINMAP_MATERIAL_BENCHMARK_H
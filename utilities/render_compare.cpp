@@ -0,0 +1,79 @@
+#include "render_compare.h"
+
+#include <iostream>
+
+namespace utilities {
+
+    /**
+     * Render the same view in several ways into the bound framebuffer, time every way, read its image back and
+     * compare it to the image of the first way. The framebuffer is cleared to transparent black, nothing is drawn
+     * where the alpha stays zero and those pixels are left out of the comparison.
+     * No other GL_TIME_ELAPSED or GL_PRIMITIVES_GENERATED query may be active.
+     * @param names name of every way, printed with its results
+     * @param render renders the way with the given index
+     * @param width width of the framebuffer
+     * @param height height of the framebuffer
+     * @param count_primitives render every way once more to count the primitives it sends to the rasterizer
+     * @param repeat_count renders timed for each way, after one untimed render that builds the shader variants
+     * @return results in the order of the names
+     */
+    std::vector<render_comparison>
+    compare_renders(const std::vector<std::string> &names, const std::function<void(std::size_t)> &render,
+                    int width, int height, bool count_primitives, int repeat_count) {
+        std::vector<render_comparison> results(names.size());
+        std::vector<unsigned char> reference;
+        std::vector<unsigned char> image(static_cast<std::size_t>(width) * height * 4);
+
+        unsigned int time_query, primitive_query;
+        glGenQueries(1, &time_query);
+        glGenQueries(1, &primitive_query);
+
+        GLfloat clear_color[4];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+        for (std::size_t way = 0; way < names.size(); ++way) {
+            render_comparison &result = results[way];
+            result.name = names[way];
+
+            GLuint64 total_time = 0;
+            for (int i = 0; i <= repeat_count; ++i) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                if (i > 0) glBeginQuery(GL_TIME_ELAPSED, time_query);
+                render(way);
+                if (i > 0) {
+                    glEndQuery(GL_TIME_ELAPSED);
+                    GLuint64 elapsed_time;
+                    glGetQueryObjectui64v(time_query, GL_QUERY_RESULT, &elapsed_time);
+                    total_time += elapsed_time;
+                }
+            }
+            result.time = static_cast<float>(total_time) / static_cast<float>(repeat_count) / 1e6f;
+
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+
+            if (count_primitives) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glBeginQuery(GL_PRIMITIVES_GENERATED, primitive_query);
+                render(way);
+                glEndQuery(GL_PRIMITIVES_GENERATED);
+                glGetQueryObjectui64v(primitive_query, GL_QUERY_RESULT, &result.primitives);
+            }
+
+            if (way == 0) reference = image;
+            result.difference = compare_images(reference, image, 4, true);
+
+            std::cout << result.name << ": " << result.time << " ms, mae " << result.difference.mean_absolute_error
+                      << ", rmse " << result.difference.root_mean_square_error << ", max "
+                      << result.difference.max_error << ", psnr " << result.difference.psnr << " dB";
+            if (count_primitives)
+                std::cout << ", " << result.primitives << " primitives";
+            std::cout << std::endl;
+        }
+
+        glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+        glDeleteQueries(1, &time_query);
+        glDeleteQueries(1, &primitive_query);
+        return results;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef INC_3DPERLINMAP_RENDER_COMPARE_H
+#define INC_3DPERLINMAP_RENDER_COMPARE_H
+
+#include <glad/glad.h>
+
+#include "image_compare.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace utilities {
+
+    // one way of rendering the same view, measured by compare_renders
+    struct render_comparison {
+        std::string name;
+        // gpu time of a render in milliseconds, averaged over the repeats
+        float time = 0.0f;
+        // primitives sent to the rasterizer by one render, only counted on request
+        GLuint64 primitives = 0;
+        // difference of the image to the one of the first way
+        image_difference difference;
+    };
+
+    std::vector<render_comparison>
+    compare_renders(const std::vector<std::string> &names, const std::function<void(std::size_t)> &render,
+                    int width, int height, bool count_primitives = false, int repeat_count = 16);
+}
+
+#endif //INC_3DPERLINMAP_RENDER_COMPARE_H
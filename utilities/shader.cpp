@@ -3,22 +3,92 @@
 //
 
 #include "shader.h"
+#include "cpu_trace.h"
+
+#include <chrono>
+#include <filesystem>
 
 namespace utilities {
 
     /**
-     * Load shader code, Create and Compile shader
-     * and Delete unuseful shaders
+     * Build the variant without extra defines, if no variant is built yet
      */
     void
     shader::build_shader() {
         if (compiled_flag) return;
 
-        std::vector<std::string> shader_codes;
+        id = build_program({});
+        variants.emplace("", id);
+
+        compiled_flag = true;
+    }
+
+    /**
+     * Use the variant compiled with the given defines, it is built the first time it is asked for.
+     * The set functions then go to this variant until another one is used.
+     * @param defines injected after #version into every stage
+     * @return this shader
+     */
+    shader &
+    shader::use_variant(const shader_defines &defines) {
+        std::string key = variant_key(defines);
+
+        auto variant = variants.find(key);
+        if (variant != variants.end()) {
+            id = variant->second;
+            glUseProgram(id);
+            return *this;
+        }
+
+        auto build_start = std::chrono::steady_clock::now();
+        id = build_program(defines);
+        variants.emplace(key, id);
+        compiled_flag = true;
+        std::cout << "Built shader variant [" << key << "] in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - build_start).count()
+                  << " ms" << std::endl;
+
+        glUseProgram(id);
+        if (variant_setup)
+            variant_setup(*this);
+
+        return *this;
+    }
+
+    /**
+     * Delete the programs of all variants
+     */
+    void
+    shader::delete_programs() {
+        for (auto &[key, program]: variants)
+            glDeleteProgram(program);
+        variants.clear();
+
+        id = 0;
+        compiled_flag = false;
+    }
+
+    /**
+     * Compile every stage with the defines and link them
+     * @param defines injected after #version into every stage
+     * @return program id
+     */
+    unsigned int
+    shader::build_program(const shader_defines &defines) {
+        TRACE_SCOPE("build shader program");
+        // load all shader codes once, the variants only differ in their defines
+        if (shader_sources.empty()) {
+            std::for_each(shader_paths.begin(), shader_paths.end(),
+                          [&](auto &path) {
+                              std::vector<std::string> included_paths;
+                              shader_sources.push_back(preprocess_shader_code(path, included_paths));
+                          }
+            );
+        }
 
-        // load all shader codes
-        std::for_each(shader_paths.begin(), shader_paths.end(),
-                      [&](auto &path) { shader_codes.push_back(load_shader_code_from_file(path)); }
+        std::vector<std::string> shader_codes;
+        std::for_each(shader_sources.begin(), shader_sources.end(),
+                      [&](auto &code) { shader_codes.push_back(inject_defines(code, defines)); }
         );
 
         std::vector<unsigned int> shader_ids;
@@ -35,23 +105,31 @@ namespace utilities {
 
 
         // shader Program
-        id = glCreateProgram();
+        unsigned int program_id = glCreateProgram();
 
         // attach every shader to
         std::for_each(shader_ids.begin(), shader_ids.end(),
-                      [&](const auto &shader_id) { glAttachShader(id, shader_id); }
+                      [&](const auto &shader_id) { glAttachShader(program_id, shader_id); }
         );
 
-        glLinkProgram(id);
+        if (!feedback_varyings.empty()) {
+            std::vector<const char *> varying_names;
+            for (auto &varying: feedback_varyings)
+                varying_names.push_back(varying.c_str());
+            glTransformFeedbackVaryings(program_id, static_cast<GLsizei>(varying_names.size()), varying_names.data(),
+                                        GL_INTERLEAVED_ATTRIBS);
+        }
+
+        glLinkProgram(program_id);
 
-        check_compiler_errors(id, "PROGRAM");
+        check_compiler_errors(program_id, "PROGRAM");
 
         // delete the shaders as they're linked into our program now and no longer necessary
         std::for_each(shader_ids.begin(), shader_ids.end(),
                       [&](const auto &shader_id) { glDeleteShader(shader_id); }
         );
 
-        compiled_flag = true;
+        return program_id;
     }
 
     /**
@@ -101,6 +179,104 @@ namespace utilities {
         return shader_stream.str();
     }
 
+    /**
+     * Load shader code and replace every #include "file" line by the code of that file,
+     * paths are relative to the including file and every file is included only once.
+     * #line directives keep the line numbers of compiler errors right,
+     * the source string number of a file is its position in included_paths.
+     * @param shader_path
+     * @param included_paths files already included into this stage
+     * @return shader code without includes
+     */
+    std::string
+    shader::preprocess_shader_code(std::string &shader_path, std::vector<std::string> &included_paths) {
+        std::size_t source_number = included_paths.size();
+        included_paths.push_back(std::filesystem::path(shader_path).lexically_normal().string());
+
+        std::string shader_code = load_shader_code_from_file(shader_path);
+        std::filesystem::path directory = std::filesystem::path(shader_path).parent_path();
+
+        std::istringstream code_stream(shader_code);
+        std::ostringstream result;
+        std::string line;
+        int line_number = 0;
+
+        while (std::getline(code_stream, line)) {
+            ++line_number;
+
+            std::size_t first = line.find_first_not_of(" \t");
+            if (first == std::string::npos || line.compare(first, 8, "#include") != 0) {
+                result << line << '\n';
+                continue;
+            }
+
+            std::size_t open_quote = line.find('"', first + 8);
+            std::size_t close_quote = open_quote == std::string::npos ? open_quote : line.find('"', open_quote + 1);
+            if (close_quote == std::string::npos)
+                throw std::runtime_error("ERROR::SHADER::INVALID_INCLUDE in " + shader_path + " line " +
+                                         std::to_string(line_number) + ": " + line);
+
+            std::string include_path = (directory / line.substr(open_quote + 1, close_quote - open_quote - 1))
+                    .lexically_normal().string();
+
+            if (std::find(included_paths.begin(), included_paths.end(), include_path) != included_paths.end()) {
+                // keep the line count of this file
+                result << '\n';
+                continue;
+            }
+
+            std::size_t include_number = included_paths.size();
+            result << "#line 1 " << include_number << '\n'
+                   << preprocess_shader_code(include_path, included_paths)
+                   << "#line " << line_number + 1 << ' ' << source_number << '\n';
+        }
+
+        return result.str();
+    }
+
+    /**
+     * Add a #define for every option right after the #version line, which has to stay first
+     * @param shader_code
+     * @param defines
+     * @return shader code of the variant
+     */
+    std::string
+    shader::inject_defines(const std::string &shader_code, const shader_defines &defines) {
+        if (defines.empty())
+            return shader_code;
+
+        std::size_t version = shader_code.find("#version");
+        std::size_t insert_position = version == std::string::npos ? 0 : shader_code.find('\n', version);
+        insert_position = insert_position == std::string::npos ? shader_code.size() : insert_position + 1;
+
+        std::string define_lines;
+        for (auto &[name, value]: defines)
+            define_lines += "#define " + name + " " + value + "\n";
+
+        // the next line keeps its original number
+        auto next_line = std::count(shader_code.begin(), shader_code.begin() + static_cast<std::ptrdiff_t>(insert_position),
+                                    '\n') + 1;
+        define_lines += "#line " + std::to_string(next_line) + "\n";
+
+        return shader_code.substr(0, insert_position) + define_lines + shader_code.substr(insert_position);
+    }
+
+    /**
+     * Key of a variant in the cache, e.g. "LIGHT_MODE=2 TEXTURE_MODE=1"
+     * @param defines
+     * @return key
+     */
+    std::string
+    shader::variant_key(const shader_defines &defines) {
+        std::string key;
+        for (auto &[name, value]: defines) {
+            if (!key.empty())
+                key += ' ';
+            key += name + "=" + value;
+        }
+        return key;
+    }
+
     /**
      * check compiler error, program status and link status
      * @param shader_id shader's id
@@ -16,14 +16,28 @@
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <map>
+#include <unordered_map>
 
 namespace utilities {
 
+    // name and value of every #define of a shader variant, ordered so equal sets give the same key
+    using shader_defines = std::map<std::string, std::string>;
+
     class shader {
     public:
+        // program of the variant in use
         unsigned int id = 0;
         bool compiled_flag = false;
 
+        // called once for every newly built variant while it is in use, to set the uniforms that never change
+        std::function<void(shader &)> variant_setup;
+
+        // outputs of the last vertex processing stage recorded by transform feedback, interleaved in this order.
+        // set before the first variant is built
+        std::vector<std::string> feedback_varyings;
+
         inline shader(std::string &&absolute_path, std::string &&vert_name, std::string &&frag_name);
 
         ~shader() = default;
@@ -32,6 +46,12 @@ namespace utilities {
 
         inline void use();
 
+        shader &use_variant(const shader_defines &defines);
+
+        void delete_programs();
+
+        [[nodiscard]] inline std::size_t variant_count() const { return variants.size(); }
+
         inline shader &set_bool(const std::string &name, bool value) const;
 
         inline shader &set_int(const std::string &name, int value) const;
@@ -60,6 +80,9 @@ namespace utilities {
         // store all paths
         std::vector<std::string> shader_paths;
 
+        // code of every stage with its includes resolved, loaded once for all variants
+        std::vector<std::string> shader_sources;
+
         /**
          * Override by an inherited class to add shader types, like tese and tesc.
          * @param shader_ids
@@ -74,9 +97,21 @@ namespace utilities {
                               std::string &&check_shader_type);
 
     private:
+        // compiled programs by the key of their defines, the default variant has an empty key
+        std::unordered_map<std::string, unsigned int> variants;
+
+        unsigned int build_program(const shader_defines &defines);
+
         static void check_compiler_errors(unsigned int shader_id, std::string &&shader_type);
 
         static std::string load_shader_code_from_file(std::string &shader_path);
+
+        static std::string
+        preprocess_shader_code(std::string &shader_path, std::vector<std::string> &included_paths);
+
+        static std::string inject_defines(const std::string &shader_code, const shader_defines &defines);
+
+        static std::string variant_key(const shader_defines &defines);
     };
 
     inline
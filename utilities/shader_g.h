@@ -0,0 +1,45 @@
+#ifndef INC_3DPERLINMAP_SHADER_G_H
+#define INC_3DPERLINMAP_SHADER_G_H
+
+#include "shader.h"
+
+namespace utilities {
+
+    class shader_g : public shader {
+    public:
+        inline shader_g(std::string &&absolute_path, std::string &&vert_name,
+                        std::string &&frag_name, std::string &&geom_name);
+
+        ~shader_g() = default;
+
+    protected:
+
+        inline void
+        create_compile_shader_delegate(std::vector<unsigned int> &shader_ids,
+                                       std::vector<std::string> &shader_codes) const override;
+    };
+
+    inline
+    shader_g::shader_g(std::string &&absolute_path, std::string &&vert_name,
+                       std::string &&frag_name, std::string &&geom_name)
+            : shader(std::forward<std::string>(absolute_path),
+                     std::forward<std::string>(vert_name),
+                     std::forward<std::string>(frag_name)) {
+        // Ensure the correct order of shaders
+        shader_paths.insert(shader_paths.begin() + 1, absolute_path + geom_name);
+    }
+
+    /**
+     * Adding shaders specific to the subclass.
+     * @param shader_ids
+     * @param shader_codes
+     */
+    inline void
+    shader_g::create_compile_shader_delegate(std::vector<unsigned int> &shader_ids,
+                                             std::vector<std::string> &shader_codes) const {
+        shader_ids.push_back(
+                create_compile_shader(shader_codes[shader_ids.size()], GL_GEOMETRY_SHADER, "GEOMETRY"));
+    }
+}
+
+#endif //INC_3DPERLINMAP_SHADER_G_H
@@ -0,0 +1,227 @@
+#include "spherical_harmonics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+#include <emmintrin.h>
+
+#define SH_USE_SSE
+#endif
+
+namespace utilities {
+
+    namespace {
+        constexpr float PI = 3.14159265359f;
+
+        // constant factors of the real spherical harmonics basis
+        constexpr float SH_C0 = 0.282095f;
+        constexpr float SH_C1 = 0.488603f;
+        constexpr float SH_C2 = 1.092548f;
+        constexpr float SH_C3 = 0.315392f;
+        constexpr float SH_C4 = 0.546274f;
+
+        /**
+         * Accumulate the radiance of one scanline weighted by the 9 basis functions
+         * @param row pixels of the scanline
+         * @param channels channels per pixel
+         * @param cos_phi cosine of the longitude of every column
+         * @param sin_phi sine of the longitude of every column
+         * @param width pixels per scanline
+         * @param cos_lat cosine of the latitude of the scanline
+         * @param sin_lat sine of the latitude of the scanline
+         * @param row_sum target sums, 9 basis functions x 3 channels
+         */
+        void
+        accumulate_row(const float *row, int channels, const float *cos_phi, const float *sin_phi, int width,
+                       float cos_lat, float sin_lat, float *row_sum) {
+            int x = 0;
+
+#ifdef SH_USE_SSE
+            __m128 acc[27];
+            for (auto &value: acc) value = _mm_setzero_ps();
+
+            const __m128 y = _mm_set1_ps(sin_lat);
+            const __m128 lat = _mm_set1_ps(cos_lat);
+            const __m128 c1 = _mm_set1_ps(SH_C1);
+            const __m128 c2 = _mm_set1_ps(SH_C2);
+            const __m128 c3 = _mm_set1_ps(SH_C3);
+            const __m128 c4 = _mm_set1_ps(SH_C4);
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 three = _mm_set1_ps(3.0f);
+
+            // the y component and the bands only depending on it stay the same along the scanline
+            const __m128 b0 = _mm_set1_ps(SH_C0);
+            const __m128 b1 = _mm_mul_ps(c1, y);
+
+            // process four pixels at once
+            for (; x + 4 <= width; x += 4) {
+                const float *p = row + x * channels;
+                __m128 r = _mm_setr_ps(p[0], p[channels], p[2 * channels], p[3 * channels]);
+                __m128 g = _mm_setr_ps(p[1], p[channels + 1], p[2 * channels + 1], p[3 * channels + 1]);
+                __m128 b = _mm_setr_ps(p[2], p[channels + 2], p[2 * channels + 2], p[3 * channels + 2]);
+
+                __m128 dx = _mm_mul_ps(lat, _mm_loadu_ps(cos_phi + x));
+                __m128 dz = _mm_mul_ps(lat, _mm_loadu_ps(sin_phi + x));
+
+                __m128 basis[9] = {
+                        b0,
+                        b1,
+                        _mm_mul_ps(c1, dz),
+                        _mm_mul_ps(c1, dx),
+                        _mm_mul_ps(c2, _mm_mul_ps(dx, y)),
+                        _mm_mul_ps(c2, _mm_mul_ps(y, dz)),
+                        _mm_mul_ps(c3, _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(dz, dz)), one)),
+                        _mm_mul_ps(c2, _mm_mul_ps(dx, dz)),
+                        _mm_mul_ps(c4, _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(y, y)))
+                };
+
+                for (int k = 0; k < 9; ++k) {
+                    acc[k * 3 + 0] = _mm_add_ps(acc[k * 3 + 0], _mm_mul_ps(basis[k], r));
+                    acc[k * 3 + 1] = _mm_add_ps(acc[k * 3 + 1], _mm_mul_ps(basis[k], g));
+                    acc[k * 3 + 2] = _mm_add_ps(acc[k * 3 + 2], _mm_mul_ps(basis[k], b));
+                }
+            }
+
+            // horizontal sum of every lane
+            for (int i = 0; i < 27; ++i) {
+                alignas(16) float lanes[4];
+                _mm_store_ps(lanes, acc[i]);
+                row_sum[i] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            }
+#endif
+
+            // remaining pixels, or the whole scanline without SSE
+            for (; x < width; ++x) {
+                const float *p = row + x * channels;
+                float dx = cos_lat * cos_phi[x];
+                float dy = sin_lat;
+                float dz = cos_lat * sin_phi[x];
+
+                float basis[9] = {
+                        SH_C0,
+                        SH_C1 * dy,
+                        SH_C1 * dz,
+                        SH_C1 * dx,
+                        SH_C2 * dx * dy,
+                        SH_C2 * dy * dz,
+                        SH_C3 * (3.0f * dz * dz - 1.0f),
+                        SH_C2 * dx * dz,
+                        SH_C4 * (dx * dx - dy * dy)
+                };
+
+                for (int k = 0; k < 9; ++k) {
+                    row_sum[k * 3 + 0] += basis[k] * p[0];
+                    row_sum[k * 3 + 1] += basis[k] * p[1];
+                    row_sum[k * 3 + 2] += basis[k] * p[2];
+                }
+            }
+        }
+    }
+
+    /**
+     * @param width width of the environment map
+     * @param height height of the environment map
+     */
+    sh9_projector::sh9_projector(int width, int height)
+            : width(width), height(height), cos_phi(width), sin_phi(width), row_sums(height) {
+        if (width <= 0 || height <= 0)
+            throw std::runtime_error("invalid environment map for spherical harmonics projection");
+
+        for (int x = 0; x < width; ++x) {
+            float phi = (static_cast<float>(x) + 0.5f) / static_cast<float>(width) * 2.0f * PI - PI;
+            cos_phi[x] = std::cos(phi);
+            sin_phi[x] = std::sin(phi);
+        }
+
+        for (auto &sum: row_sums)
+            sum.fill(0.0);
+    }
+
+    /**
+     * Accumulate one scanline, safe to call concurrently for different rows
+     * @param y row index, row 0 is the bottom of the flipped image
+     * @param row rgb(a) float pixels
+     * @param channels channels per pixel, at least 3
+     */
+    void
+    sh9_projector::add_row(int y, const float *row, int channels) {
+        if (row == nullptr || y < 0 || y >= height || channels < 3)
+            throw std::runtime_error("invalid scanline for spherical harmonics projection");
+
+        // the latitude goes from -PI/2 to PI/2
+        float lat = (static_cast<float>(y) + 0.5f) / static_cast<float>(height) * PI - 0.5f * PI;
+        float cos_lat = std::cos(lat);
+
+        float row_sum[27] = {};
+        accumulate_row(row, channels, cos_phi.data(), sin_phi.data(), width, cos_lat, std::sin(lat), row_sum);
+
+        // solid angle of a pixel on the equator, pixels shrink towards the poles
+        double weight = (2.0 * PI / width) * (PI / height) * cos_lat;
+        for (int i = 0; i < 27; ++i)
+            row_sums[y][i] = row_sum[i] * weight;
+    }
+
+    /**
+     * Convolve the projection with the clamped cosine lobe, so that evaluating the result at a normal
+     * gives the same value as the irradiance cube map rendered by the old IrradianceConvolution.frag
+     * (irradiance / PI)
+     * @return coefficients to upload as irradiance_sh[9]
+     */
+    sh9_coefficients
+    sh9_projector::coefficients() const {
+        // cosine lobe (PI, 2PI/3, PI/4) divided by PI
+        const double band_factor[9] = {1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25};
+
+        sh9_coefficients result{};
+        for (int k = 0; k < 9; ++k) {
+            glm::dvec3 value(0.0);
+            for (auto &sum: row_sums)
+                value += glm::dvec3(sum[k * 3 + 0], sum[k * 3 + 1], sum[k * 3 + 2]);
+            result[k] = glm::vec3(value * band_factor[k]);
+        }
+
+        return result;
+    }
+
+    /**
+     * Project a whole equirectangular HDR environment onto the L2 spherical harmonics.
+     * The rows are expected in the order loaded with stbi_set_flip_vertically_on_load(true).
+     * @param data rgb(a) float pixels
+     * @param width width of the environment map
+     * @param height height of the environment map
+     * @param channels channels per pixel, at least 3
+     * @param thread_count worker threads, 0 to use every hardware thread
+     * @return coefficients to upload as irradiance_sh[9]
+     */
+    sh9_coefficients
+    project_irradiance_sh9(const float *data, int width, int height, int channels, unsigned int thread_count) {
+        if (data == nullptr || width <= 0 || height <= 0 || channels < 3)
+            throw std::runtime_error("invalid environment map for spherical harmonics projection");
+
+        if (thread_count == 0)
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        thread_count = std::min(thread_count, static_cast<unsigned int>(height));
+
+        sh9_projector projector(width, height);
+        std::vector<std::thread> workers;
+
+        for (unsigned int t = 0; t < thread_count; ++t) {
+            int row_begin = static_cast<int>(static_cast<long long>(height) * t / thread_count);
+            int row_end = static_cast<int>(static_cast<long long>(height) * (t + 1) / thread_count);
+
+            workers.emplace_back([&, row_begin, row_end]() {
+                for (int y = row_begin; y < row_end; ++y)
+                    projector.add_row(y, data + static_cast<size_t>(y) * width * channels, channels);
+            });
+        }
+
+        std::for_each(workers.begin(), workers.end(), [](auto &worker) { worker.join(); });
+
+        return projector.coefficients();
+    }
+}
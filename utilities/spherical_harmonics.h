@@ -0,0 +1,40 @@
+#ifndef INC_3DPERLINMAP_SPHERICAL_HARMONICS_H
+#define INC_3DPERLINMAP_SPHERICAL_HARMONICS_H
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+namespace utilities {
+
+    // 9 coefficients of the L2 spherical harmonics, one rgb value per basis function
+    using sh9_coefficients = std::array<glm::vec3, 9>;
+
+    /**
+     * Incremental projection of an equirectangular environment, scanlines can be added in any order
+     * and from several threads at once, e.g. while they are being decoded.
+     */
+    class sh9_projector {
+    public:
+        sh9_projector(int width, int height);
+
+        void add_row(int y, const float *row, int channels);
+
+        [[nodiscard]] sh9_coefficients coefficients() const;
+
+    private:
+        int width;
+        int height;
+        // longitude of every column, shared by all scanlines
+        std::vector<float> cos_phi;
+        std::vector<float> sin_phi;
+        // weighted sums of every scanline, each row is only ever written by the thread adding it
+        std::vector<std::array<double, 27>> row_sums;
+    };
+
+    sh9_coefficients
+    project_irradiance_sh9(const float *data, int width, int height, int channels, unsigned int thread_count = 0);
+}
+
+#endif //INC_3DPERLINMAP_SPHERICAL_HARMONICS_H
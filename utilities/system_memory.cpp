@@ -0,0 +1,42 @@
+#include "system_memory.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <windows.h>
+
+#else
+
+#include <fstream>
+#include <string>
+
+#endif
+
+namespace utilities {
+
+    /**
+     * physical memory the system can still give to processes without swapping
+     * @return bytes, 0 where it is not known
+     */
+    std::size_t
+    get_available_memory() {
+#ifdef _WIN32
+        MEMORYSTATUSEX status{};
+        status.dwLength = sizeof(status);
+        if (!GlobalMemoryStatusEx(&status)) return 0;
+        return static_cast<std::size_t>(status.ullAvailPhys);
+#else
+        // MemAvailable counts the page cache that can be dropped, unlike the free pages of sysconf
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        std::size_t kilobytes;
+        std::string unit;
+        while (meminfo >> key >> kilobytes >> unit) {
+            if (key == "MemAvailable:")
+                return kilobytes * 1024;
+        }
+        return 0;
+#endif
+    }
+}
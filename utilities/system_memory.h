@@ -0,0 +1,12 @@
+#ifndef INC_3DPERLINMAP_SYSTEM_MEMORY_H
+#define INC_3DPERLINMAP_SYSTEM_MEMORY_H
+
+#include <cstddef>
+
+namespace utilities {
+
+    std::size_t
+    get_available_memory();
+}
+
+#endif //INC_3DPERLINMAP_SYSTEM_MEMORY_H
@@ -0,0 +1,279 @@
+#include "texture_pipeline.h"
+#include "glfw_tool.h"
+#include "cpu_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+namespace utilities {
+
+    namespace {
+        using pipeline_clock = std::chrono::steady_clock;
+
+        inline double
+        elapsed_milliseconds(pipeline_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(pipeline_clock::now() - start).count();
+        }
+    }
+
+    /**
+     * Start the decoding threads
+     * @param thread_count worker threads, 0 to use every hardware thread but the GL thread
+     * @param flip_vertically same as stbi_set_flip_vertically_on_load
+     */
+    texture_pipeline::texture_pipeline(unsigned int thread_count, bool flip_vertically)
+            : flip_vertically(flip_vertically) {
+        if (thread_count == 0)
+            // hardware_concurrency may be 0 when it is unknown
+            thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+        for (unsigned int i = 0; i < thread_count; ++i)
+            workers.emplace_back(&texture_pipeline::decode_loop, this);
+    }
+
+    texture_pipeline::~texture_pipeline() {
+        {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            stopping = true;
+        }
+        job_condition.notify_all();
+
+        for (auto &worker: workers)
+            worker.join();
+
+        // images that were decoded but never uploaded
+        while (!decoded_images.empty()) {
+            stbi_image_free(decoded_images.front().pixels);
+            decoded_images.pop();
+        }
+    }
+
+    /**
+     * Queue the images of a texture array for decoding, the images are decoded in the order they are queued.
+     * If the texture cooker has written a .ctex next to an image, that one is loaded instead.
+     * @param array_name name shown in the timings
+     * @param layer_paths full path of every layer, all images must have the same size
+     * @param texture_wrap wrap mode
+     * @return index of the texture array
+     */
+    std::size_t
+    texture_pipeline::enqueue_array(std::string &&array_name, const std::vector<std::string> &layer_paths,
+                                    const char32_t &texture_wrap) {
+        std::size_t array_index = arrays.size();
+        texture_array &array = arrays.emplace_back();
+        array.name = std::move(array_name);
+        array.texture_wrap = texture_wrap;
+
+        {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            for (std::size_t layer = 0; layer < layer_paths.size(); ++layer) {
+                const std::string &path = layer_paths[layer];
+                std::size_t asset_index = assets.size();
+
+                texture_asset &asset = assets.emplace_back();
+                asset.name = path.substr(path.find_last_of("/\\") + 1);
+                asset.path = path;
+                asset.array_index = array_index;
+                asset.layer = static_cast<int>(layer);
+                array.layers.push_back(asset_index);
+
+                jobs.push({asset_index, path});
+            }
+        }
+        job_condition.notify_all();
+
+        return array_index;
+    }
+
+    /**
+     * Upload decoded images until the time budget of this frame is spent,
+     * at least one image is uploaded per call so the pipeline always makes progress
+     * @param time_budget milliseconds
+     * @return number of uploaded images
+     */
+    std::size_t
+    texture_pipeline::upload(double time_budget) {
+        TRACE_SCOPE("upload textures");
+        auto frame_start = pipeline_clock::now();
+        std::size_t count = 0;
+
+        while (elapsed_milliseconds(frame_start) < time_budget || count == 0) {
+            decoded_image image{};
+            {
+                std::lock_guard<std::mutex> lock(decoded_mutex);
+                if (decoded_images.empty())
+                    break;
+                image = std::move(decoded_images.front());
+                decoded_images.pop();
+            }
+
+            if (image.pixels == nullptr && !image.cooked)
+                throw std::runtime_error("Texture failed to load at path: " + image.path);
+
+            if (upload_layer(image))
+                ++uploaded_count;
+            stbi_image_free(image.pixels);
+
+            ++count;
+        }
+
+        // the timings of every image stay in get_assets and get_arrays, only the totals are printed
+        if (count > 0 && is_finished()) {
+            double decode_time = 0.0, upload_time = 0.0, mipmap_time = 0.0;
+            for (const texture_asset &asset: assets) {
+                decode_time += asset.decode_time;
+                upload_time += asset.upload_time;
+            }
+            for (const texture_array &array: arrays)
+                mipmap_time += array.mipmap_time;
+            std::cout << assets.size() << " textures in " << arrays.size() << " arrays loaded, " << decode_time
+                      << " ms decoding on " << workers.size() << " threads, " << upload_time << " ms uploading, "
+                      << mipmap_time << " ms generating mipmaps" << std::endl;
+        }
+
+        return count;
+    }
+
+    /**
+     * Copy one decoded image into its layer, the storage of the array is allocated by the first layer
+     * and the mipmaps are generated after the last one.
+     * A layer whose cooked file was unusable turns the whole array back to the source images,
+     * layers decoded the other way are queued again
+     * @param image decoded image
+     * @return false if the layer was queued again instead of uploaded
+     */
+    bool
+    texture_pipeline::upload_layer(const decoded_image &image) {
+        texture_asset &asset = assets[image.asset_index];
+        texture_array &array = arrays[asset.array_index];
+
+        auto upload_start = pipeline_clock::now();
+
+        if (array.texture_id != 0 && image.cooked != array.cooked) {
+            if (image.cooked) {
+                enqueue_source(image.asset_index);
+                return false;
+            }
+
+            glDeleteTextures(1, &array.texture_id);
+            array.texture_id = 0;
+            uploaded_count -= array.uploaded_layers;
+            array.uploaded_layers = 0;
+            for (std::size_t layer_asset: array.layers) {
+                if (assets[layer_asset].ready) {
+                    assets[layer_asset].ready = false;
+                    enqueue_source(layer_asset);
+                }
+            }
+        }
+
+        if (array.texture_id == 0) {
+            array.width = image.width;
+            array.height = image.height;
+            array.cooked = image.cooked;
+            auto layer_count = static_cast<int>(array.layers.size());
+            array.texture_id = image.cooked ?
+                               create_compressed_texture_array(image.compressed.format, image.width, image.height,
+                                                               layer_count,
+                                                               static_cast<int>(image.compressed.levels.size()),
+                                                               array.texture_wrap) :
+                               create_texture_array(image.width, image.height, layer_count, image.channels,
+                                                    array.texture_wrap);
+        } else if (image.width != array.width || image.height != array.height) {
+            throw std::runtime_error("Texture " + image.path + " does not match the size of the other "
+                                     "layers of " + array.name);
+        }
+
+        if (image.cooked)
+            upload_compressed_texture_layer(array.texture_id, asset.layer, image.compressed);
+        else
+            upload_texture_layer(array.texture_id, asset.layer, image.pixels, image.width, image.height,
+                                 image.channels);
+
+        asset.width = image.width;
+        asset.height = image.height;
+        asset.channels = image.channels;
+        asset.cooked = image.cooked;
+        asset.decode_time = image.decode_time;
+        asset.upload_time = elapsed_milliseconds(upload_start);
+        asset.ready = true;
+
+        if (++array.uploaded_layers == array.layers.size()) {
+            auto mipmap_start = pipeline_clock::now();
+            // cooked layers already brought their mipmaps
+            if (!array.cooked) {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture_id);
+                glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            }
+            array.mipmap_time = elapsed_milliseconds(mipmap_start);
+            array.ready = true;
+        }
+        return true;
+    }
+
+    /**
+     * Queue the source image of an asset again, its cooked file is not read
+     * @param asset_index asset to decode
+     */
+    void
+    texture_pipeline::enqueue_source(std::size_t asset_index) {
+        {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            jobs.push({asset_index, assets[asset_index].path, true});
+        }
+        job_condition.notify_one();
+    }
+
+    /**
+     * Worker thread, decodes queued images until the pipeline is destroyed
+     */
+    void
+    texture_pipeline::decode_loop() {
+        // the flip flag of stbi is global, set it for this thread only
+        stbi_set_flip_vertically_on_load_thread(flip_vertically);
+        TRACE_THREAD_NAME("texture decoder");
+
+        while (true) {
+            decode_job job;
+            {
+                std::unique_lock<std::mutex> lock(job_mutex);
+                job_condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+
+            TRACE_SCOPE("decode texture");
+            auto decode_start = pipeline_clock::now();
+            decoded_image image;
+            image.asset_index = job.asset_index;
+            image.path = std::move(job.path);
+
+            std::string cooked_path = cooked_texture_path(image.path);
+            if (!job.sources_only && std::filesystem::exists(cooked_path)) {
+                try {
+                    // read_cooked_texture never returns an empty level list
+                    image.compressed = read_cooked_texture(cooked_path);
+                    image.width = image.compressed.levels.front().width;
+                    image.height = image.compressed.levels.front().height;
+                    image.cooked = true;
+                } catch (std::exception &e) {
+                    std::cout << e.what() << ", loading " << image.path << " instead" << std::endl;
+                    image.compressed = cooked_texture();
+                }
+            }
+            if (!image.cooked) {
+                // a failed decode is passed on as nullptr and reported on the GL thread
+                image.pixels = stbi_load(image.path.c_str(), &image.width, &image.height, &image.channels, 0);
+            }
+            image.decode_time = elapsed_milliseconds(decode_start);
+
+            std::lock_guard<std::mutex> lock(decoded_mutex);
+            decoded_images.push(std::move(image));
+        }
+    }
+}
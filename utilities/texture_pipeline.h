@@ -0,0 +1,133 @@
+#ifndef INC_3DPERLINMAP_TEXTURE_PIPELINE_H
+#define INC_3DPERLINMAP_TEXTURE_PIPELINE_H
+
+#include <glad/glad.h>
+
+#include "cooked_texture.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utilities {
+
+    // state and timings of one image, the timings are in milliseconds
+    struct texture_asset {
+        std::string name;
+        // full path of the source image
+        std::string path;
+        // texture array the image is a layer of
+        std::size_t array_index = 0;
+        int layer = 0;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        // loaded from a .ctex written by the texture cooker instead of decoded
+        bool cooked = false;
+        // time spent in stbi or reading the cooked file on a worker thread
+        double decode_time = 0.0;
+        // time spent submitting the layer on the GL thread
+        double upload_time = 0.0;
+        bool ready = false;
+    };
+
+    // a GL_TEXTURE_2D_ARRAY built from several images of the same size
+    struct texture_array {
+        std::string name;
+        unsigned int texture_id = 0;
+        char32_t texture_wrap = GL_REPEAT;
+        // size of every layer, taken from the first uploaded image
+        int width = 0;
+        int height = 0;
+        // block compressed layers come with their mipmaps
+        bool cooked = false;
+        // asset index of every layer
+        std::vector<std::size_t> layers;
+        std::size_t uploaded_layers = 0;
+        // time spent generating the mipmaps of all layers once the last one is uploaded
+        double mipmap_time = 0.0;
+        bool ready = false;
+    };
+
+    /**
+     * Loads images on a pool of worker threads and uploads the decoded pixels on the GL thread,
+     * a few images per frame, so the texture arrays become usable one after another
+     * instead of blocking the start until all of them are loaded.
+     * Everything except the decoding is meant to be called from the thread owning the GL context.
+     */
+    class texture_pipeline {
+    public:
+        explicit texture_pipeline(unsigned int thread_count = 0, bool flip_vertically = true);
+
+        texture_pipeline(const texture_pipeline &) = delete;
+
+        texture_pipeline &operator=(const texture_pipeline &) = delete;
+
+        ~texture_pipeline();
+
+        std::size_t
+        enqueue_array(std::string &&array_name, const std::vector<std::string> &layer_paths,
+                      const char32_t &texture_wrap = GL_REPEAT);
+
+        std::size_t upload(double time_budget);
+
+        [[nodiscard]] inline bool is_ready(std::size_t array_index) const { return arrays[array_index].ready; }
+
+        [[nodiscard]] inline unsigned int get_texture_id(std::size_t array_index) const {
+            return arrays[array_index].texture_id;
+        }
+
+        [[nodiscard]] inline const std::vector<texture_asset> &get_assets() const { return assets; }
+
+        [[nodiscard]] inline const std::vector<texture_array> &get_arrays() const { return arrays; }
+
+        [[nodiscard]] inline bool is_finished() const { return uploaded_count == assets.size(); }
+
+    private:
+        struct decode_job {
+            std::size_t asset_index;
+            std::string path;
+            // skip the cooked file, for arrays that fell back to their source images
+            bool sources_only = false;
+        };
+
+        struct decoded_image {
+            std::size_t asset_index = 0;
+            std::string path;
+            unsigned char *pixels = nullptr;
+            int width = 0;
+            int height = 0;
+            int channels = 0;
+            double decode_time = 0.0;
+            // only filled if a cooked file exists next to the image
+            bool cooked = false;
+            cooked_texture compressed;
+        };
+
+        bool flip_vertically;
+        std::vector<texture_asset> assets;
+        std::vector<texture_array> arrays;
+        std::size_t uploaded_count = 0;
+
+        std::queue<decode_job> jobs;
+        std::mutex job_mutex;
+        std::condition_variable job_condition;
+        bool stopping = false;
+
+        std::queue<decoded_image> decoded_images;
+        std::mutex decoded_mutex;
+
+        std::vector<std::thread> workers;
+
+        bool upload_layer(const decoded_image &image);
+
+        void enqueue_source(std::size_t asset_index);
+
+        void decode_loop();
+    };
+}
+
+#endif //INC_3DPERLINMAP_TEXTURE_PIPELINE_H